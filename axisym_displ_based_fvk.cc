@@ -35,6 +35,12 @@
 // Include the mesh
 #include "meshes/one_d_mesh.h"
 
+// Shared solution strategies (continuation etc.)
+#include "fvk_solver_problem.h"
+
+// Linear solvers
+#include "fvk_linear_solvers.h"
+
 using namespace std;
 
 using namespace oomph;
@@ -48,22 +54,60 @@ namespace AxisymFvKParameters
  /// Constant pressure
  double Pressure=0.0;
  
- /// Function that computes the pressure at radius r
- void pressure_function(const double& r,double& pressure ) 
- {
-  pressure = Pressure;
- }
- 
  /// FvK parameter
  double Eta = 2.39e6;
 
  /// Poisson ratio
  double Nu = 0.5;
 
+ /// The physical parameters of a problem instance. Each problem owns a
+ /// set, initialised from the defaults above (which can be set on the
+ /// command line), so several problems can be solved concurrently in
+ /// different threads.
+ struct ParameterSet
+ {
+  /// Constructor: Copy the defaults
+  ParameterSet() : Pressure(AxisymFvKParameters::Pressure),
+                   Eta(AxisymFvKParameters::Eta),
+                   Nu(AxisymFvKParameters::Nu)
+   {}
+
+  /// Constant pressure
+  double Pressure;
+
+  /// FvK parameter
+  double Eta;
+
+  /// Poisson ratio
+  double Nu;
+ };
+
+ /// Parameters of the problem that's currently being solved in this
+ /// thread (the context for the functions called by the elements)
+ thread_local ParameterSet* Current_parameter_set_pt = 0;
+
+ /// Function that computes the pressure at radius r for the specified
+ /// parameters
+ void pressure_function(const ParameterSet& parameters,
+                        const double& r, double& pressure)
+ {
+  pressure = parameters.Pressure;
+ }
+
+ /// Function that computes the pressure at radius r for the parameters
+ /// of the problem that's currently being solved in this thread
+ void pressure_function(const double& r,double& pressure ) 
+ {
+  pressure_function(*Current_parameter_set_pt,r,pressure);
+ }
+
  /// Function to get the exact solution for the pure bending model
+ /// (for the parameters of the problem that's currently being solved in
+ /// this thread)
  void get_exact_u(const Vector<double>& r, Vector<double>& u )
  {
-  u[0]=AxisymFvKParameters::Pressure*(r[0]*r[0]-1.0)*(r[0]*r[0]-1.0)/64.0;
+  u[0]=Current_parameter_set_pt->Pressure*
+   (r[0]*r[0]-1.0)*(r[0]*r[0]-1.0)/64.0;
  }
  
  /// Directory
@@ -75,7 +119,7 @@ namespace AxisymFvKParameters
 /// Problem class
 //====================================================================
 template<class ELEMENT> 
-class AxisymFvKProblem : public Problem
+class AxisymFvKProblem : public virtual FvKSolverProblem
 {
 public:
  
@@ -88,20 +132,43 @@ public:
    delete mesh_pt();
   }
  
- /// Update the problem specs before solve (empty)
- void actions_before_newton_solve(){}
+ /// Update the problem specs before solve (nothing to do apart from
+ /// the solver bookkeeping and selecting our parameters for the
+ /// pressure function)
+ void actions_before_newton_solve()
+  {
+   make_parameters_current();
+   FvKSolverProblem::actions_before_newton_solve();
+  }
  
  /// Update the problem specs after solve (empty)
  void actions_after_newton_solve(){}
  
  /// Doc the solution.
  void doc_solution();
+
+ /// The problem's physical parameters
+ AxisymFvKParameters::ParameterSet& parameters()
+  {
+   return Problem_parameters;
+  }
+
+ /// Make the problem's parameters the context for the functions called
+ /// by the elements (in the current thread); called for every element
+ /// that's assembled
+ void make_parameters_current()
+  {
+   AxisymFvKParameters::Current_parameter_set_pt=&Problem_parameters;
+  }
  
 private:
  
  /// Doc info object for labeling output
  DocInfo Doc_info;
 
+ /// The problem's physical parameters
+ AxisymFvKParameters::ParameterSet Problem_parameters;
+
 }; // end of problem class
 
 
@@ -114,6 +181,15 @@ AxisymFvKProblem<ELEMENT>::
 AxisymFvKProblem(const unsigned& n_element) 
  
 { 
+ // Our parameters are the context for the pressure function: they're
+ // selected whenever an element is assembled (and for the output), and
+ // can be found by name
+ make_parameters_current();
+ enable_parameter_context_assembly();
+ register_parameter("--pressure",&Problem_parameters.Pressure);
+ register_parameter("--eta",&Problem_parameters.Eta);
+ register_parameter("--nu",&Problem_parameters.Nu);
+
  // Set domain length 
  double l=1.0;
  
@@ -144,10 +220,10 @@ AxisymFvKProblem(const unsigned& n_element)
    elem_pt->pressure_fct_pt() =  &AxisymFvKParameters::pressure_function;
    
    //Set the pointer to eta
-   elem_pt->eta_pt() = &AxisymFvKParameters::Eta;
+   elem_pt->eta_pt() = &Problem_parameters.Eta;
 
    //Set the pointer to nu
-   elem_pt->nu_pt() = &AxisymFvKParameters::Nu;
+   elem_pt->nu_pt() = &Problem_parameters.Nu;
 
    // Choose between pure bending or fvk model
    if (CommandLineArgs::command_line_flag_has_been_set("--use_linear_eqns"))
@@ -169,12 +245,15 @@ AxisymFvKProblem(const unsigned& n_element)
 template<class ELEMENT>
 void AxisymFvKProblem<ELEMENT>::doc_solution()
 { 
+ // The exact solution needs our parameters
+ make_parameters_current();
+
  //  Number of plot points
  unsigned npts;
  npts=5; 
 
  // Output solution with specified number of plot points per element
- char filename[100];
+ char filename[500];
 
  sprintf(filename, "%s/soln%i.dat",
          AxisymFvKParameters::Directory.c_str(),Doc_info.number());
@@ -193,7 +272,7 @@ void AxisymFvKProblem<ELEMENT>::doc_solution()
   // Output solution at the centre (r=0) as function of the pressure
  sprintf(filename, "%s/w_centre.dat",AxisymFvKParameters::Directory.c_str());
  ofstream w_centre_file(filename,ios::app);
- w_centre_file << AxisymFvKParameters::Pressure << " " 
+ w_centre_file << Problem_parameters.Pressure << " " 
                << mesh_pt()->node_pt(0)->value(0) << std::endl;
  w_centre_file.close();
 
@@ -219,9 +298,55 @@ int main(int argc, char **argv)
  // Store command line arguments
  CommandLineArgs::setup(argc,argv);
 
+ // Directory for solution
+ CommandLineArgs::specify_command_line_flag("--dir",
+                                            &AxisymFvKParameters::Directory);
+
  // Choose between pure bending or fvk model
  CommandLineArgs::specify_command_line_flag("--use_linear_eqns");
 
+ // Initial pressure (and initial arc-length increment)
+ double dp=0.01;
+ CommandLineArgs::specify_command_line_flag("--dp", &dp);
+
+ // Target pressure
+ double p_max=0.01;
+ CommandLineArgs::specify_command_line_flag("--p_max", &p_max);
+
+ // Use adaptive load stepping rather than arc-length continuation?
+ CommandLineArgs::specify_command_line_flag("--use_adaptive_load_stepping");
+
+ // FvK parameter
+ CommandLineArgs::specify_command_line_flag("--eta",
+                                            &AxisymFvKParameters::Eta);
+
+ // Get the initial state by a homotopy in this parameter (the name of
+ // any of the double command line flags, e.g. "eta"): it's ramped up
+ // from homotopy_start to its actual value by adaptive steps
+ string homotopy_parameter="";
+ CommandLineArgs::specify_command_line_flag("--homotopy_parameter",
+                                            &homotopy_parameter);
+
+ // Start value for the homotopy
+ double homotopy_start=1.0e2;
+ CommandLineArgs::specify_command_line_flag("--homotopy_start",
+                                            &homotopy_start);
+
+ // Initial increment for the homotopy (in the logarithm of the parameter
+ // if both the start and the target values are positive)
+ double homotopy_increment=1.0;
+ CommandLineArgs::specify_command_line_flag("--homotopy_increment",
+                                            &homotopy_increment);
+
+ // Direct linear solver (see FvKDirectSolvers::available_solvers())
+ string linear_solver_name="default";
+ CommandLineArgs::specify_command_line_flag("--linear_solver",
+                                            &linear_solver_name);
+
+ // Options for the direct solvers (memory budget and scratch directory
+ // for "out_of_core_ldlt")
+ FvKDirectSolvers::specify_command_line_flags();
+
  // Parse command line
  CommandLineArgs::parse_and_assign(); 
  
@@ -231,28 +356,81 @@ int main(int argc, char **argv)
  // Number of elements in the mesh
  unsigned n_element=100;
  
- // Number of steps
- unsigned n_step=1;
+ // Max. number of continuation steps
+ unsigned max_nstep=100;
 
- // Pressure increment
- double dp=0.01;
- 
  // Set up the problem: 
  AxisymFvKProblem<AxisymFoepplvonKarmanElement<3> > problem(n_element);
+
+ // Choose the linear solver
+ FvKDirectSolvers::set_solver(&problem,linear_solver_name);
+
+ // The problem's own physical parameters (initialised from the defaults
+ // in the AxisymFvKParameters namespace)
+ AxisymFvKParameters::ParameterSet& parameters=problem.parameters();
  
  // Set initial value for pressure 
- AxisymFvKParameters::Pressure=dp;
- 
- for (unsigned i=0;i<n_step;i++)
+ parameters.Pressure=dp;
+
+ // Solve the problem
+ if (homotopy_parameter!="")
+  {
+   problem.homotopy_solve(homotopy_parameter,homotopy_start,
+                          homotopy_increment);
+  }
+ else
   {
-   // Solve the problem
    problem.newton_solve();
+  }
+
+ //Output solution
+ problem.doc_solution();
+
+ // Pseudo-arclength continuation in the pressure up to the target value
+ double ds=dp;
+ for (unsigned i=0;i<max_nstep;i++)
+  {
+   // Done?
+   if (parameters.Pressure>=p_max) break;
+
+   // Do the step
+   if (CommandLineArgs::
+       command_line_flag_has_been_set("--use_adaptive_load_stepping"))
+    {
+     // Don't overshoot
+     ds=std::min(ds,p_max-parameters.Pressure);
+     ds=problem.adaptive_load_step(&parameters.Pressure,ds);
+    }
+   else
+    {
+     // Don't overshoot: Finish with a plain load step to the target
+     // value once it's within the next arc-length increment (which
+     // bounds the pressure increment for a monotonic loading path)
+     if (p_max-parameters.Pressure<=std::fabs(ds))
+      {
+       problem.adaptive_load_step_to(&parameters.Pressure,p_max,
+                                     p_max-parameters.Pressure);
+      }
+     else
+      {
+       ds=problem.continuation_step(&parameters.Pressure,ds);
+      }
+    }
    
    //Output solution
    problem.doc_solution();
-   
-   // Increment pressure
-   AxisymFvKParameters::Pressure+=dp; 
+  }
+
+ // Document the accepted and rejected load steps
+ if (CommandLineArgs::
+     command_line_flag_has_been_set("--use_adaptive_load_stepping"))
+  {
+   char filename[500];
+   sprintf(filename, "%s/load_steps.dat",
+           AxisymFvKParameters::Directory.c_str());
+   ofstream load_step_file(filename);
+   problem.doc_load_step_history(load_step_file);
+   load_step_file.close();
   }
  
 } // end of main
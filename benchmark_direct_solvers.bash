@@ -0,0 +1,44 @@
+#! /bin/bash
+
+# Compare the run time and peak memory usage of the direct linear solvers
+# for the Bell/FvK systems in circular_disc, rotated_square and
+# circular_sector for a range of element areas. Results go to
+# benchmark_direct_solvers.dat. Pass the names of the solvers to compare
+# as arguments (default: "default superlu frontal ldlt").
+
+if [ -e RESLT ]; then
+    echo "RESLT already exists; please delete"
+    exit
+fi
+
+solvers="$@"
+if [ -z "$solvers" ]; then
+    solvers="default superlu frontal ldlt"
+fi
+
+result_file=benchmark_direct_solvers.dat
+echo "# driver element_area solver wall_time[s] max_rss[kB] status" \
+    > $result_file
+
+for driver in circular_disc rotated_square circular_sector; do
+    # circular_disc: Do the single solve for the clamped validation
+    # case rather than the buckling sweep
+    flags=""
+    if [ $driver == "circular_disc" ]; then
+        flags="--use_clamped_bc"
+    fi
+    for element_area in 0.09 0.03 0.01 0.003; do
+        for solver in $solvers; do
+            mkdir RESLT
+            /usr/bin/time -f "%e %M" -o time.tmp \
+                ./$driver $flags --element_area $element_area \
+                --linear_solver $solver > OUTPUT_benchmark 2>&1
+            status=$?
+            echo "$driver $element_area $solver `cat time.tmp | tail -1` $status" \
+                >> $result_file
+            rm -rf RESLT time.tmp
+        done
+    done
+done
+
+cat $result_file
@@ -0,0 +1,21 @@
+#! /bin/bash
+
+# Compare the monolithic Newton solve for the clamped disk with the one
+# in which the in-plane displacements are eliminated at each Newton step
+# (Eta defaults to 2.39e6; pass e.g. "--eta 2.39e4" to change it)
+
+if [ -e RESLT ]; then
+    echo "RESLT already exists; please delete"
+    exit
+fi
+
+for mode in monolithic eliminated; do
+    flags="--use_clamped_bc"
+    if [ $mode == "eliminated" ]; then
+        flags="$flags --eliminate_in_plane_displacements"
+    fi
+    mkdir RESLT
+    ./circular_disc $flags "$@" > OUTPUT_$mode
+    rm -rf RESLT
+    echo "$mode: " `grep "Newton iterations:" OUTPUT_$mode`
+done
@@ -38,6 +38,13 @@
 // The mesh
 #include "meshes/triangle_mesh.h"
 
+// Shared solution strategies (continuation etc.)
+#include "fvk_solver_problem.h"
+
+// Preconditioners and linear solvers
+#include "fvk_preconditioners.h"
+#include "fvk_linear_solvers.h"
+
 using namespace std;
 using namespace oomph;
 using MathematicalConstants::Pi;
@@ -520,6 +527,40 @@ namespace Parameters
  /// In-plane traction magnitude
  double T_mag = 0.00;
 
+ /// The physical parameters of a problem instance. Each problem owns a
+ /// set, initialised from the defaults above (which can be set on the
+ /// command line), so several problems can be solved concurrently in
+ /// different threads.
+ struct ParameterSet
+ {
+  /// Constructor: Copy the defaults
+  ParameterSet() : Problem_case(Parameters::Problem_case),
+                   Nu(Parameters::Nu),
+                   Eta(Parameters::Eta),
+                   P_mag(Parameters::P_mag),
+                   T_mag(Parameters::T_mag)
+   {}
+
+  /// Which case are we doing
+  unsigned Problem_case;
+
+  /// Poisson ratio
+  double Nu;
+
+  /// FvK parameter
+  double Eta;
+
+  /// Pressure magnitude
+  double P_mag;
+
+  /// In-plane traction magnitude
+  double T_mag;
+ };
+
+ /// Parameters of the problem that's currently being solved in this
+ /// thread (the context for the load functions called by the elements)
+ thread_local ParameterSet* Current_parameter_set_pt = 0;
+
  // hierher what are these objects? Shouldn't they be
  // used in the mesh generatino too; surely they encode the
  // same information.
@@ -563,21 +604,26 @@ namespace Parameters
   dt(1,1) = dn(0,1);
  }
 
- /// Pressure depending on the position (x,y)
- void get_pressure(const Vector<double>& x, double& pressure)
+ /// Pressure depending on the position (x,y) for the specified
+ /// parameters
+ void get_pressure(const ParameterSet& parameters,
+                   const Vector<double>& x, double& pressure)
  {
+  const double& P_mag=parameters.P_mag;
+
   // Constant pressure for validation case
-  if (Parameters::Problem_case==Parameters::Clamped_validation)
+  if (parameters.Problem_case==Parameters::Clamped_validation)
    {
     pressure = P_mag;
    }
   // Parabolic pressure distribution with zero mean
-  else if (Parameters::Problem_case==Parameters::Axisymmetric_shear_buckling)
+  else if (parameters.Problem_case==Parameters::Axisymmetric_shear_buckling)
    {
     pressure = P_mag*(0.25-x[0]*x[0]-x[1]*x[1]);
    }
   // Parabolic pressure distribution with zero mean
-  else if (Parameters::Problem_case==Parameters::Nonaxisymmetric_shear_buckling)
+  else if (parameters.Problem_case==
+           Parameters::Nonaxisymmetric_shear_buckling)
    {
     pressure = P_mag*(0.25-x[0]*x[0]-x[1]*x[1]);
    }
@@ -591,18 +637,29 @@ namespace Parameters
 
 
  
+ /// Pressure depending on the position (x,y) for the parameters of
+ /// the problem that's currently being solved in this thread
+ void get_pressure(const Vector<double>& x, double& pressure)
+ {
+  get_pressure(*Current_parameter_set_pt,x,pressure);
+ }
+
+ 
  /// In plane forcing (shear stress) depending on the position (x,y)
- void get_in_plane_force(const Vector<double>& x, Vector<double>& tau)
+ /// for the specified parameters
+ void get_in_plane_force(const ParameterSet& parameters,
+                         const Vector<double>& x, Vector<double>& tau)
  {
+  const double& T_mag=parameters.T_mag;
 
   // Zero shear stress for validation case
-  if (Parameters::Problem_case==Parameters::Clamped_validation)
+  if (parameters.Problem_case==Parameters::Clamped_validation)
    {
     tau[0]=0.0;
     tau[1]=0.0;
    }
   // Self balancing purely radially outward shear stress
-  else if (Parameters::Problem_case==Parameters::Axisymmetric_shear_buckling)
+  else if (parameters.Problem_case==Parameters::Axisymmetric_shear_buckling)
    {
     double phi=atan2(x[1],x[0]);
     double r_squared=x[0]*x[0]+x[1]*x[1];
@@ -610,7 +667,8 @@ namespace Parameters
     tau[1]=T_mag*r_squared*sin(phi);
    }
   // Self-balancing y shear stress over disk:
-  else if (Parameters::Problem_case==Parameters::Nonaxisymmetric_shear_buckling)
+  else if (parameters.Problem_case==
+           Parameters::Nonaxisymmetric_shear_buckling)
    {
     //   tau_y := 1/4 - y^2;
     //
@@ -628,6 +686,15 @@ namespace Parameters
  }
 
 
+ /// In plane forcing (shear stress) depending on the position (x,y)
+ /// for the parameters of the problem that's currently being solved in
+ /// this thread
+ void get_in_plane_force(const Vector<double>& x, Vector<double>& tau)
+ {
+  get_in_plane_force(*Current_parameter_set_pt,x,tau);
+ }
+
+
  // hierher: kill but check with Aidan first
  
  // // This metric will flag up any non--axisymmetric parts
@@ -659,13 +726,15 @@ namespace Parameters
 /// Problem definition
 //====================================================================
 template<class ELEMENT>
-class UnstructuredFvKProblem : public virtual Problem
+class UnstructuredFvKProblem : public virtual FvKSolverProblem
 {
 
 public:
 
- /// Constructor
- UnstructuredFvKProblem(double const& element_area = 0.09);
+ /// Constructor: Pass the target element area and the directory
+ /// for the output
+ UnstructuredFvKProblem(double const& element_area = 0.09,
+                        const std::string& output_dir = "RESLT");
 
  /// Destructor
  ~UnstructuredFvKProblem()
@@ -688,12 +757,39 @@ public:
  /// Update after solve (empty)
  void actions_after_newton_solve() {}
 
- /// Update the problem specs before solve: empty
- void actions_before_newton_solve(){}
+ /// Update the problem specs before solve (nothing to do apart from
+ /// the solver bookkeeping and selecting our parameters for the load
+ /// functions)
+ void actions_before_newton_solve()
+  {
+   make_parameters_current();
+   FvKSolverProblem::actions_before_newton_solve();
+  }
 
  /// Doc the solution
  void doc_solution(const std::string& comment="");
 
+ /// Does this process write the output? (All processes hold the same
+ /// solution, so only the first one does, lest they clobber each
+ /// other's files)
+ bool is_output_process()
+  {
+   return communicator_pt()->my_rank()==0;
+  }
+
+ /// The problem's physical parameters
+ Parameters::ParameterSet& parameters()
+  {
+   return Problem_parameters;
+  }
+
+ /// Make the problem's parameters the context for the load functions
+ /// (in the current thread); called for every element that's assembled
+ void make_parameters_current()
+  {
+   Parameters::Current_parameter_set_pt=&Problem_parameters;
+  }
+
  /// Overloaded version of the problem's access function to
  /// the mesh. Recasts the pointer to the base Mesh object to
  /// the actual mesh type.
@@ -721,6 +817,9 @@ private:
  /// Trace file to document norm of solution
  ofstream Trace_file;
 
+ /// The problem's physical parameters
+ Parameters::ParameterSet Problem_parameters;
+
  /// Loop over all curved edges, then loop over elements and upgrade
  /// them to be curved elements
  void upgrade_edge_elements_to_curve(const unsigned &b);
@@ -779,10 +878,22 @@ private:
 /// Constructor definition
 //======================================================================
 template<class ELEMENT>
-UnstructuredFvKProblem<ELEMENT>::UnstructuredFvKProblem(const double& element_area)
+UnstructuredFvKProblem<ELEMENT>::UnstructuredFvKProblem(const double& element_area,
+                                                        const std::string&
+                                                        output_dir)
  :
  Element_area(element_area)
 {
+ // Our parameters are the context for the load functions: they're
+ // selected whenever an element is assembled (and for the output), and
+ // can be found by name
+ make_parameters_current();
+ enable_parameter_context_assembly();
+ register_parameter("--nu",&Problem_parameters.Nu);
+ register_parameter("--eta",&Problem_parameters.Eta);
+ register_parameter("--p",&Problem_parameters.P_mag);
+ register_parameter("--t_mag",&Problem_parameters.T_mag);
+
  // Build the mesh
  build_mesh();
 
@@ -797,12 +908,13 @@ UnstructuredFvKProblem<ELEMENT>::UnstructuredFvKProblem(const double& element_ar
  complete_problem_setup();
 
  // Set directory
- Doc_info.set_directory("RESLT");
+ Doc_info.set_directory(output_dir);
  
  // Open trace file
- char filename[100];
- sprintf(filename, "RESLT/trace.dat");
- Trace_file.open(filename);
+ if (is_output_process())
+  {
+   Trace_file.open((output_dir+"/trace.dat").c_str());
+  }
 
  // Assign equation numbers
  oomph_info << "Number of equations: "
@@ -1042,8 +1154,8 @@ void UnstructuredFvKProblem<ELEMENT>::complete_problem_setup()
    // There is no error metric in this case
    // el_pt->error_metric_fct_pt() = &Parameters::axiasymmetry_metric;
 
-   el_pt->nu_pt() = &Parameters::Nu;
-   el_pt->eta_pt() = &Parameters::Eta;
+   el_pt->nu_pt() = &Problem_parameters.Nu;
+   el_pt->eta_pt() = &Problem_parameters.Eta;
   }
 
 }
@@ -1057,7 +1169,7 @@ template<class ELEMENT>
 void UnstructuredFvKProblem<ELEMENT>::apply_boundary_conditions()
 {
   // Clamp it
- if (Parameters::Problem_case==Parameters::Clamped_validation)
+ if (Problem_parameters.Problem_case==Parameters::Clamped_validation)
   {
    // Set the boundary conditions
    unsigned nbound = 2;
@@ -1295,8 +1407,18 @@ template<class ELEMENT>
 void UnstructuredFvKProblem<ELEMENT>::doc_solution(const
 						   std::string& comment)
 {
+ // Output functions may need our parameters
+ make_parameters_current();
+
+ // Only one process writes the output
+ if (!is_output_process())
+  {
+   Doc_info.number()++;
+   return;
+  }
+
  ofstream some_file;
- char filename[100];
+ char filename[500];
 
  // Number of plot points
  unsigned npts = 30;
@@ -1326,7 +1448,13 @@ void UnstructuredFvKProblem<ELEMENT>::doc_solution(const
  
  oomph_info << "w in the middle: " <<std::setprecision(15) << u_0[0] << std::endl;
  
- Trace_file << Parameters::P_mag << " " << u_0[0] << '\n';
+ // Number of negative eigenvalues of the Jacobian (-1 if not available
+ // from the linear solver)
+ Trace_file << Problem_parameters.P_mag << " "
+            << Problem_parameters.T_mag << " "
+            << u_0[0] << " "
+            << sign_of_jacobian() << " "
+            << nnegative_jacobian_eigenvalue() << '\n';
 
  // Increment the doc_info number
  Doc_info.number()++;
@@ -1335,11 +1463,481 @@ void UnstructuredFvKProblem<ELEMENT>::doc_solution(const
 
 
 
+//==start_of_find_deflated_solutions====================================
+/// Enumerate the coexisting equilibria for the traction t_deflation by
+/// deflation, starting each solve from the current (pressure-loaded)
+/// state, and document them. If --deflation_seed is specified, the
+/// initial guess is randomly perturbed (by a fraction
+/// deflation_perturbation of its max. norm) first, so that independent
+/// runs with different seeds (see find_deflated_solutions.bash) search
+/// different parts of the solution space in parallel. The dofs of the
+/// solutions are also written to output_dir/deflated_dofs<i>.dat, from
+/// which merge_deflated_solutions(...) can collect them.
+//======================================================================
+template<class ELEMENT>
+void find_deflated_solutions(UnstructuredFvKProblem<ELEMENT>& problem,
+                             const double& t_deflation,
+                             const unsigned& n_deflated_solution,
+                             const unsigned& deflation_seed,
+                             const double& deflation_perturbation,
+                             const std::string& output_dir)
+{
+ // The problem's physical parameters
+ Parameters::ParameterSet& parameters=problem.parameters();
+
+ const unsigned long n_dof=problem.ndof();
+ Vector<double> initial_guess(n_dof);
+ double max_dof=0.0;
+ for (unsigned long i=0;i<n_dof;i++)
+  {
+   initial_guess[i]=problem.dof(i);
+   max_dof=std::max(max_dof,std::fabs(initial_guess[i]));
+  }
+
+ // Perturb the initial guess
+ if (CommandLineArgs::command_line_flag_has_been_set("--deflation_seed"))
+  {
+   std::srand(deflation_seed);
+   double amplitude=deflation_perturbation*std::max(max_dof,1.0e-8);
+   for (unsigned long i=0;i<n_dof;i++)
+    {
+     initial_guess[i]+=amplitude*
+      (2.0*double(std::rand())/double(RAND_MAX)-1.0);
+    }
+  }
+
+ parameters.T_mag=t_deflation;
+ unsigned n_found=
+  problem.find_solutions_by_deflation(initial_guess,n_deflated_solution);
+ oomph_info << "Found " << n_found << " solutions for Tau = "
+            << parameters.T_mag << "\n";
+
+ // Document them
+ for (unsigned i=0;i<n_found;i++)
+  {
+   problem.assign_deflation_solution_to_dofs(i);
+   std::ostringstream comment;
+   comment << "deflated solution " << i;
+   problem.doc_solution(comment.str());
+
+   // Keep the dofs for merging with the solutions found by other runs
+   if (!problem.is_output_process()) continue;
+   std::ostringstream filename;
+   filename << output_dir << "/deflated_dofs" << i << ".dat";
+   ofstream dofs_file(filename.str().c_str());
+   dofs_file << std::setprecision(16);
+   for (unsigned long j=0;j<n_dof;j++)
+    {
+     dofs_file << problem.dof(j) << "\n";
+    }
+   dofs_file.close();
+  }
+
+} // end of find_deflated_solutions
+
+
+
+//==start_of_merge_deflated_solutions===================================
+/// Collect the solutions for the traction t_deflation found by
+/// (parallel) runs of find_deflated_solutions(...): The file
+/// dofs_file_list lists the deflated_dofs<i>.dat files written by those
+/// runs, one per line. Solutions that coincide (to within the
+/// problem's deflation_tolerance()) with one collected earlier are
+/// discarded; the distinct ones are documented. The runs must have used
+/// the same mesh and boundary conditions as this one.
+//======================================================================
+template<class ELEMENT>
+void merge_deflated_solutions(UnstructuredFvKProblem<ELEMENT>& problem,
+                              const double& t_deflation,
+                              const std::string& dofs_file_list)
+{
+ // The problem's physical parameters
+ Parameters::ParameterSet& parameters=problem.parameters();
+ parameters.T_mag=t_deflation;
+
+ ifstream list_file(dofs_file_list.c_str());
+ if (!list_file)
+  {
+   throw OomphLibError("Can't open "+dofs_file_list,
+                       OOMPH_CURRENT_FUNCTION,
+                       OOMPH_EXCEPTION_LOCATION);
+  }
+
+ // Read the solutions
+ const unsigned long n_dof=problem.ndof();
+ problem.clear_deflation_solutions();
+ std::string filename;
+ while (std::getline(list_file,filename))
+  {
+   if (filename=="") continue;
+   ifstream dofs_file(filename.c_str());
+   for (unsigned long j=0;j<n_dof;j++)
+    {
+     if (!(dofs_file >> problem.dof(j)))
+      {
+       throw OomphLibError(filename+" doesn't hold the dofs of this problem",
+                           OOMPH_CURRENT_FUNCTION,
+                           OOMPH_EXCEPTION_LOCATION);
+      }
+    }
+   if (problem.is_deflation_solution())
+    {
+     oomph_info << filename << " duplicates an earlier solution\n";
+    }
+   else
+    {
+     problem.add_deflation_solution();
+     oomph_info << filename << " is distinct solution "
+                << problem.ndeflation_solution()-1 << "\n";
+    }
+  }
+ list_file.close();
+
+ // Document the distinct ones
+ unsigned n_solution=problem.ndeflation_solution();
+ oomph_info << "Found " << n_solution << " distinct solutions for Tau = "
+            << parameters.T_mag << "\n";
+ for (unsigned i=0;i<n_solution;i++)
+  {
+   problem.assign_deflation_solution_to_dofs(i);
+   std::ostringstream comment;
+   comment << "deflated solution " << i;
+   problem.doc_solution(comment.str());
+  }
+
+} // end of merge_deflated_solutions
+
+
+
+//==start_of_do_buckling_analysis=======================================
+/// Linearised buckling analysis at the prestressed state with traction
+/// t_prestress: Document the n_buckling_mode modes closest to
+/// instability and (if requested) follow the critical point as Nu or
+/// Eta is stepped to control_parameter_end in n_control_step steps
+//======================================================================
+template<class ELEMENT>
+void do_buckling_analysis(UnstructuredFvKProblem<ELEMENT>& problem,
+                          const double& t_prestress,
+                          const unsigned& n_buckling_mode,
+                          const std::string& critical_load_control_parameter,
+                          const double& control_parameter_end,
+                          const unsigned& n_control_step,
+                          const std::string& output_dir)
+{
+ // The problem's physical parameters
+ Parameters::ParameterSet& parameters=problem.parameters();
+
+ // Get the prestressed state
+ parameters.T_mag=t_prestress;
+ problem.newton_solve();
+ problem.doc_solution("prestressed state");
+
+ // Get the modes and estimates for the critical traction
+ unsigned n_mode=
+  problem.solve_for_buckling_modes(&parameters.T_mag,n_buckling_mode);
+ if (problem.is_output_process())
+  {
+   ofstream buckling_file((output_dir+"/buckling.dat").c_str());
+   problem.doc_buckling_analysis(buckling_file);
+   buckling_file.close();
+  }
+
+ // Output the modes in the same format as the solution
+ for (unsigned m=0;m<n_mode;m++)
+  {
+   oomph_info << "Buckling mode " << m << ": eigenvalue "
+              << problem.buckling_eigenvalue(m)
+              << " ; estimated critical Tau = "
+              << problem.buckling_critical_parameter(m) << "\n";
+   problem.assign_buckling_mode_to_dofs(m);
+   std::ostringstream comment;
+   comment << "buckling mode " << m << "; critical Tau = "
+           << problem.buckling_critical_parameter(m);
+   problem.doc_solution(comment.str());
+   problem.restore_dofs_after_buckling_mode();
+  }
+
+ // Follow the critical point as Nu or Eta varies
+ if (CommandLineArgs::
+     command_line_flag_has_been_set("--track_critical_load_in"))
+  {
+   double* control_parameter_pt=0;
+   if (critical_load_control_parameter=="nu")
+    {
+     control_parameter_pt=&parameters.Nu;
+    }
+   else if (critical_load_control_parameter=="eta")
+    {
+     control_parameter_pt=&parameters.Eta;
+    }
+   else
+    {
+     throw OomphLibError("Can only track the critical load in nu or eta",
+                         OOMPH_CURRENT_FUNCTION,
+                         OOMPH_EXCEPTION_LOCATION);
+    }
+
+   // Values of the control parameter
+   Vector<double> control_value(n_control_step);
+   double control_parameter_start=*control_parameter_pt;
+   for (unsigned i=0;i<n_control_step;i++)
+    {
+     control_value[i]=control_parameter_start+
+      double(i+1)/double(n_control_step)*
+      (control_parameter_end-control_parameter_start);
+    }
+
+   // Do it (the other processes' output goes to a stream that isn't
+   // open)
+   ofstream critical_load_file;
+   if (problem.is_output_process())
+    {
+     critical_load_file.open((output_dir+"/critical_load.dat").c_str());
+    }
+   Vector<double> critical_load;
+   unsigned i_mode=0;
+   problem.track_critical_load(&parameters.T_mag,i_mode,
+                               control_parameter_pt,control_value,
+                               critical_load_file,critical_load);
+   critical_load_file.close();
+  }
+
+} // end of do_buckling_analysis
+
+
+
+//==start_of_solve_for_ensemble_of_tractions============================
+/// Solve for n_ensemble_member equally spaced tractions up to t_max at
+/// once (by the ensemble Newton method) and document the solutions
+//======================================================================
+template<class ELEMENT>
+void solve_for_ensemble_of_tractions(
+ UnstructuredFvKProblem<ELEMENT>& problem,
+ const double& t_max,
+ const unsigned& n_ensemble_member)
+{
+ // The problem's physical parameters
+ Parameters::ParameterSet& parameters=problem.parameters();
+
+ Vector<double*> parameter_pt(1,&parameters.T_mag);
+ Vector<Vector<double> > parameter_value(n_ensemble_member,
+                                         Vector<double>(1));
+ for (unsigned k=0;k<n_ensemble_member;k++)
+  {
+   parameter_value[k][0]=t_max*double(k+1)/double(n_ensemble_member);
+  }
+ Vector<Vector<double> > member_dofs;
+ problem.ensemble_newton_solve(parameter_pt,parameter_value,member_dofs);
+
+ // Document the solutions
+ for (unsigned k=0;k<n_ensemble_member;k++)
+  {
+   parameters.T_mag=parameter_value[k][0];
+   for (unsigned long i=0;i<problem.ndof();i++)
+    {
+     problem.dof(i)=member_dofs[k][i];
+    }
+   oomph_info << "Ensemble member " << k << ": Tau = "
+              << parameters.T_mag << " ; "
+              << problem.ensemble_nnewton_iter(k)
+              << " Newton iterations\n";
+   std::ostringstream comment;
+   comment << "ensemble member " << k;
+   problem.doc_solution(comment.str());
+  }
+
+} // end of solve_for_ensemble_of_tractions
+
+
+
+//==start_of_follow_transient_response==================================
+/// Follow the transient response to the traction t_max, suddenly
+/// applied to the current state, up to transient_end_time by adaptive
+/// implicit time steps (starting with dt)
+//======================================================================
+template<class ELEMENT>
+void follow_transient_response(UnstructuredFvKProblem<ELEMENT>& problem,
+                               const double& t_max,
+                               const double& transient_end_time,
+                               const double& dt,
+                               const double& temporal_error_tolerance,
+                               const std::string& time_integration_scheme,
+                               const double& mass_per_unit_area,
+                               const std::string& output_dir)
+{
+ // The problem's physical parameters
+ Parameters::ParameterSet& parameters=problem.parameters();
+
+ // The in-plane displacements and the deflection have inertia
+ Vector<unsigned> displacement_index(3);
+ displacement_index[0]=0;
+ displacement_index[1]=1;
+ displacement_index[2]=2;
+ problem.enable_dynamics(mass_per_unit_area,displacement_index);
+ if (time_integration_scheme=="bdf2")
+  {
+   problem.time_integration_scheme()=FvKSolverProblem::BDF2_scheme;
+  }
+
+ // Do it (keeping the factors of the Jacobian from one time step to the
+ // next, so they can be reused while dt doesn't change)
+ parameters.T_mag=t_max;
+ bool resolve_was_enabled=problem.linear_solver_pt()->is_resolve_enabled();
+ problem.linear_solver_pt()->enable_resolve();
+ double next_dt=dt;
+ while (problem.dynamic_time()<transient_end_time)
+  {
+   // Don't overshoot
+   double actual_dt=
+    std::min(next_dt,transient_end_time-problem.dynamic_time());
+   next_dt=problem.adaptive_implicit_time_step(actual_dt,
+                                               temporal_error_tolerance);
+   oomph_info << "Solved for t = " << problem.dynamic_time()
+              << " ; Tau = " << parameters.T_mag << "\n";
+   std::ostringstream comment;
+   comment << "t = " << problem.dynamic_time();
+   problem.doc_solution(comment.str());
+  }
+ if (!resolve_was_enabled)
+  {
+   problem.linear_solver_pt()->disable_resolve();
+  }
+
+ // Document the accepted and rejected time steps
+ if (problem.is_output_process())
+  {
+   ofstream time_step_file((output_dir+"/time_steps.dat").c_str());
+   problem.doc_time_step_history(time_step_file);
+   time_step_file.close();
+  }
+
+} // end of follow_transient_response
+
+
+
+//==start_of_continue_in_traction=======================================
+/// Continue from the current state in the traction (by arc-length
+/// continuation or adaptive load steps, starting with increment ds) until
+/// it exceeds t_max, handling changes in stability as specified by
+/// on_stability_change
+//======================================================================
+template<class ELEMENT>
+void continue_in_traction(UnstructuredFvKProblem<ELEMENT>& problem,
+                          double ds,
+                          const double& max_ds,
+                          const double& t_max,
+                          const std::string& on_stability_change,
+                          const double& min_ds_refine,
+                          const std::string& output_dir)
+{
+ // The problem's physical parameters
+ Parameters::ParameterSet& parameters=problem.parameters();
+
+ bool use_adaptive_load_stepping=CommandLineArgs::
+  command_line_flag_has_been_set("--use_adaptive_load_stepping");
+ problem.max_ds()=max_ds;
+ problem.max_dp()=max_ds;
+ unsigned max_nstep=100;
+ long n_negative_eigenvalue=problem.nnegative_jacobian_eigenvalue();
+ Vector<double> backup_dofs(problem.ndof());
+ unsigned n_step=0;
+ while (n_step<max_nstep)
+  {
+   // Backup the state in case we have to refine the step
+   for (unsigned long j=0;j<problem.ndof();j++)
+    {
+     backup_dofs[j]=problem.dof(j);
+    }
+   double backup_t_mag=parameters.T_mag;
+
+   // Do it
+   if (use_adaptive_load_stepping)
+    {
+     ds=problem.adaptive_load_step(&parameters.T_mag,ds);
+    }
+   else
+    {
+     ds=problem.continuation_step(&parameters.T_mag,ds);
+    }
+
+   oomph_info<< "Solved for P = "
+             << parameters.P_mag
+             << " ; Tau = " 
+             << parameters.T_mag << "\n";
+
+   // Increment actually taken (the step may have been cut)
+   double ds_taken=parameters.T_mag-backup_t_mag;
+
+   // Document
+   std::string comment="";
+   if (problem.sign_change_detected())
+    {
+     comment="fold/bifurcation passed";
+    }
+
+   // Has the stability changed?
+   long new_n_negative_eigenvalue=problem.nnegative_jacobian_eigenvalue();
+   bool stability_changed=((n_negative_eigenvalue>=0)&&
+                           (new_n_negative_eigenvalue!=
+                            n_negative_eigenvalue));
+   if (stability_changed)
+    {
+     // Go back and take a smaller step (this doesn't count as a
+     // step of the sweep)
+     if ((on_stability_change=="refine")&&
+         (0.5*std::fabs(ds_taken)>=min_ds_refine))
+      {
+       oomph_info << "Number of negative eigenvalues changed from "
+                  << n_negative_eigenvalue << " to "
+                  << new_n_negative_eigenvalue
+                  << "; refining the step\n";
+       for (unsigned long j=0;j<problem.ndof();j++)
+        {
+         problem.dof(j)=backup_dofs[j];
+        }
+       parameters.T_mag=backup_t_mag;
+       problem.reset_continuation();
+       problem.reset_load_step_predictor();
+       ds=0.5*ds_taken;
+       continue;
+      }
+     std::ostringstream stability_comment;
+     stability_comment << "stability changed: " << n_negative_eigenvalue
+                       << " -> " << new_n_negative_eigenvalue
+                       << " negative eigenvalues";
+     comment+=(comment=="" ? "" : "; ")+stability_comment.str();
+    }
+   n_negative_eigenvalue=new_n_negative_eigenvalue;
+   problem.doc_solution(comment);
+   n_step++;
+
+   // Done?
+   if (parameters.T_mag>t_max) break;
+   if (stability_changed&&(on_stability_change=="stop")) break;
+  }
+
+ // Document the accepted and rejected load steps
+ if (use_adaptive_load_stepping&&problem.is_output_process())
+  {
+   ofstream load_step_file((output_dir+"/load_steps.dat").c_str());
+   problem.doc_load_step_history(load_step_file);
+   load_step_file.close();
+  }
+
+} // end of continue_in_traction
+
+
+
 //=======start_of_main========================================
 ///Driver code for demo of inline triangle mesh generation
 //============================================================
 int main(int argc, char **argv)
 {
+#ifdef OOMPH_HAS_MPI
+ // Initialise MPI (only used by the domain decomposition preconditioner)
+ MPI_Helpers::init(argc,argv);
+#endif
+
  feenableexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW | FE_UNDERFLOW);
  // Store command line arguments
  CommandLineArgs::setup(argc,argv);
@@ -1348,21 +1946,246 @@ int main(int argc, char **argv)
  // were actually specified
 
 
+ // Directory for solution
+ string output_dir="RESLT";
+ CommandLineArgs::specify_command_line_flag("--dir", &output_dir);
+
  // Clamped boundary conditions?
   CommandLineArgs::specify_command_line_flag("--use_clamped_bc");
 
  // Poisson Ratio
  CommandLineArgs::specify_command_line_flag("--nu", &Parameters::Nu);
 
- // Applied Pressure
+ // Applied Pressure (if not specified: 0.01 for the clamped validation
+ // case, 0.001 for the shear buckling cases)
  CommandLineArgs::specify_command_line_flag("--p", &Parameters::P_mag);
 
+ // In-plane traction for the single solve of the clamped validation case
+ // and for the initial state of the shear buckling cases (default 0; the
+ // shear buckling sweeps then go up to --t_max, which is thus the
+ // traction axis in parameter_sweep.bash)
+ CommandLineArgs::specify_command_line_flag("--t_mag", &Parameters::T_mag);
+
  // FvK prameter
  CommandLineArgs::specify_command_line_flag("--eta", &Parameters::Eta);
 
+ // Get the initial state by a homotopy in this parameter (the name of
+ // any of the double command line flags, e.g. "eta"): it's ramped up
+ // from homotopy_start to its actual value by adaptive steps
+ string homotopy_parameter="";
+ CommandLineArgs::specify_command_line_flag("--homotopy_parameter",
+                                            &homotopy_parameter);
+
+ // Start value for the homotopy
+ double homotopy_start=1.0e2;
+ CommandLineArgs::specify_command_line_flag("--homotopy_start",
+                                            &homotopy_start);
+
+ // Initial increment for the homotopy (in the logarithm of the parameter
+ // if both the start and the target values are positive)
+ double homotopy_increment=1.0;
+ CommandLineArgs::specify_command_line_flag("--homotopy_increment",
+                                            &homotopy_increment);
+
  // Element Area 
  double element_area=0.09;
  CommandLineArgs::specify_command_line_flag("--element_area", &element_area);
+
+ // Initial arc-length increment for the shear buckling sweeps
+ double ds=1.0e-5;
+ CommandLineArgs::specify_command_line_flag("--ds", &ds);
+
+ // Max. arc-length increment for the shear buckling sweeps
+ double max_ds=2.5e-5;
+ CommandLineArgs::specify_command_line_flag("--max_ds", &max_ds);
+
+ // Max. traction magnitude for the shear buckling sweeps
+ double t_max=1.0e-4;
+ CommandLineArgs::specify_command_line_flag("--t_max", &t_max);
+
+ // Use adaptive load stepping rather than arc-length continuation
+ // for the shear buckling sweeps? (ds then specifies the initial
+ // increment in the traction)
+ CommandLineArgs::specify_command_line_flag("--use_adaptive_load_stepping");
+
+ // What to do when the inertia of the Jacobian (its number of negative
+ // eigenvalues, available with "--linear_solver ldlt") changes during
+ // the shear buckling sweeps: "none" (just doc it), "stop" or "refine"
+ // (repeatedly halve the step to localise the change)
+ string on_stability_change="none";
+ CommandLineArgs::specify_command_line_flag("--on_stability_change",
+                                            &on_stability_change);
+
+ // Min. step size when localising a change in stability
+ double min_ds_refine=1.0e-8;
+ CommandLineArgs::specify_command_line_flag("--min_ds_refine",
+                                            &min_ds_refine);
+
+ // Skip the shear buckling sweep and do a linearised buckling analysis
+ // at a single prestressed state instead?
+ CommandLineArgs::specify_command_line_flag("--buckling_analysis");
+
+ // Traction magnitude at which the buckling analysis is performed
+ double t_prestress=1.0e-5;
+ CommandLineArgs::specify_command_line_flag("--t_prestress", &t_prestress);
+
+ // Number of buckling modes to be computed
+ unsigned n_buckling_mode=4;
+ CommandLineArgs::specify_command_line_flag("--n_buckling_mode",
+                                            &n_buckling_mode);
+
+ // Follow the critical point of the first buckling mode as Nu or Eta
+ // varies ("nu" or "eta")?
+ string critical_load_control_parameter="";
+ CommandLineArgs::specify_command_line_flag("--track_critical_load_in",
+                                            &critical_load_control_parameter);
+
+ // Final value of the control parameter when tracking the critical point
+ double control_parameter_end=0.3;
+ CommandLineArgs::specify_command_line_flag("--control_parameter_end",
+                                            &control_parameter_end);
+
+ // Number of steps in the control parameter when tracking the
+ // critical point
+ unsigned n_control_step=10;
+ CommandLineArgs::specify_command_line_flag("--n_control_step",
+                                            &n_control_step);
+
+ // Skip the shear buckling sweep and enumerate (up to this many)
+ // coexisting equilibria at a single traction by deflated Newton solves
+ // from the same initial guess instead
+ unsigned n_deflated_solution=0;
+ CommandLineArgs::specify_command_line_flag("--n_deflated_solution",
+                                            &n_deflated_solution);
+
+ // Traction magnitude at which the coexisting equilibria are enumerated
+ double t_deflation=1.0e-4;
+ CommandLineArgs::specify_command_line_flag("--t_deflation", &t_deflation);
+
+ // Seed for a random perturbation of the initial guess for the deflated
+ // solves (independent runs with different seeds search in parallel; see
+ // find_deflated_solutions.bash)
+ unsigned deflation_seed=0;
+ CommandLineArgs::specify_command_line_flag("--deflation_seed",
+                                            &deflation_seed);
+
+ // Amplitude of that perturbation, relative to the max. norm of the dofs
+ double deflation_perturbation=0.1;
+ CommandLineArgs::specify_command_line_flag("--deflation_perturbation",
+                                            &deflation_perturbation);
+
+ // Skip the shear buckling sweep and collect the distinct solutions from
+ // the deflated_dofs<i>.dat files (written by runs with
+ // --n_deflated_solution) listed in this file instead
+ std::string merge_deflated_solutions_file="";
+ CommandLineArgs::specify_command_line_flag("--merge_deflated_solutions",
+                                            &merge_deflated_solutions_file);
+
+ // Skip the shear buckling sweep and solve for this many equally spaced
+ // tractions up to t_max simultaneously (by an ensemble Newton method,
+ // starting from the pressure-loaded state) instead
+ unsigned n_ensemble_member=0;
+ CommandLineArgs::specify_command_line_flag("--n_ensemble_member",
+                                            &n_ensemble_member);
+
+ // Skip the shear buckling sweep and follow the transient response to
+ // the traction t_max, applied suddenly to the pressure-loaded state, up
+ // to this time instead
+ double transient_end_time=0.0;
+ CommandLineArgs::specify_command_line_flag("--transient_end_time",
+                                            &transient_end_time);
+
+ // Initial time step for the transient response
+ double dt=1.0e-2;
+ CommandLineArgs::specify_command_line_flag("--dt", &dt);
+
+ // Tolerance for the (RMS) local truncation error in the adaptive
+ // time steps
+ double temporal_error_tolerance=1.0e-5;
+ CommandLineArgs::specify_command_line_flag("--temporal_error_tolerance",
+                                            &temporal_error_tolerance);
+
+ // Time integration scheme: "newmark" or "bdf2"
+ string time_integration_scheme="newmark";
+ CommandLineArgs::specify_command_line_flag("--time_integration_scheme",
+                                            &time_integration_scheme);
+
+ // Mass per unit area of the plate
+ double mass_per_unit_area=1.0;
+ CommandLineArgs::specify_command_line_flag("--mass_per_unit_area",
+                                            &mass_per_unit_area);
+
+ // Use GMRES (preconditioned by ILU(0)) rather than the default direct
+ // solver for the linear systems in the Newton iterations?
+ CommandLineArgs::specify_command_line_flag("--use_iterative_linear_solver");
+
+ // Choose the GMRES tolerance adaptively (inexact Newton with
+ // Eisenstat-Walker forcing terms)? Requires --use_iterative_linear_solver.
+ CommandLineArgs::specify_command_line_flag("--use_eisenstat_walker");
+
+ // Minimise the energy by a matrix-free trust-region Newton-CG method
+ // rather than using Newton's method (for the single solves and the
+ // adaptive load steps; arc-length continuation still uses Newton)
+ CommandLineArgs::specify_command_line_flag("--minimise_energy");
+
+ // Generate the initial guess for each nonlinear solve by (at most) this
+ // many steps of dynamic relaxation (zero: start from the current state)
+ unsigned n_dynamic_relaxation_step=0;
+ CommandLineArgs::specify_command_line_flag("--dynamic_relaxation_steps",
+                                            &n_dynamic_relaxation_step);
+
+ // ...stopping when the max. residual is below this tolerance
+ double dynamic_relaxation_tolerance=1.0e-3;
+ CommandLineArgs::specify_command_line_flag("--dynamic_relaxation_tolerance",
+                                            &dynamic_relaxation_tolerance);
+
+ // Direct linear solver (see FvKDirectSolvers::available_solvers();
+ // ignored if an iterative solver is used)
+ string linear_solver_name="default";
+ CommandLineArgs::specify_command_line_flag("--linear_solver",
+                                            &linear_solver_name);
+
+ // Options for the direct solvers (memory budget and scratch directory
+ // for "out_of_core_ldlt")
+ FvKDirectSolvers::specify_command_line_flags();
+
+ // Precondition GMRES by overlapping additive Schwarz (with a coarse
+ // space correction) rather than ILU(0)? The subdomains are distributed
+ // over the MPI processes.
+ CommandLineArgs::specify_command_line_flag("--use_additive_schwarz");
+
+ // Number of subdomains for additive Schwarz (defaults to the number of
+ // processes)
+ unsigned n_subdomain=0;
+ CommandLineArgs::specify_command_line_flag("--n_subdomain",&n_subdomain);
+
+ // Number of layers of overlap between the subdomains
+ unsigned n_overlap=1;
+ CommandLineArgs::specify_command_line_flag("--n_overlap",&n_overlap);
+
+ // Precondition the Krylov solver by two-level p-multigrid (with
+ // quadratic rather than cubic in-plane interpolation on the coarse level)
+ // rather than ILU(0)?
+ CommandLineArgs::specify_command_line_flag("--use_p_multigrid");
+
+ // Use GCRO-DR style Krylov subspace recycling instead of GMRES (with
+ // whichever preconditioner is selected)?
+ CommandLineArgs::specify_command_line_flag("--use_krylov_recycling");
+
+ // Max. dimension of the recycled subspace
+ unsigned max_recycle_dimension=10;
+ CommandLineArgs::specify_command_line_flag("--max_recycle_dimension",
+                                            &max_recycle_dimension);
+
+ // Equilibrate the Jacobian (with an initial scaling of the Hermite
+ // derivative dofs by the element size) before the linear solves? NOTE:
+ // The sign of the Jacobian is then not available to the continuation.
+ CommandLineArgs::specify_command_line_flag("--equilibrate_jacobian");
+
+ // Eliminate the in-plane displacements at the start of each Newton step
+ // so the Newton iteration only acts on the out-of-plane deflection?
+ CommandLineArgs::specify_command_line_flag(
+  "--eliminate_in_plane_displacements");
  
  // Parse command line
  CommandLineArgs::parse_and_assign();
@@ -1370,6 +2193,20 @@ int main(int argc, char **argv)
  // Doc what has actually been specified on the command line
  CommandLineArgs::doc_specified_flags();
 
+ if ((on_stability_change!="none")&&(on_stability_change!="stop")&&
+     (on_stability_change!="refine"))
+  {
+   throw OomphLibError(
+    "--on_stability_change must be one of none, stop or refine",
+    OOMPH_CURRENT_FUNCTION,OOMPH_EXCEPTION_LOCATION);
+  }
+ if ((time_integration_scheme!="newmark")&&(time_integration_scheme!="bdf2"))
+  {
+   throw OomphLibError(
+    "--time_integration_scheme must be one of newmark or bdf2",
+    OOMPH_CURRENT_FUNCTION,OOMPH_EXCEPTION_LOCATION);
+  }
+
 
 
   // Constant pressure for validation case
@@ -1382,59 +2219,311 @@ int main(int argc, char **argv)
  // UnstructuredFvKProblem<NON_WRAPPED_ELEMENT
  //UnstructuredFvKProblem<FvKPointForceAndSourceElement<NON_WRAPPED_ELEMENT>>
  UnstructuredFvKProblem<FoepplVonKarmanC1CurvableBellElement<4>> 
-  problem(element_area);
+  problem(element_area,output_dir);
+
+ // The problem's own physical parameters (initialised from the defaults
+ // in the Parameters namespace)
+ Parameters::ParameterSet& parameters=problem.parameters();
+
+ // Choose the direct solver
+ FvKDirectSolvers::set_solver(&problem,linear_solver_name);
+
+ // Minimise the energy rather than using Newton's method?
+ if (CommandLineArgs::command_line_flag_has_been_set("--minimise_energy"))
+  {
+   problem.enable_energy_minimisation();
+  }
 
+ // Get the initial guesses by dynamic relaxation?
+ if (n_dynamic_relaxation_step>0)
+  {
+   problem.enable_dynamic_relaxation_initial_guess(
+    n_dynamic_relaxation_step,dynamic_relaxation_tolerance);
+  }
 
- double dp_mag=0.000001;
- double dt_mag=0.000001;
- unsigned nstep=1000;
+ // Use an iterative linear solver?
+ if (CommandLineArgs::
+     command_line_flag_has_been_set("--use_iterative_linear_solver"))
+  {
+   // Recycle Krylov subspaces from one solve to the next?
+   IterativeLinearSolver* iterative_solver_pt=0;
+   if (CommandLineArgs::command_line_flag_has_been_set("--use_krylov_recycling"))
+    {
+     GCRODR* gcrodr_pt=new GCRODR;
+     gcrodr_pt->max_recycle_dimension()=max_recycle_dimension;
+     iterative_solver_pt=gcrodr_pt;
+    }
+   else
+    {
+     iterative_solver_pt=new GMRES<CRDoubleMatrix>;
+    }
 
+   if (CommandLineArgs::command_line_flag_has_been_set("--use_additive_schwarz"))
+    {
+     // Partition the mesh into geometrically compact subdomains
+     AdditiveSchwarzPreconditioner* schwarz_pt=
+      new AdditiveSchwarzPreconditioner;
+     if (n_subdomain==0)
+      {
+       n_subdomain=problem.communicator_pt()->nproc();
+      }
+     Vector<unsigned> dof_subdomain;
+     SubdomainPartitioningHelpers::
+      partition_dofs_by_mesh(problem.Problem::mesh_pt(),problem.ndof(),
+                             n_subdomain,dof_subdomain);
+     schwarz_pt->set_dof_subdomain(dof_subdomain);
+     schwarz_pt->nsubdomain()=n_subdomain;
+     schwarz_pt->noverlap()=n_overlap;
+
+     // Coarse space: constant u_x, u_y and w (nodal values 0, 1 and 2; not
+     // the derivatives of w) on each subdomain
+     Vector<unsigned> field_value_index(3);
+     field_value_index[0]=0;
+     field_value_index[1]=1;
+     field_value_index[2]=2;
+     schwarz_pt->set_coarse_space_fields(problem.Problem::mesh_pt(),
+                                         field_value_index);
+     iterative_solver_pt->preconditioner_pt()=schwarz_pt;
+    }
+   else if (CommandLineArgs::command_line_flag_has_been_set("--use_p_multigrid"))
+    {
+     // In-plane displacements are nodal values 0 and 1
+     PMultigridPreconditioner* p_multigrid_pt=new PMultigridPreconditioner;
+     Vector<unsigned> in_plane_value_index(2);
+     in_plane_value_index[0]=0;
+     in_plane_value_index[1]=1;
+     p_multigrid_pt->set_mesh(problem.Problem::mesh_pt(),in_plane_value_index);
+     iterative_solver_pt->preconditioner_pt()=p_multigrid_pt;
+    }
+   else
+    {
+     iterative_solver_pt->preconditioner_pt()=
+      new ILUZeroPreconditioner<CRDoubleMatrix>;
+    }
+   iterative_solver_pt->max_iter()=500;
+   problem.adopt_preconditioner(iterative_solver_pt->preconditioner_pt());
+   problem.adopt_linear_solver(iterative_solver_pt);
+   problem.linear_solver_pt()=iterative_solver_pt;
+
+   // Inexact Newton
+   if (CommandLineArgs::
+       command_line_flag_has_been_set("--use_eisenstat_walker"))
+    {
+     problem.enable_eisenstat_walker_forcing();
+    }
+  }
 
- // Which case are we doing
- if (Parameters::Problem_case==Parameters::Clamped_validation)
+ // Nonlinear elimination of the in-plane displacements (nodal values 0
+ // and 1); the in-plane block depends on Eta and Nu
+ if (CommandLineArgs::
+     command_line_flag_has_been_set("--eliminate_in_plane_displacements"))
   {
-   nstep=1;
-   dp_mag=0.01;
-   dt_mag=0.000001;
-   Parameters::P_mag=0.01;
-   Parameters::T_mag=0.0;
+   Vector<unsigned> in_plane_value_index(2);
+   in_plane_value_index[0]=0;
+   in_plane_value_index[1]=1;
+   Vector<double*> stiffness_parameter_pt(2);
+   stiffness_parameter_pt[0]=&parameters.Eta;
+   stiffness_parameter_pt[1]=&parameters.Nu;
+   problem.enable_in_plane_elimination(problem.Problem::mesh_pt(),
+                                       in_plane_value_index,
+                                       stiffness_parameter_pt);
+
+   // Use the specified direct solver for the in-plane block, too (the
+   // frontal solver can only solve a problem's linear systems, so
+   // SuperLU is used instead)
+   if ((linear_solver_name!="default")&&(linear_solver_name!="frontal"))
+    {
+     LinearSolver* in_plane_solver_pt=
+      FvKDirectSolvers::create_solver(linear_solver_name);
+     problem.adopt_linear_solver(in_plane_solver_pt);
+     problem.set_in_plane_linear_solver(in_plane_solver_pt);
+    }
   }
- // 
- else if (Parameters::Problem_case==Parameters::Axisymmetric_shear_buckling)
+
+ // Wrap the linear solver so it solves the equilibrated system
+ if (CommandLineArgs::command_line_flag_has_been_set("--equilibrate_jacobian"))
   {
-   nstep=100;
-   dp_mag=0.0;
-   dt_mag=0.000001;
-   Parameters::P_mag=0.001;
-   Parameters::T_mag=0.0;
+   if (CommandLineArgs::command_line_flag_has_been_set("--use_eisenstat_walker"))
+    {
+     throw OomphLibError(
+      "Can't (yet) combine equilibration with Eisenstat-Walker forcing",
+      OOMPH_CURRENT_FUNCTION,OOMPH_EXCEPTION_LOCATION);
+    }
+
+   // Nodal values: in-plane displacements (0,1), w (2), its first (3,4)
+   // and second (5,6,7) derivatives
+   Vector<unsigned> derivative_order(8,0);
+   derivative_order[3]=derivative_order[4]=1;
+   derivative_order[5]=derivative_order[6]=derivative_order[7]=2;
+   Vector<double> dof_scaling;
+   HermiteDofScalingHelpers::
+    get_dof_scaling(problem.Problem::mesh_pt(),problem.ndof(),
+                    derivative_order,dof_scaling);
+   EquilibratedLinearSolver* equilibrated_solver_pt=
+    new EquilibratedLinearSolver(problem.linear_solver_pt());
+   equilibrated_solver_pt->set_initial_scaling(dof_scaling);
+   problem.adopt_linear_solver(equilibrated_solver_pt);
+   problem.linear_solver_pt()=equilibrated_solver_pt;
   }
- else if (Parameters::Problem_case==Parameters::Nonaxisymmetric_shear_buckling)
+
+ // Changes in stability are detected from the inertia of the Jacobian,
+ // which is only available from the LDL^T solvers
+ if ((on_stability_change!="none")&&
+     (problem.nnegative_jacobian_eigenvalue()<0))
   {
-   nstep=100;
-   dp_mag=0.0;
-   dt_mag=0.000001;
-   Parameters::P_mag=0.001;
-   Parameters::T_mag=0.0;
+   throw OomphLibError(
+    "--on_stability_change requires --linear_solver ldlt or out_of_core_ldlt",
+    OOMPH_CURRENT_FUNCTION,OOMPH_EXCEPTION_LOCATION);
   }
-    
- // Loop
- for (unsigned i=0;i<nstep;i++)
+
+ // Validation case: Single solve
+ if (parameters.Problem_case==Parameters::Clamped_validation)
   {
+   if (!CommandLineArgs::command_line_flag_has_been_set("--p"))
+    {
+     parameters.P_mag=0.01;
+    }
+
    oomph_info<< "Solving for P = "
-             << Parameters::P_mag
+             << parameters.P_mag
              << " ; Tau = " 
-             << Parameters::T_mag << "\n";
+             << parameters.T_mag << "\n";
 
    // Do it
-   problem.newton_solve();
+   double t_start=TimingHelpers::timer();
+   if (homotopy_parameter!="")
+    {
+     problem.homotopy_solve(homotopy_parameter,homotopy_start,
+                            homotopy_increment);
+    }
+   else
+    {
+     problem.nonlinear_solve();
+    }
+   oomph_info << "Newton iterations: " << problem.nnewton_step()
+              << " ; in-plane solves: " << problem.nin_plane_elimination()
+              << " ; in-plane factorisations: "
+              << problem.nin_plane_factorisation()
+              << " ; solve time: " << TimingHelpers::timer()-t_start
+              << std::endl;
    
    // Document
    problem.doc_solution();
+  }
+ // Shear buckling cases: Pseudo-arclength continuation in the traction
+ // magnitude (allows us to pass limit points)
+ else if ((parameters.Problem_case==
+           Parameters::Axisymmetric_shear_buckling)||
+          (parameters.Problem_case==
+           Parameters::Nonaxisymmetric_shear_buckling))
+  {
+   if (!CommandLineArgs::command_line_flag_has_been_set("--p"))
+    {
+     parameters.P_mag=0.001;
+    }
+
+   // Get the initial (pressure-loaded) state
+   oomph_info<< "Solving for P = "
+             << parameters.P_mag
+             << " ; Tau = " 
+             << parameters.T_mag << "\n";
+   if (homotopy_parameter!="")
+    {
+     problem.homotopy_solve(homotopy_parameter,homotopy_start,
+                            homotopy_increment);
+    }
+   else
+    {
+     problem.nonlinear_solve();
+    }
+   problem.doc_solution();
+
+   // Then do what's been asked for
+   if (CommandLineArgs::
+       command_line_flag_has_been_set("--merge_deflated_solutions"))
+    {
+     // Collect the equilibria found by parallel deflation runs
+     merge_deflated_solutions(problem,t_deflation,
+                              merge_deflated_solutions_file);
+    }
+   else if (CommandLineArgs::
+            command_line_flag_has_been_set("--n_deflated_solution"))
+    {
+     // Enumerate coexisting equilibria by deflation
+     find_deflated_solutions(problem,t_deflation,n_deflated_solution,
+                             deflation_seed,deflation_perturbation,
+                             output_dir);
+    }
+   else if (CommandLineArgs::
+            command_line_flag_has_been_set("--buckling_analysis"))
+    {
+     // Linearised buckling analysis at a single prestressed state
+     do_buckling_analysis(problem,t_prestress,n_buckling_mode,
+                          critical_load_control_parameter,
+                          control_parameter_end,n_control_step,output_dir);
+    }
+   else if (CommandLineArgs::
+            command_line_flag_has_been_set("--n_ensemble_member"))
+    {
+     // Solve for many tractions at once
+     solve_for_ensemble_of_tractions(problem,t_max,n_ensemble_member);
+    }
+   else if (CommandLineArgs::
+            command_line_flag_has_been_set("--transient_end_time"))
+    {
+     // Follow the transient response to the suddenly applied traction
+     follow_transient_response(problem,t_max,transient_end_time,dt,
+                               temporal_error_tolerance,
+                               time_integration_scheme,mass_per_unit_area,
+                               output_dir);
+    }
+   else
+    {
+     // Continue in the traction
+     continue_in_traction(problem,ds,max_ds,t_max,on_stability_change,
+                          min_ds_refine,output_dir);
+    }
+  }
 
-   // Bump
-   Parameters::T_mag+=dt_mag;
-   Parameters::P_mag+=dp_mag;
+ // Document the trust-region iterations (only one process writes the
+ // output)
+ if (CommandLineArgs::command_line_flag_has_been_set("--minimise_energy")&&
+     problem.is_output_process())
+  {
+   ofstream energy_file((output_dir+"/energy_minimisation.dat").c_str());
+   problem.doc_energy_minimisation_history(energy_file);
+   energy_file.close();
+  }
+
+ // Document the nonlinear and linear iteration counts for each Newton
+ // iteration
+ if (CommandLineArgs::command_line_flag_has_been_set("--use_eisenstat_walker")&&
+     problem.is_output_process())
+  {
+   ofstream newton_krylov_file(
+    (output_dir+"/newton_krylov_history.dat").c_str());
+   problem.doc_inexact_newton_history(newton_krylov_file);
+   newton_krylov_file.close();
+  }
 
+ // Document the iteration counts for the recycled Krylov solves
+ LinearSolver* linear_solver_pt=problem.linear_solver_pt();
+ EquilibratedLinearSolver* equilibrated_solver_pt=
+  dynamic_cast<EquilibratedLinearSolver*>(linear_solver_pt);
+ if (equilibrated_solver_pt!=0)
+  {
+   linear_solver_pt=equilibrated_solver_pt->solver_pt();
+  }
+ GCRODR* gcrodr_pt=dynamic_cast<GCRODR*>(linear_solver_pt);
+ if ((gcrodr_pt!=0)&&problem.is_output_process())
+  {
+   ofstream recycling_file((output_dir+"/krylov_recycling.dat").c_str());
+   gcrodr_pt->doc_iteration_history(recycling_file);
+   recycling_file.close();
   }
+
+#ifdef OOMPH_HAS_MPI
+ MPI_Helpers::finalize();
+#endif
  
  } //End of main
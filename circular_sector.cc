@@ -37,6 +37,12 @@
 // The mesh
 #include "meshes/triangle_mesh.h"
 
+// Shared solution strategies (continuation etc.)
+#include "fvk_solver_problem.h"
+
+// Linear solvers
+#include "fvk_linear_solvers.h"
+
 using namespace std;
 using namespace oomph;
 using MathematicalConstants::Pi;
@@ -73,6 +79,12 @@ using MathematicalConstants::Pi;
 
 namespace Parameters
 {
+  /// Number of problems in existence: The elements read these
+  /// (process-wide) parameters directly, rather than those of the
+  /// problem that's being solved (cf. circular_disc), so there can only
+  /// be one problem at a time
+  unsigned Nproblem = 0;
+
   /// Opening angle of the domain corner
   double Alpha = Pi/4.0;
   
@@ -93,6 +105,10 @@ namespace Parameters
 
   /// Magnitude of pressure
   double P_mag = 10.0;
+
+  /// Boundary condition for the out-of-plane displacement along the
+  /// circular arc: "resting_pin", "sliding_clamp", "true_clamp" or "free"
+  std::string Circular_arc_bc = "resting_pin";
  
   //                     PARAMETRIC BOUNDARY DEFINITIONS
   /// Here we create the geom objects for the Parametric Boundary Definition
@@ -286,17 +302,22 @@ namespace Parameters
 /// Class definition
 //====================================================================
 template<class ELEMENT>
-class UnstructuredFvKProblem : public virtual Problem
+class UnstructuredFvKProblem : public virtual FvKSolverProblem
 {
 
 public:
 
-  /// Constructor
-  UnstructuredFvKProblem(double element_area = 0.09);
+  /// Constructor: Pass the target element area and the directory for
+  /// the output
+  UnstructuredFvKProblem(double element_area = 0.09,
+                         const std::string& output_dir = "RESLT");
 
   /// Destructor
   ~UnstructuredFvKProblem()
   {
+    // Release the global parameters
+    Parameters::Nproblem--;
+
     Trace_file.close();
     delete (Surface_mesh_pt);
     delete (Bulk_mesh_pt);
@@ -324,13 +345,30 @@ public:
   /// Empty as the boundary conditions stay fixed
   void actions_before_newton_solve()
   {
+    FvKSolverProblem::actions_before_newton_solve();
+
     // Reapply boundary conditions
     apply_boundary_conditions();
   }
+
+  /// Re-apply the boundary conditions for each member of an ensemble
+  /// Newton solve
+  void apply_parameter_dependent_boundary_conditions()
+  {
+    apply_boundary_conditions();
+  }
  
   /// Doc the solution
   void doc_solution(const std::string& comment="");
 
+  /// Out-of-plane dofs (in the normal-tangential basis) that are pinned
+  /// for the specified type of boundary condition ("free", "resting_pin",
+  /// "sliding_clamp" or "true_clamp")
+  static Vector<unsigned> pinned_w_dofs(const std::string& bc);
+
+  /// Pin the specified out-of-plane dofs along the circular arc
+  void pin_circular_arc_w_dofs(const Vector<unsigned>& pinned_dofs);
+
   /// Overloaded version of the problem's access function to
   /// the mesh. Recasts the pointer to the base Mesh object to
   /// the actual mesh type.
@@ -421,11 +459,22 @@ private:
 /// Constructor definition
 //======================================================================
 template<class ELEMENT>
-UnstructuredFvKProblem<ELEMENT>::UnstructuredFvKProblem(double element_area)
+UnstructuredFvKProblem<ELEMENT>::UnstructuredFvKProblem(double element_area,
+                                                        const std::string&
+                                                        output_dir)
   :
   Element_area(element_area),
   Solve_linear_bending(true)
 {
+  // The elements use the global parameters, so there can only be one
+  // problem at a time
+  if (Parameters::Nproblem++ > 0)
+  {
+    throw OomphLibError("Only one problem can use the global Parameters",
+                        OOMPH_CURRENT_FUNCTION,
+                        OOMPH_EXCEPTION_LOCATION);
+  }
+
   // Build the mesh
   build_mesh();
 
@@ -438,9 +487,11 @@ UnstructuredFvKProblem<ELEMENT>::UnstructuredFvKProblem(double element_area)
   // Store number of bulk elements
   complete_problem_setup();
 
-  char filename[100];
-  sprintf(filename, "RESLT/trace.dat");
-  Trace_file.open(filename);
+  // Set directory
+  Doc_info.set_directory(output_dir);
+
+  // Open trace file
+  Trace_file.open((output_dir+"/trace.dat").c_str());
 
   oomph_info << "Number of equations: "
 	     << assign_eqn_numbers() << '\n';
@@ -585,13 +636,8 @@ void UnstructuredFvKProblem<ELEMENT>::apply_boundary_conditions()
   static const Vector<unsigned> pin_ut_dofs{1};
   static const Vector<unsigned> pin_inplane_dofs{0,1};
   
-  // Out-of-plane dofs:
-  // |  0  |  1  |  2  |  3  |  4  |  5  |
-  // |  w  | w_n | w_t | w_nn| w_nt| w_tt|
   // Possible boundary conditions for the out-of-plane displacement
-  static const Vector<unsigned> resting_pin_dofs{0,2,5};
-  static const Vector<unsigned> sliding_clamp_dofs{1,4};
-  static const Vector<unsigned> true_clamp_dofs{0,1,2,4,5};
+  static const Vector<unsigned> resting_pin_dofs=pinned_w_dofs("resting_pin");
 
   //----------------------------------------------------------------------------
   // Assign boundary conditions to each edge (do circular arc manually)
@@ -600,7 +646,8 @@ void UnstructuredFvKProblem<ELEMENT>::apply_boundary_conditions()
   Vector<unsigned> circular_arc_pinned_u_dofs = pin_inplane_dofs;
   Vector<unsigned> straight_edge_0_pinned_w_dofs = resting_pin_dofs;
   Vector<unsigned> straight_edge_1_pinned_w_dofs = resting_pin_dofs;
-  // Vector<unsigned> circular_arc_pinned_w_dofs = true_clamp_dofs;
+  Vector<unsigned> circular_arc_pinned_w_dofs =
+    pinned_w_dofs(Parameters::Circular_arc_bc);
  
   // Allocate storage for the number of elements and dofs
   unsigned n_b_element = 0;
@@ -610,7 +657,6 @@ void UnstructuredFvKProblem<ELEMENT>::apply_boundary_conditions()
   // Loop over the circular arc elements
   n_b_element = Bulk_mesh_pt->nboundary_element(Circular_arc_bnum);
   n_pinned_u_dofs = circular_arc_pinned_u_dofs.size();
-  // n_pinned_w_dofs = circular_arc_pinned_w_dofs.size();
   for(unsigned e=0;e<n_b_element;e++)
     {
       // Get pointer to bulk element adjacent to curved arc
@@ -626,40 +672,11 @@ void UnstructuredFvKProblem<ELEMENT>::apply_boundary_conditions()
 					       Circular_arc_bnum,
 					       Parameters::get_null_fct);
 	}
-      // Pin out-of-plane dofs (resting pin -- only set tangent derivatives)
-      for(unsigned idof=0; idof<6; ++idof)
-	{
-	  switch(idof)
-	    {
-	      // [hierher] Make function of arclength rather than global x
-	    case 0:
-	      // w
-	      el_pt->fix_out_of_plane_displacement_dof(idof,
-						       Circular_arc_bnum,
-						       Parameters::get_null_fct);
-	      // Parameters::get_w_along_arc);
-	      break;
-	    case 2:
-	      // dwdt
-	      el_pt->fix_out_of_plane_displacement_dof(idof,
-						       Circular_arc_bnum,
-						       Parameters::get_null_fct);
-	      // Parameters::get_dwdt_along_arc);
-	      break;
-	    case 5:
-	      // d2wdt2
-	      el_pt->fix_out_of_plane_displacement_dof(idof,
-						       Circular_arc_bnum,
-						       Parameters::get_null_fct);
-	      // Parameters::get_d2wdt2_along_arc);
-	      break;
-	    default:
-	      // Leave free
-	      break;
-	    } // End of switch-case [idof]
-	} // End loop over dofs [idof]
     } // End loop over boundary elements [e]
 
+  // Pin out-of-plane dofs on the circular arc
+  pin_circular_arc_w_dofs(circular_arc_pinned_w_dofs);
+
   // Loop over straight side 0 elements and apply homogenous BCs
   n_b_element = Bulk_mesh_pt->nboundary_element(Straight_edge_0_bnum);
   n_pinned_u_dofs = straight_edge_0_pinned_u_dofs.size();
@@ -723,6 +740,75 @@ void UnstructuredFvKProblem<ELEMENT>::apply_boundary_conditions()
 
 
 
+//==start_of_pinned_w_dofs================================================
+/// Out-of-plane dofs that are pinned for the specified type of boundary
+/// condition
+//========================================================================
+template<class ELEMENT>
+Vector<unsigned> UnstructuredFvKProblem<ELEMENT>::
+pinned_w_dofs(const std::string& bc)
+{
+  // Out-of-plane dofs:
+  // |  0  |  1  |  2  |  3  |  4  |  5  |
+  // |  w  | w_n | w_t | w_nn| w_nt| w_tt|
+  // Possible boundary conditions for the out-of-plane displacement
+  static const Vector<unsigned> free_dofs{};
+  static const Vector<unsigned> resting_pin_dofs{0,2,5};
+  static const Vector<unsigned> sliding_clamp_dofs{1,4};
+  static const Vector<unsigned> true_clamp_dofs{0,1,2,4,5};
+  if(bc=="free")
+    {
+      return free_dofs;
+    }
+  else if(bc=="resting_pin")
+    {
+      return resting_pin_dofs;
+    }
+  else if(bc=="sliding_clamp")
+    {
+      return sliding_clamp_dofs;
+    }
+  else if(bc=="true_clamp")
+    {
+      return true_clamp_dofs;
+    }
+  throw OomphLibError("Unknown boundary condition "+bc,
+		      OOMPH_CURRENT_FUNCTION,
+		      OOMPH_EXCEPTION_LOCATION);
+}
+
+
+
+//==start_of_pin_circular_arc_w_dofs======================================
+/// Pin the specified out-of-plane dofs along the circular arc
+//========================================================================
+template<class ELEMENT>
+void UnstructuredFvKProblem<ELEMENT>::
+pin_circular_arc_w_dofs(const Vector<unsigned>& pinned_dofs)
+{
+  unsigned n_b_element = Bulk_mesh_pt->nboundary_element(Circular_arc_bnum);
+  unsigned n_pinned_w_dofs = pinned_dofs.size();
+  for(unsigned e=0;e<n_b_element;e++)
+    {
+      // Get pointer to bulk element adjacent to curved arc
+      ELEMENT* el_pt =
+	dynamic_cast<ELEMENT*>(Bulk_mesh_pt
+			       ->boundary_element_pt(Circular_arc_bnum,e));
+
+      // [hierher] Make function of arclength rather than global x (e.g.
+      // Parameters::get_w_along_arc, get_dwdt_along_arc and
+      // get_d2wdt2_along_arc for the resting pin)
+      for(unsigned i=0; i<n_pinned_w_dofs; i++)
+	{
+	  el_pt->fix_out_of_plane_displacement_dof(pinned_dofs[i],
+						   Circular_arc_bnum,
+						   Parameters::get_null_fct);
+	} // End loop over out-of-plane dofs [i]
+    } // End loop over boundary elements [e]
+}
+
+
+
 //==============================================================================
 /// A function that upgrades straight sided elements to be curved. This involves
 // Setting up the parametric boundary, F(s) and the first derivative F'(s)
@@ -913,12 +999,13 @@ void UnstructuredFvKProblem<ELEMENT>::doc_solution(const
 						   std::string& comment)
 {
   ofstream some_file;
-  char filename[100];
+  char filename[500];
 
   // Number of plot points
   unsigned npts = 5;
 
-  sprintf(filename,"RESLT/soln%i-%f.dat",Doc_info.number(),Element_area);
+  sprintf(filename,"%s/soln%i-%f.dat",Doc_info.directory().c_str(),
+          Doc_info.number(),Element_area);
   some_file.open(filename);
   Bulk_mesh_pt->output(some_file,npts);
   some_file << "TEXT X = 22, Y = 92, CS=FRAME T = \""
@@ -929,7 +1016,8 @@ void UnstructuredFvKProblem<ELEMENT>::doc_solution(const
   //---------------------------------------------------
   //double error,norm,dummy_error,zero_norm;
   double dummy_error,zero_norm;
-  sprintf(filename,"RESLT/error%i-%f.dat",Doc_info.number(),Element_area);
+  sprintf(filename,"%s/error%i-%f.dat",Doc_info.directory().c_str(),
+          Doc_info.number(),Element_area);
   some_file.open(filename);
 
   Bulk_mesh_pt->compute_error(some_file,Parameters::dummy_exact_w,
@@ -961,7 +1049,8 @@ void UnstructuredFvKProblem<ELEMENT>::doc_solution(const
 
   // Doc error and return of the square of the L2 error
   //---------------------------------------------------
-  sprintf(filename,"RESLT/L2-norm%i-%f.dat",
+  sprintf(filename,"%s/L2-norm%i-%f.dat",
+	  Doc_info.directory().c_str(),
 	  Doc_info.number(),
 	  Element_area);
   some_file.open(filename);
@@ -1008,21 +1097,172 @@ int main(int argc, char **argv)
   // Element Area (no larger element than 0.09)
   double element_area=0.09;
   CommandLineArgs::specify_command_line_flag("--element_area", &element_area);
+
+  // Globalisation of the Newton iteration: "line_search", "trust_region"
+  // or "none"
+  string newton_globalisation="line_search";
+  CommandLineArgs::specify_command_line_flag("--newton_globalisation",
+                                             &newton_globalisation);
+
+  // Direct linear solver (see FvKDirectSolvers::available_solvers())
+  string linear_solver_name="default";
+  CommandLineArgs::specify_command_line_flag("--linear_solver",
+                                             &linear_solver_name);
+
+  // Options for the direct solvers (memory budget and scratch directory
+  // for "out_of_core_ldlt")
+  FvKDirectSolvers::specify_command_line_flags();
+
+  // Boundary condition for w along the circular arc
+  CommandLineArgs::specify_command_line_flag("--circular_arc_bc",
+                                             &Parameters::Circular_arc_bc);
+
+  // Solve for all (resting pin, sliding clamp and true clamp) boundary
+  // conditions on the circular arc, imposing them as constraints on the
+  // problem with a free arc so the equation numbering (and, with
+  // --reuse_jacobian, the factorised Jacobian) is shared
+  CommandLineArgs::specify_command_line_flag("--compare_circular_arc_bcs");
+
+  // Re-use the Jacobian (only sensible if the problem is (nearly) linear)
+  CommandLineArgs::specify_command_line_flag("--reuse_jacobian");
+
+  // Directory in which the factorisations of the Jacobian are cached
+  // for subsequent runs (requires --linear_solver ldlt)
+  string factorisation_cache_dir="";
+  CommandLineArgs::specify_command_line_flag("--factorisation_cache_dir",
+                                             &factorisation_cache_dir);
  
   // Parse command line
   CommandLineArgs::parse_and_assign();
  
   // Doc what has actually been specified on the command line
   CommandLineArgs::doc_specified_flags();
+
+  // The variants are constraints on the problem with a free arc
+  bool compare_circular_arc_bcs=CommandLineArgs::
+    command_line_flag_has_been_set("--compare_circular_arc_bcs");
+  if (compare_circular_arc_bcs)
+    {
+      Parameters::Circular_arc_bc="free";
+    }
   UnstructuredFvKProblem<FoepplVonKarmanC1CurvableBellElement<4> >
-    problem(element_area);
+    problem(element_area,output_dir);
+
+  // Choose the linear solver
+  FvKDirectSolvers::set_solver(&problem,linear_solver_name);
+
+  // Cache the factorisations, keyed by everything that determines the
+  // Jacobian (the solver adds the equation numbering and the dofs)
+  if (factorisation_cache_dir!="")
+    {
+      SymmetricLDLTSolver* ldlt_solver_pt=
+        dynamic_cast<SymmetricLDLTSolver*>(problem.linear_solver_pt());
+      if (ldlt_solver_pt==0)
+        {
+          throw OomphLibError(
+            "--factorisation_cache_dir requires --linear_solver ldlt",
+            OOMPH_CURRENT_FUNCTION,
+            OOMPH_EXCEPTION_LOCATION);
+        }
+      ostringstream cache_key;
+      cache_key << setprecision(17) << "circular_sector"
+                << " alpha=" << Parameters::Alpha
+                << " nu=" << Parameters::Nu
+                << " eta=" << Parameters::Eta
+                << " eta_linear=" << Parameters::Eta_linear
+                << " element_area=" << element_area
+                << " circular_arc_bc=" << Parameters::Circular_arc_bc;
+      ldlt_solver_pt->enable_factorisation_cache(factorisation_cache_dir,
+                                                 cache_key.str());
+    }
  
-  // Set up some problem paramters
-  problem.max_residuals()=1e3;
+  // Set up some problem paramters: Damp the Newton steps so the
+  // residual decreases monotonically rather than relaxing the checks for
+  // divergence (solves that still fail are caught by the load stepping)
+  if (newton_globalisation=="line_search")
+    {
+      problem.enable_newton_line_search();
+    }
+  else if (newton_globalisation=="trust_region")
+    {
+      problem.enable_newton_trust_region();
+    }
+  else if (newton_globalisation=="none")
+    {
+      problem.disable_newton_globalisation();
+      problem.max_residuals()=1e3;
+    }
+  else
+    {
+      throw OomphLibError("Unknown Newton globalisation "+newton_globalisation,
+                          OOMPH_CURRENT_FUNCTION,
+                          OOMPH_EXCEPTION_LOCATION);
+    }
   problem.max_newton_iterations()=20;
+  if (CommandLineArgs::command_line_flag_has_been_set("--reuse_jacobian"))
+    {
+      problem.enable_jacobian_reuse();
+    }
+
+  // Solve for each boundary condition on the circular arc in turn by
+  // low-rank updates of the (free arc) Jacobian
+  if (compare_circular_arc_bcs)
+    {
+      double target_p_mag=Parameters::P_mag;
+      Vector<string> arc_bc(3);
+      arc_bc[0]="resting_pin";
+      arc_bc[1]="sliding_clamp";
+      arc_bc[2]="true_clamp";
+      for (unsigned b=0;b<arc_bc.size();b++)
+        {
+          // Turn the additional pins into constraints
+          problem.store_nodal_eqn_numbers();
+          problem.pin_circular_arc_w_dofs(problem.pinned_w_dofs(arc_bc[b]));
+          problem.convert_new_pins_to_constrained_dofs();
+
+          // Start from the undeformed state
+          for (unsigned long i=0;i<problem.ndof();i++)
+            {
+              problem.dof(i)=0.0;
+            }
+          problem.reset_load_step_predictor();
+          Parameters::P_mag=0.0;
+          problem.adaptive_load_step_to(&Parameters::P_mag,target_p_mag,
+                                        target_p_mag);
+          oomph_info << "Solved with " << arc_bc[b] << " circular arc ("
+                     << problem.nconstrained_dof() << " constrained dofs; "
+                     << problem.nconstraint_response_solve()
+                     << " back-substitutions for the constraints so far)"
+                     << std::endl;
+          problem.doc_solution(arc_bc[b]);
+          problem.clear_constrained_dofs();
+        }
+      oomph_info<<"Exiting Normally\n";
+      return 0;
+    }
  
-  // Do the newton solve
-  problem.steady_newton_solve();
+  // Step the pressure up from zero to its target value (in a single
+  // step if the Newton solver converges)
+  double target_p_mag=Parameters::P_mag;
+  Parameters::P_mag=0.0;
+  problem.adaptive_load_step_to(&Parameters::P_mag,target_p_mag,target_p_mag);
+
+  // Document the accepted and rejected load steps
+  ofstream load_step_file((output_dir+"/load_steps.dat").c_str());
+  problem.doc_load_step_history(load_step_file);
+  load_step_file.close();
+  if (factorisation_cache_dir!="")
+    {
+      oomph_info << "Number of factorisations read from the cache: "
+                 << dynamic_cast<SymmetricLDLTSolver*>(
+                      problem.linear_solver_pt())->ncache_hit()
+                 << std::endl;
+    }
+  oomph_info << "Number of damped Newton steps: "
+             << problem.ndamped_newton_step() << " (additional residual "
+             << "evaluations: "
+             << problem.nresidual_evaluation_in_globalisation() << ")"
+             << std::endl;
  
   // Document
   problem.doc_solution();
@@ -0,0 +1,54 @@
+#! /bin/bash
+
+# Enumerate the coexisting equilibria of the shear-buckled circular disc
+# in parallel. Deflation is sequential within a run (each solve deflates
+# the solutions found before it), so several independent deflation runs
+# are scheduled across the cores (by parameter_sweep.bash), each starting
+# from a differently perturbed initial guess (--deflation_seed). The
+# solutions they find are then merged (duplicates removed) by a final
+# run with --merge_deflated_solutions. Usage:
+#
+#   ./find_deflated_solutions.bash [-j n_job] [-n n_run] [-o dir] \
+#       [circular_disc flags]
+#
+# e.g.
+#
+#   ./find_deflated_solutions.bash -n 8 --n_deflated_solution 5 \
+#       --t_deflation 1.0e-4
+#
+# The flags are passed to every run (they must include
+# --n_deflated_solution). Run i writes its output to dir/case<i>
+# (default dir: RESLT_deflation); the distinct solutions are documented
+# in dir/merged.
+
+n_job=`nproc`
+n_run=`nproc`
+out_dir=RESLT_deflation
+while getopts "j:n:o:" option; do
+    case $option in
+        j) n_job=$OPTARG ;;
+        n) n_run=$OPTARG ;;
+        o) out_dir=$OPTARG ;;
+        *) echo "Unknown option; see the comments at the top of $0"
+           exit 1 ;;
+    esac
+done
+shift $((OPTIND-1))
+flags="$*"
+
+if [[ "$flags" != *--n_deflated_solution* ]]; then
+    echo "Please specify --n_deflated_solution"
+    exit 1
+fi
+
+# Do the deflation runs in parallel, one per seed
+seeds=`seq -s, 1 $n_run`
+./parameter_sweep.bash -j $n_job -o $out_dir circular_disc \
+    --deflation_seed $seeds -- $flags || exit 1
+
+# Merge their solutions
+ls $out_dir/case*/deflated_dofs*.dat > $out_dir/dofs_files.dat 2> /dev/null
+mkdir $out_dir/merged
+./circular_disc $flags --merge_deflated_solutions $out_dir/dofs_files.dat \
+    --dir $out_dir/merged > $out_dir/merged/OUTPUT 2>&1
+grep "distinct solutions" $out_dir/merged/OUTPUT
@@ -0,0 +1,1353 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2023 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Header file for a symmetric (skyline) LDL^T solver for the FvK drivers
+#ifndef OOMPH_FVK_LDLT_SOLVER_HEADER
+#define OOMPH_FVK_LDLT_SOLVER_HEADER
+
+// Generic oomph-lib routines
+#include "generic.h"
+
+// Memory mapping of cached factorisations
+#include <cstdint>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace oomph
+{
+
+  //===========================================================================
+  /// Symbolic analysis for the skyline LDL^T factorisation: the fill
+  /// reducing (reverse Cuthill-McKee) ordering of the dofs and the
+  /// resulting profile of the upper triangle. It only depends on the
+  /// connectivity of the dofs and can therefore be shared by all
+  /// matrices with the same sparsity pattern.
+  //===========================================================================
+  class SkylineStructure
+  {
+  public:
+    /// Constructor
+    SkylineStructure() {}
+
+    /// Build the structure from the lists of the (global) dofs that are
+    /// coupled to each other (e.g. the dofs of each element)
+    void build(const unsigned long& n_dof,
+               const Vector<Vector<unsigned long>>& coupled_dofs)
+    {
+      build_reverse_cuthill_mckee_ordering(n_dof, coupled_dofs);
+
+      // Row of the first entry in each column of the upper triangle
+      First_row.resize(n_dof);
+      for (unsigned long j = 0; j < n_dof; j++)
+      {
+        First_row[j] = j;
+      }
+      const unsigned long n_set = coupled_dofs.size();
+      for (unsigned long e = 0; e < n_set; e++)
+      {
+        const unsigned n_coupled = coupled_dofs[e].size();
+        if (n_coupled == 0)
+        {
+          continue;
+        }
+        unsigned long min_index = n_dof;
+        for (unsigned i = 0; i < n_coupled; i++)
+        {
+          min_index = std::min(min_index, Perm[coupled_dofs[e][i]]);
+        }
+        for (unsigned i = 0; i < n_coupled; i++)
+        {
+          unsigned long j = Perm[coupled_dofs[e][i]];
+          First_row[j] = std::min(First_row[j], min_index);
+        }
+      }
+
+      setup_column_start();
+    }
+
+    /// Build the structure from a given ordering (the position of each
+    /// dof) and the first rows of the columns, e.g. as read from file
+    void build(const Vector<unsigned long>& perm,
+               const Vector<unsigned long>& first_row)
+    {
+      const unsigned long n_dof = perm.size();
+      Perm = perm;
+      Inverse_perm.resize(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        Inverse_perm[Perm[i]] = i;
+      }
+      First_row = first_row;
+      setup_column_start();
+    }
+
+    /// Number of dofs
+    unsigned long ndof() const
+    {
+      return First_row.size();
+    }
+
+    /// Number of entries in the profile of the upper triangle
+    unsigned long nprofile() const
+    {
+      return Column_start.empty() ? 0 : Column_start.back();
+    }
+
+    /// Position of a dof in the (new) ordering
+    unsigned long perm(const unsigned long& i) const
+    {
+      return Perm[i];
+    }
+
+    /// Dof at the specified position in the (new) ordering
+    unsigned long inverse_perm(const unsigned long& j) const
+    {
+      return Inverse_perm[j];
+    }
+
+    /// Row of the first entry in column j (in the new ordering)
+    unsigned long first_row(const unsigned long& j) const
+    {
+      return First_row[j];
+    }
+
+    /// Offset of column j in the profile storage: entry (i,j), i <= j,
+    /// lives at column_start(j) + i - first_row(j)
+    unsigned long column_start(const unsigned long& j) const
+    {
+      return Column_start[j];
+    }
+
+    /// Position of entry (i,j) (i <= j, in the new ordering) in the
+    /// profile storage
+    unsigned long position(const unsigned long& i, const unsigned long& j)
+      const
+    {
+      return Column_start[j] + i - First_row[j];
+    }
+
+  private:
+    /// Offsets of the columns in the profile storage
+    void setup_column_start()
+    {
+      const unsigned long n_dof = First_row.size();
+      Column_start.resize(n_dof + 1);
+      Column_start[0] = 0;
+      for (unsigned long j = 0; j < n_dof; j++)
+      {
+        Column_start[j + 1] = Column_start[j] + (j - First_row[j] + 1);
+      }
+    }
+
+    /// Reverse Cuthill-McKee ordering of the dofs, using the total size of
+    /// the coupled sets that contain each dof as its (approximate) degree
+    void build_reverse_cuthill_mckee_ordering(
+      const unsigned long& n_dof,
+      const Vector<Vector<unsigned long>>& coupled_dofs)
+    {
+      // Sets containing each dof and the approximate degrees
+      Vector<Vector<unsigned long>> dof_set(n_dof);
+      Vector<unsigned long> degree(n_dof, 0);
+      const unsigned long n_set = coupled_dofs.size();
+      for (unsigned long e = 0; e < n_set; e++)
+      {
+        const unsigned n_coupled = coupled_dofs[e].size();
+        for (unsigned i = 0; i < n_coupled; i++)
+        {
+          dof_set[coupled_dofs[e][i]].push_back(e);
+          degree[coupled_dofs[e][i]] += n_coupled;
+        }
+      }
+
+      // Breadth-first traversal from a dof of min. degree in each
+      // connected component, visiting neighbours in order of increasing
+      // degree
+      Vector<unsigned long> order;
+      order.reserve(n_dof);
+      std::vector<bool> visited(n_dof, false);
+      Vector<unsigned long> by_degree(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        by_degree[i] = i;
+      }
+      std::stable_sort(by_degree.begin(),
+                       by_degree.end(),
+                       [&](const unsigned long& a, const unsigned long& b) {
+                         return degree[a] < degree[b];
+                       });
+      Vector<unsigned long> neighbours;
+      for (unsigned long k = 0; k < n_dof; k++)
+      {
+        unsigned long seed = by_degree[k];
+        if (visited[seed])
+        {
+          continue;
+        }
+        visited[seed] = true;
+        unsigned long first = order.size();
+        order.push_back(seed);
+        while (first < order.size())
+        {
+          unsigned long i = order[first++];
+          neighbours.clear();
+          const unsigned n_i_set = dof_set[i].size();
+          for (unsigned s = 0; s < n_i_set; s++)
+          {
+            const Vector<unsigned long>& set = coupled_dofs[dof_set[i][s]];
+            const unsigned n_coupled = set.size();
+            for (unsigned c = 0; c < n_coupled; c++)
+            {
+              if (!visited[set[c]])
+              {
+                visited[set[c]] = true;
+                neighbours.push_back(set[c]);
+              }
+            }
+          }
+          std::stable_sort(
+            neighbours.begin(),
+            neighbours.end(),
+            [&](const unsigned long& a, const unsigned long& b) {
+              return degree[a] < degree[b];
+            });
+          order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
+      }
+
+      // Reverse
+      Perm.resize(n_dof);
+      Inverse_perm.resize(n_dof);
+      for (unsigned long k = 0; k < n_dof; k++)
+      {
+        Inverse_perm[k] = order[n_dof - 1 - k];
+        Perm[Inverse_perm[k]] = k;
+      }
+    }
+
+    /// Position of each dof in the new ordering
+    Vector<unsigned long> Perm;
+
+    /// Dof at each position in the new ordering
+    Vector<unsigned long> Inverse_perm;
+
+    /// Row of the first entry in each column (in the new ordering)
+    Vector<unsigned long> First_row;
+
+    /// Offsets of the columns in the profile storage
+    Vector<unsigned long> Column_start;
+  };
+
+
+  //===========================================================================
+  /// Direct solver for symmetric systems: The upper triangle of the
+  /// matrix is assembled directly (element by element, without ever
+  /// forming the full matrix) into skyline (profile) storage, after a
+  /// reverse Cuthill-McKee reordering of the dofs, and factorised as
+  /// \f$ A = L D L^T \f$ (Crout's algorithm, without pivoting). Compared
+  /// to a general LU solver this halves the storage for the matrix and
+  /// the work for the factorisation. Since the FvK equations are derived
+  /// from a potential energy, their Jacobian is symmetric for
+  /// conservative loads.
+  ///
+  /// The inertia of the matrix (the numbers of positive, negative and
+  /// zero pivots) is available after each factorisation (and the sign of
+  /// the Jacobian is passed to the problem, as required for arc-length
+  /// continuation).
+  ///
+  /// When the symmetry check is enabled (by default if PARANOID is
+  /// defined) the element matrices are checked for symmetry during the
+  /// first assembly. The symbolic analysis (ordering and profile) is
+  /// re-used as long as the number of dofs doesn't change (call
+  /// reset_symbolic_analysis() if the equation numbering changes
+  /// otherwise).
+  ///
+  /// The factorisations can be cached on disk (for runs that repeatedly
+  /// solve the same linear problem in separate processes): Each file is
+  /// keyed by a hash of a user-specified string (which must identify the
+  /// mesh, the parameters and the boundary conditions), the equation
+  /// numbering and the current values of the dofs (on which the Jacobian
+  /// of a nonlinear problem depends). If the file exists it is memory
+  /// mapped and the assembly of the Jacobian and its factorisation are
+  /// skipped; only the residuals are assembled. The back-substitutions
+  /// read the factors straight from the mapping (which is kept until the
+  /// next factorisation or clean_up_memory()) rather than from a copy.
+  //===========================================================================
+  class SymmetricLDLTSolver : public LinearSolver
+  {
+  public:
+    /// Constructor
+    SymmetricLDLTSolver()
+      : Structure_pt(0),
+        Structure_can_be_deleted(false),
+#ifdef PARANOID
+        Check_symmetry(true),
+#else
+        Check_symmetry(false),
+#endif
+        Symmetry_tolerance(1.0e-8),
+        Nassembly(0),
+        Npositive_pivot(0),
+        Nnegative_pivot(0),
+        Nzero_pivot(0),
+        Zero_pivot_tolerance(1.0e-14),
+        Is_factorised(false),
+        Doc_stats(false),
+        Ncache_hit(0),
+        Cache_map_pt(0),
+        Cache_map_size(0),
+        Mapped_factors_pt(0)
+    {
+    }
+
+    /// Broken copy constructor
+    SymmetricLDLTSolver(const SymmetricLDLTSolver&) = delete;
+
+    /// Broken assignment operator
+    void operator=(const SymmetricLDLTSolver&) = delete;
+
+    /// Destructor
+    virtual ~SymmetricLDLTSolver()
+    {
+      clean_up_memory();
+      reset_symbolic_analysis();
+    }
+
+    /// Check the element matrices for symmetry during the first assembly
+    void enable_symmetry_check()
+    {
+      Check_symmetry = true;
+    }
+
+    /// Don't check the symmetry
+    void disable_symmetry_check()
+    {
+      Check_symmetry = false;
+    }
+
+    /// Relative tolerance for the symmetry check
+    double& symmetry_tolerance()
+    {
+      return Symmetry_tolerance;
+    }
+
+    /// Pivots whose magnitude is below this tolerance (relative to the
+    /// magnitude of the corresponding diagonal entry of the matrix) are
+    /// treated as zero (default 1e-14): Without pivoting, the
+    /// factorisation can't proceed past them, so it throws an error
+    double& zero_pivot_tolerance()
+    {
+      return Zero_pivot_tolerance;
+    }
+
+    /// Doc the size of the profile and the inertia after each
+    /// factorisation
+    void enable_doc_stats()
+    {
+      Doc_stats = true;
+    }
+
+    /// Don't doc the stats
+    void disable_doc_stats()
+    {
+      Doc_stats = false;
+    }
+
+    /// Number of positive pivots in the last factorisation
+    unsigned long npositive_pivot() const
+    {
+      return Npositive_pivot;
+    }
+
+    /// Number of negative pivots in the last factorisation (the number
+    /// of negative eigenvalues of the matrix, by Sylvester's law of
+    /// inertia)
+    unsigned long nnegative_pivot() const
+    {
+      return Nnegative_pivot;
+    }
+
+    /// Number of zero pivots in the last factorisation
+    unsigned long nzero_pivot() const
+    {
+      return Nzero_pivot;
+    }
+
+    /// Sign of the determinant of the last matrix factorised
+    int sign_of_determinant() const
+    {
+      if (Nzero_pivot > 0)
+      {
+        return 0;
+      }
+      return (Nnegative_pivot % 2 == 0) ? 1 : -1;
+    }
+
+    /// Number of entries in the profile (memory for the matrix and its
+    /// factors, in doubles)
+    unsigned long nprofile() const
+    {
+      return (Structure_pt == 0) ? 0 : Structure_pt->nprofile();
+    }
+
+    /// Cache the factorisations in the specified directory, keyed by
+    /// (a hash of) the specified string, the equation numbering and the
+    /// dofs. The key must identify everything else that affects the
+    /// Jacobian (mesh, parameters, boundary conditions). A cached
+    /// factorisation replaces any shared symbolic analysis.
+    void enable_factorisation_cache(const std::string& directory,
+                                    const std::string& key)
+    {
+      Cache_directory = directory;
+      Cache_key = key;
+    }
+
+    /// Don't cache the factorisations (default)
+    void disable_factorisation_cache()
+    {
+      Cache_directory = "";
+    }
+
+    /// Number of factorisations read from the cache
+    unsigned ncache_hit() const
+    {
+      return Ncache_hit;
+    }
+
+    /// Use the specified (shared) symbolic analysis rather than building
+    /// our own; it must match the problem's dofs
+    void set_structure(SkylineStructure* const& structure_pt)
+    {
+      reset_symbolic_analysis();
+      Structure_pt = structure_pt;
+      Structure_can_be_deleted = false;
+    }
+
+    /// The symbolic analysis (null if not built yet)
+    SkylineStructure* structure_pt() const
+    {
+      return Structure_pt;
+    }
+
+    /// Forget the symbolic analysis (it's rebuilt for the next solve)
+    void reset_symbolic_analysis()
+    {
+      if (Structure_can_be_deleted)
+      {
+        delete Structure_pt;
+      }
+      Structure_pt = 0;
+      Structure_can_be_deleted = false;
+    }
+
+    /// Solve the linear system J dx = r for the problem's Jacobian and
+    /// residuals: Assemble the upper triangle, factorise and solve
+    void solve(Problem* const& problem_pt, DoubleVector& result)
+    {
+      double t_start = TimingHelpers::timer();
+      const unsigned long n_dof = problem_pt->ndof();
+
+      // Try the cache first
+      std::string cache_file_name;
+      bool cache_hit = false;
+      if (!Cache_directory.empty())
+      {
+        cache_file_name = factorisation_cache_file_name(problem_pt);
+        cache_hit = read_cached_factors(cache_file_name, n_dof);
+      }
+
+      DoubleVector residuals;
+      if (cache_hit)
+      {
+        problem_pt->get_residuals(residuals);
+        Ncache_hit++;
+      }
+      else
+      {
+        if ((Structure_pt == 0) || (Structure_pt->ndof() != n_dof))
+        {
+          build_structure(problem_pt);
+        }
+        assemble(problem_pt, residuals);
+        factorise();
+        if (!Cache_directory.empty())
+        {
+          write_cached_factors(cache_file_name);
+        }
+      }
+      problem_pt->sign_of_jacobian() = sign_of_determinant();
+
+      back_substitute(residuals, result);
+      if (!Enable_resolve)
+      {
+        clean_up_memory();
+      }
+      if (Doc_time)
+      {
+        oomph_info << "Time for LDL^T solve [sec]: "
+                   << TimingHelpers::timer() - t_start << std::endl;
+      }
+    }
+
+    /// Solve the linear system A x = rhs (only the upper triangle of the
+    /// matrix is used, so the matrix is checked for symmetry if required;
+    /// the symbolic analysis is built from the matrix's sparsity pattern)
+    void solve(DoubleMatrixBase* const& matrix_pt,
+               const DoubleVector& rhs,
+               DoubleVector& result)
+    {
+      CRDoubleMatrix* cr_matrix_pt = dynamic_cast<CRDoubleMatrix*>(matrix_pt);
+      if ((cr_matrix_pt == 0) || cr_matrix_pt->distributed())
+      {
+        throw OomphLibError(
+          "SymmetricLDLTSolver requires a non-distributed CRDoubleMatrix",
+          OOMPH_CURRENT_FUNCTION,
+          OOMPH_EXCEPTION_LOCATION);
+      }
+      const unsigned long n_row = cr_matrix_pt->nrow();
+      const double* value_pt = cr_matrix_pt->value();
+      const int* column_index_pt = cr_matrix_pt->column_index();
+      const int* row_start_pt = cr_matrix_pt->row_start();
+
+      // Symbolic analysis from the rows' sparsity patterns
+      if ((Structure_pt == 0) || (Structure_pt->ndof() != n_row))
+      {
+        Vector<Vector<unsigned long>> coupled_dofs(n_row);
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+          {
+            coupled_dofs[i].push_back(column_index_pt[k]);
+          }
+        }
+        reset_symbolic_analysis();
+        Structure_pt = new SkylineStructure;
+        Structure_can_be_deleted = true;
+        Structure_pt->build(n_row, coupled_dofs);
+      }
+
+      // Copy the upper triangle
+      unmap_cached_factors();
+      Factors.assign(Structure_pt->nprofile(), 0.0);
+      for (unsigned long i = 0; i < n_row; i++)
+      {
+        unsigned long i_new = Structure_pt->perm(i);
+        for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+        {
+          unsigned long j_new = Structure_pt->perm(column_index_pt[k]);
+          if (i_new <= j_new)
+          {
+            Factors[Structure_pt->position(i_new, j_new)] = value_pt[k];
+          }
+        }
+      }
+      if (Check_symmetry)
+      {
+        check_symmetry(cr_matrix_pt);
+      }
+      factorise();
+      back_substitute(rhs, result);
+      if (!Enable_resolve)
+      {
+        clean_up_memory();
+      }
+    }
+
+    /// Re-solve with the factors from the last solve
+    void resolve(const DoubleVector& rhs, DoubleVector& result)
+    {
+      if (!Is_factorised)
+      {
+        throw OomphLibError("No factorisation for resolve",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      back_substitute(rhs, result);
+    }
+
+    /// Delete (or unmap) the factors (the symbolic analysis is retained)
+    void clean_up_memory()
+    {
+      unmap_cached_factors();
+      Factors.clear();
+      Factors.shrink_to_fit();
+      Is_factorised = false;
+    }
+
+  protected:
+    /// Build the symbolic analysis from the problem's elements
+    void build_structure(Problem* const& problem_pt)
+    {
+      Mesh* mesh_pt = problem_pt->mesh_pt();
+      AssemblyHandler* handler_pt = problem_pt->assembly_handler_pt();
+      const unsigned long n_element = mesh_pt->nelement();
+      Vector<Vector<unsigned long>> coupled_dofs(n_element);
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        coupled_dofs[e].resize(n_el_dof);
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          coupled_dofs[e][i] = handler_pt->eqn_number(el_pt, i);
+        }
+      }
+      reset_symbolic_analysis();
+      Structure_pt = new SkylineStructure;
+      Structure_can_be_deleted = true;
+      Structure_pt->build(problem_pt->ndof(), coupled_dofs);
+      if (Doc_stats)
+      {
+        oomph_info << "LDL^T: " << problem_pt->ndof() << " dofs; "
+                   << Structure_pt->nprofile() << " entries in profile"
+                   << std::endl;
+      }
+    }
+
+    /// Assemble the residuals and the upper triangle of the Jacobian
+    /// (in the new ordering) into the profile storage
+    void assemble(Problem* const& problem_pt, DoubleVector& residuals)
+    {
+      residuals.build(problem_pt->dof_distribution_pt(), 0.0);
+      unmap_cached_factors();
+      Factors.assign(Structure_pt->nprofile(), 0.0);
+
+      Mesh* mesh_pt = problem_pt->mesh_pt();
+      AssemblyHandler* handler_pt = problem_pt->assembly_handler_pt();
+      const unsigned long n_element = mesh_pt->nelement();
+      Vector<double> el_residuals;
+      DenseMatrix<double> el_jacobian;
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        el_residuals.resize(n_el_dof);
+        el_jacobian.resize(n_el_dof, n_el_dof);
+        handler_pt->get_jacobian(el_pt, el_residuals, el_jacobian);
+        if (Check_symmetry && (Nassembly == 0))
+        {
+          check_symmetry(e, el_jacobian);
+        }
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          unsigned long eqn_i = handler_pt->eqn_number(el_pt, i);
+          residuals[eqn_i] += el_residuals[i];
+          unsigned long i_new = Structure_pt->perm(eqn_i);
+          for (unsigned j = 0; j < n_el_dof; j++)
+          {
+            unsigned long j_new =
+              Structure_pt->perm(handler_pt->eqn_number(el_pt, j));
+            if (i_new <= j_new)
+            {
+              Factors[Structure_pt->position(i_new, j_new)] +=
+                el_jacobian(i, j);
+            }
+          }
+        }
+      }
+      Nassembly++;
+    }
+
+    /// Check the symmetry of the element matrix
+    void check_symmetry(const unsigned long& e,
+                        const DenseMatrix<double>& el_jacobian)
+    {
+      const unsigned long n = el_jacobian.nrow();
+      double max_entry = 0.0;
+      for (unsigned long i = 0; i < n; i++)
+      {
+        for (unsigned long j = 0; j < n; j++)
+        {
+          max_entry = std::max(max_entry, std::fabs(el_jacobian(i, j)));
+        }
+      }
+      for (unsigned long i = 0; i < n; i++)
+      {
+        for (unsigned long j = i + 1; j < n; j++)
+        {
+          double difference = std::fabs(el_jacobian(i, j) - el_jacobian(j, i));
+          if (difference > Symmetry_tolerance * max_entry)
+          {
+            std::ostringstream error_stream;
+            error_stream << "Jacobian of element " << e
+                         << " is not symmetric: J(" << i << "," << j
+                         << ") = " << el_jacobian(i, j) << " but J(" << j
+                         << "," << i << ") = " << el_jacobian(j, i)
+                         << std::endl;
+            throw OomphLibError(error_stream.str(),
+                                OOMPH_CURRENT_FUNCTION,
+                                OOMPH_EXCEPTION_LOCATION);
+          }
+        }
+      }
+    }
+
+    /// Check the symmetry of the matrix whose upper triangle has just
+    /// been copied into the profile storage: Compare the transpose of its
+    /// lower triangle with it.
+    void check_symmetry(const CRDoubleMatrix* const& cr_matrix_pt)
+    {
+      const unsigned long n_row = cr_matrix_pt->nrow();
+      const double* value_pt = cr_matrix_pt->value();
+      const int* column_index_pt = cr_matrix_pt->column_index();
+      const int* row_start_pt = cr_matrix_pt->row_start();
+      Vector<double> lower_transpose(Structure_pt->nprofile(), 0.0);
+      double max_entry = 0.0;
+      for (unsigned long i = 0; i < n_row; i++)
+      {
+        unsigned long i_new = Structure_pt->perm(i);
+        for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+        {
+          max_entry = std::max(max_entry, std::fabs(value_pt[k]));
+          unsigned long j_new = Structure_pt->perm(column_index_pt[k]);
+          if (i_new >= j_new)
+          {
+            lower_transpose[Structure_pt->position(j_new, i_new)] =
+              value_pt[k];
+          }
+        }
+      }
+      double max_difference = 0.0;
+      const unsigned long n_profile = Structure_pt->nprofile();
+      for (unsigned long k = 0; k < n_profile; k++)
+      {
+        max_difference =
+          std::max(max_difference, std::fabs(Factors[k] - lower_transpose[k]));
+      }
+      if (max_difference > Symmetry_tolerance * max_entry)
+      {
+        std::ostringstream error_stream;
+        error_stream << "Matrix is not symmetric: max. |A(i,j) - A(j,i)| = "
+                     << max_difference << " but max. |A(i,j)| = " << max_entry
+                     << std::endl;
+        throw OomphLibError(error_stream.str(),
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+    }
+
+    /// Factorise the matrix in the profile storage in place (Crout):
+    /// Column j of the upper triangle is overwritten by the entries of
+    /// row j of L (l_ij for i < j) and the pivot d_j. Also get the inertia.
+    void factorise()
+    {
+      const unsigned long n = Structure_pt->ndof();
+      Npositive_pivot = 0;
+      Nnegative_pivot = 0;
+      Nzero_pivot = 0;
+      for (unsigned long j = 0; j < n; j++)
+      {
+        double a_jj = Factors[Structure_pt->position(j, j)];
+        factorise_column(j);
+        update_inertia(Factors[Structure_pt->position(j, j)], a_jj);
+      }
+      Is_factorised = true;
+      if (Doc_stats)
+      {
+        oomph_info << "LDL^T inertia: " << Npositive_pivot << " positive, "
+                   << Nnegative_pivot << " negative, " << Nzero_pivot
+                   << " zero pivots" << std::endl;
+      }
+    }
+
+    /// Factorise column j (all previous columns must have been
+    /// factorised): first compute g_ij = a_ij - sum_r l_ri g_rj for
+    /// first_row(j) <= i < j, then l_ij = g_ij / d_i and
+    /// d_j = a_jj - sum_i l_ij g_ij. Throws if the pivot d_j is zero (to
+    /// within the zero_pivot_tolerance(), relative to a_jj), since
+    /// dividing by it would produce meaningless factors (and inertia).
+    void factorise_column(const unsigned long& j)
+    {
+      const unsigned long m_j = Structure_pt->first_row(j);
+      double* col_j = column_pt(j);
+      const double a_jj = col_j[j];
+      for (unsigned long i = m_j + 1; i < j; i++)
+      {
+        const unsigned long m_i = Structure_pt->first_row(i);
+        const double* col_i = column_pt(i);
+        double sum = 0.0;
+        for (unsigned long r = std::max(m_i, m_j); r < i; r++)
+        {
+          sum += col_i[r] * col_j[r];
+        }
+        col_j[i] -= sum;
+      }
+      double d_j = a_jj;
+      for (unsigned long i = m_j; i < j; i++)
+      {
+        double g = col_j[i];
+        col_j[i] = g / column_pt(i)[i];
+        d_j -= col_j[i] * g;
+      }
+      if (std::fabs(d_j) <= Zero_pivot_tolerance * std::fabs(a_jj))
+      {
+        std::ostringstream error_stream;
+        error_stream << "(Near-)zero pivot " << d_j << " (for a diagonal "
+                     << "entry " << a_jj << ") in LDL^T factorisation at "
+                     << "position " << j << ": The matrix is singular or "
+                     << "can't be factorised without pivoting; use "
+                     << "SuperLU instead" << std::endl;
+        throw OomphLibError(error_stream.str(),
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      col_j[j] = d_j;
+    }
+
+    /// Count the pivot d_j (for the diagonal entry a_jj of the matrix)
+    /// in the inertia
+    void update_inertia(const double& d_j, const double& a_jj)
+    {
+      if (std::fabs(d_j) <= Zero_pivot_tolerance * std::fabs(a_jj))
+      {
+        Nzero_pivot++;
+      }
+      else if (d_j > 0.0)
+      {
+        Npositive_pivot++;
+      }
+      else
+      {
+        Nnegative_pivot++;
+      }
+    }
+
+    /// Name of the cache file for the problem's current Jacobian: the
+    /// (FNV-1a) hash of the key, the equation numbering and the dofs
+    std::string factorisation_cache_file_name(Problem* const& problem_pt)
+    {
+      uint64_t hash = 14695981039346656037ULL;
+      hash_bytes(Cache_key.data(), Cache_key.size(), hash);
+      Mesh* mesh_pt = problem_pt->mesh_pt();
+      AssemblyHandler* handler_pt = problem_pt->assembly_handler_pt();
+      const unsigned long n_element = mesh_pt->nelement();
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          uint64_t eqn = handler_pt->eqn_number(el_pt, i);
+          hash_bytes(&eqn, sizeof(eqn), hash);
+        }
+      }
+      const unsigned long n_dof = problem_pt->ndof();
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        double value = problem_pt->dof(i);
+        hash_bytes(&value, sizeof(value), hash);
+      }
+      std::ostringstream file_name;
+      file_name << Cache_directory << "/ldlt_" << std::hex << hash
+                << ".dat";
+      return file_name.str();
+    }
+
+    /// Add the bytes to the (FNV-1a) hash
+    static void hash_bytes(const void* data,
+                           const size_t& n_byte,
+                           uint64_t& hash)
+    {
+      const unsigned char* byte = static_cast<const unsigned char*>(data);
+      for (size_t i = 0; i < n_byte; i++)
+      {
+        hash ^= byte[i];
+        hash *= 1099511628211ULL;
+      }
+    }
+
+    /// Read the symbolic analysis from the cache file and memory map its
+    /// factors (the mapping is kept and column_pt(...) serves the columns
+    /// from it until the next factorisation). Returns false if the file
+    /// doesn't exist or doesn't match the problem. File layout (native
+    /// binary): magic number, number of dofs, size of the profile, the
+    /// pivot counts, the ordering and first rows and the factors.
+    bool read_cached_factors(const std::string& file_name,
+                             const unsigned long& n_dof)
+    {
+      int file_descriptor = open(file_name.c_str(), O_RDONLY);
+      if (file_descriptor < 0)
+      {
+        return false;
+      }
+      struct stat file_stat;
+      if ((fstat(file_descriptor, &file_stat) != 0) ||
+          (size_t(file_stat.st_size) < Cache_header_size))
+      {
+        close(file_descriptor);
+        return false;
+      }
+      const size_t file_size = file_stat.st_size;
+      void* map_pt =
+        mmap(0, file_size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+      close(file_descriptor);
+      if (map_pt == MAP_FAILED)
+      {
+        return false;
+      }
+
+      // Check the header
+      const uint64_t* header_pt = static_cast<const uint64_t*>(map_pt);
+      const uint64_t n_profile = header_pt[2];
+      const size_t expected_size = Cache_header_size +
+                                   2 * n_dof * sizeof(uint64_t) +
+                                   n_profile * sizeof(double);
+      if ((header_pt[0] != Cache_magic) || (header_pt[1] != n_dof) ||
+          (file_size != expected_size))
+      {
+        munmap(map_pt, file_size);
+        return false;
+      }
+      Npositive_pivot = header_pt[3];
+      Nnegative_pivot = header_pt[4];
+      Nzero_pivot = header_pt[5];
+
+      // Symbolic analysis
+      const uint64_t* perm_pt = header_pt + Cache_header_nentry;
+      const uint64_t* first_row_pt = perm_pt + n_dof;
+      Vector<unsigned long> perm(perm_pt, perm_pt + n_dof);
+      Vector<unsigned long> first_row(first_row_pt, first_row_pt + n_dof);
+      reset_symbolic_analysis();
+      Structure_pt = new SkylineStructure;
+      Structure_can_be_deleted = true;
+      Structure_pt->build(perm, first_row);
+
+      // Factors (read-only: they're only used in the back-substitutions)
+      unmap_cached_factors();
+      Factors.clear();
+      Factors.shrink_to_fit();
+      Cache_map_pt = map_pt;
+      Cache_map_size = file_size;
+      Mapped_factors_pt =
+        reinterpret_cast<double*>(const_cast<uint64_t*>(first_row_pt + n_dof));
+      Is_factorised = true;
+      if (Doc_stats)
+      {
+        oomph_info << "LDL^T: read factors from " << file_name << std::endl;
+      }
+      return true;
+    }
+
+    /// Release the mapping of the cached factors (if any)
+    void unmap_cached_factors()
+    {
+      if (Cache_map_pt != 0)
+      {
+        munmap(Cache_map_pt, Cache_map_size);
+        Cache_map_pt = 0;
+        Cache_map_size = 0;
+        Mapped_factors_pt = 0;
+      }
+    }
+
+    /// Write the symbolic analysis and the factors to the cache file (via
+    /// a temporary file, so concurrent runs never see a partial file)
+    void write_cached_factors(const std::string& file_name) const
+    {
+      const unsigned long n_dof = Structure_pt->ndof();
+      std::ostringstream tmp_file_name;
+      tmp_file_name << file_name << ".tmp" << getpid();
+      std::ofstream cache_file(tmp_file_name.str().c_str(),
+                               std::ios::binary);
+      if (!cache_file)
+      {
+        oomph_info << "LDL^T: can't write the cache file "
+                   << tmp_file_name.str() << std::endl;
+        return;
+      }
+      uint64_t header[Cache_header_nentry] = {Cache_magic,
+                                              n_dof,
+                                              Structure_pt->nprofile(),
+                                              Npositive_pivot,
+                                              Nnegative_pivot,
+                                              Nzero_pivot};
+      cache_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+      Vector<uint64_t> index(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        index[i] = Structure_pt->perm(i);
+      }
+      cache_file.write(reinterpret_cast<const char*>(&index[0]),
+                       n_dof * sizeof(uint64_t));
+      for (unsigned long j = 0; j < n_dof; j++)
+      {
+        index[j] = Structure_pt->first_row(j);
+      }
+      cache_file.write(reinterpret_cast<const char*>(&index[0]),
+                       n_dof * sizeof(uint64_t));
+      cache_file.write(reinterpret_cast<const char*>(&Factors[0]),
+                       Factors.size() * sizeof(double));
+      cache_file.close();
+      std::rename(tmp_file_name.str().c_str(), file_name.c_str());
+    }
+
+    /// Solve L D L^T x = b with the factors
+    void back_substitute(const DoubleVector& rhs, DoubleVector& result)
+    {
+      const unsigned long n = Structure_pt->ndof();
+      Vector<double> x(n);
+      for (unsigned long j = 0; j < n; j++)
+      {
+        x[Structure_pt->perm(j)] = rhs[j];
+      }
+      solve_with_factors(x);
+      result.build(rhs.distribution_pt(), 0.0);
+      for (unsigned long j = 0; j < n; j++)
+      {
+        result[j] = x[Structure_pt->perm(j)];
+      }
+    }
+
+    /// Column j of the profile storage, offset so that entry (i,j) is at
+    /// column_pt(j)[i] (for first_row(j) <= i <= j). After a cache hit the
+    /// columns are in the (read-only) mapping of the cache file.
+    virtual double* column_pt(const unsigned long& j)
+    {
+      double* factors_pt =
+        (Mapped_factors_pt != 0) ? Mapped_factors_pt : Factors.data();
+      return factors_pt + Structure_pt->column_start(j) -
+             Structure_pt->first_row(j);
+    }
+
+    /// Solve L D L^T x = b (in the new ordering) in place
+    virtual void solve_with_factors(Vector<double>& x)
+    {
+      const unsigned long n = Structure_pt->ndof();
+
+      // L y = b
+      for (unsigned long j = 0; j < n; j++)
+      {
+        const unsigned long m_j = Structure_pt->first_row(j);
+        const double* col_j = column_pt(j);
+        double sum = 0.0;
+        for (unsigned long r = m_j; r < j; r++)
+        {
+          sum += col_j[r] * x[r];
+        }
+        x[j] -= sum;
+      }
+
+      // D z = y
+      for (unsigned long j = 0; j < n; j++)
+      {
+        x[j] /= column_pt(j)[j];
+      }
+
+      // L^T x = z
+      for (unsigned long j = n; j-- > 0;)
+      {
+        const unsigned long m_j = Structure_pt->first_row(j);
+        const double* col_j = column_pt(j);
+        for (unsigned long r = m_j; r < j; r++)
+        {
+          x[r] -= col_j[r] * x[j];
+        }
+      }
+    }
+
+    /// Symbolic analysis
+    SkylineStructure* Structure_pt;
+
+    /// Did we build the symbolic analysis (and can we delete it)?
+    bool Structure_can_be_deleted;
+
+    /// Check the symmetry of the element matrices in the first assembly?
+    bool Check_symmetry;
+
+    /// Relative tolerance for the symmetry check
+    double Symmetry_tolerance;
+
+    /// Number of assemblies performed
+    unsigned Nassembly;
+
+    /// Number of positive pivots
+    unsigned long Npositive_pivot;
+
+    /// Number of negative pivots
+    unsigned long Nnegative_pivot;
+
+    /// Number of zero pivots
+    unsigned long Nzero_pivot;
+
+    /// Tolerance for zero pivots
+    double Zero_pivot_tolerance;
+
+    /// Matrix/factors in profile storage
+    Vector<double> Factors;
+
+    /// Have the factors been computed?
+    bool Is_factorised;
+
+    /// Doc the stats?
+    bool Doc_stats;
+
+    /// Directory for the cached factorisations (none if empty)
+    std::string Cache_directory;
+
+    /// User-specified part of the key for the cached factorisations
+    std::string Cache_key;
+
+    /// Number of factorisations read from the cache
+    unsigned Ncache_hit;
+
+    /// Memory mapping of the cache file that the factors were read from
+    /// (null if the factors are in Factors)
+    void* Cache_map_pt;
+
+    /// Size of the mapping (in bytes)
+    size_t Cache_map_size;
+
+    /// Start of the factors in the mapping
+    double* Mapped_factors_pt;
+
+    /// Identifies (the version of) the format of the cache files
+    /// ("FVKLDLT1")
+    static const uint64_t Cache_magic = 0x31544c444c4b5646ULL;
+
+    /// Number of integers in the header of the cache files
+    static const unsigned Cache_header_nentry = 6;
+
+    /// Size of the header of the cache files (in bytes)
+    static const size_t Cache_header_size =
+      Cache_header_nentry * sizeof(uint64_t);
+  };
+
+
+  //===========================================================================
+  /// LDL^T factorisations of an ensemble of symmetric matrices with the
+  /// same sparsity pattern (e.g. the Jacobians of the same problem for
+  /// different loads), sharing a single symbolic analysis (a
+  /// SkylineStructure). The profiles of the matrices are interleaved, so
+  /// entry (i,j) of all members is stored contiguously and the innermost
+  /// loops of the factorisation and the substitutions run over the
+  /// ensemble members (and can be vectorised by the compiler). This is
+  /// not a LinearSolver: the caller assembles the matrices via entry(...)
+  /// and solves for all members at once.
+  //===========================================================================
+  class EnsembleLDLTSolver
+  {
+  public:
+    /// Constructor
+    EnsembleLDLTSolver()
+      : Structure_pt(0), Nmember(0), Zero_pivot_tolerance(1.0e-14)
+    {
+    }
+
+    /// Broken copy constructor
+    EnsembleLDLTSolver(const EnsembleLDLTSolver& dummy) = delete;
+
+    /// Broken assignment operator
+    void operator=(const EnsembleLDLTSolver&) = delete;
+
+    /// Set up zero matrices for n_member ensemble members with the
+    /// specified (shared) symbolic analysis
+    void setup(SkylineStructure* const& structure_pt, const unsigned& n_member)
+    {
+      Structure_pt = structure_pt;
+      Nmember = n_member;
+      Factors.assign(Structure_pt->nprofile() * Nmember, 0.0);
+    }
+
+    /// Number of ensemble members
+    unsigned nmember() const
+    {
+      return Nmember;
+    }
+
+    /// Entry (i,j) (i <= j, in the new ordering) of the matrix of
+    /// ensemble member k
+    double& entry(const unsigned long& i,
+                  const unsigned long& j,
+                  const unsigned& k)
+    {
+      return Factors[Structure_pt->position(i, j) * Nmember + k];
+    }
+
+    /// Pivots whose magnitude is below this tolerance (relative to the
+    /// magnitude of the corresponding diagonal entry) are treated as zero
+    /// (default 1e-14)
+    double& zero_pivot_tolerance()
+    {
+      return Zero_pivot_tolerance;
+    }
+
+    /// Factorise the matrices of all members in place (Crout, as in
+    /// SymmetricLDLTSolver::factorise_column(...), which also explains
+    /// the treatment of (near-)zero pivots)
+    void factorise()
+    {
+      const unsigned long n = Structure_pt->ndof();
+      const unsigned n_member = Nmember;
+      Vector<double> sum(n_member);
+      Vector<double> d_j(n_member);
+      Vector<double> a_jj(n_member);
+      for (unsigned long j = 0; j < n; j++)
+      {
+        const unsigned long m_j = Structure_pt->first_row(j);
+        double* col_j = column_pt(j);
+        for (unsigned long i = m_j + 1; i < j; i++)
+        {
+          const unsigned long m_i = Structure_pt->first_row(i);
+          const double* col_i = column_pt(i);
+          sum.assign(n_member, 0.0);
+          for (unsigned long r = std::max(m_i, m_j); r < i; r++)
+          {
+            for (unsigned k = 0; k < n_member; k++)
+            {
+              sum[k] += col_i[r * n_member + k] * col_j[r * n_member + k];
+            }
+          }
+          for (unsigned k = 0; k < n_member; k++)
+          {
+            col_j[i * n_member + k] -= sum[k];
+          }
+        }
+        for (unsigned k = 0; k < n_member; k++)
+        {
+          a_jj[k] = col_j[j * n_member + k];
+          d_j[k] = a_jj[k];
+        }
+        for (unsigned long i = m_j; i < j; i++)
+        {
+          const double* d_i = column_pt(i) + i * n_member;
+          double* l_ij = col_j + i * n_member;
+          for (unsigned k = 0; k < n_member; k++)
+          {
+            double g = l_ij[k];
+            l_ij[k] = g / d_i[k];
+            d_j[k] -= l_ij[k] * g;
+          }
+        }
+        for (unsigned k = 0; k < n_member; k++)
+        {
+          if (std::fabs(d_j[k]) <= Zero_pivot_tolerance * std::fabs(a_jj[k]))
+          {
+            std::ostringstream error_stream;
+            error_stream << "(Near-)zero pivot in LDL^T factorisation of "
+                         << "ensemble member " << k << " at position " << j
+                         << std::endl;
+            throw OomphLibError(error_stream.str(),
+                                OOMPH_CURRENT_FUNCTION,
+                                OOMPH_EXCEPTION_LOCATION);
+          }
+          col_j[j * n_member + k] = d_j[k];
+        }
+      }
+    }
+
+    /// Solve L D L^T x = b for all members: x[k] contains the right-hand
+    /// side for member k (in the original ordering) on entry and the
+    /// solution on exit
+    void solve(Vector<Vector<double>>& x)
+    {
+      const unsigned long n = Structure_pt->ndof();
+      const unsigned n_member = Nmember;
+      Vector<double> y(n * n_member);
+      for (unsigned k = 0; k < n_member; k++)
+      {
+        for (unsigned long i = 0; i < n; i++)
+        {
+          y[Structure_pt->perm(i) * n_member + k] = x[k][i];
+        }
+      }
+
+      // L y = b
+      for (unsigned long j = 0; j < n; j++)
+      {
+        const unsigned long m_j = Structure_pt->first_row(j);
+        const double* col_j = column_pt(j);
+        double* y_j = &y[j * n_member];
+        for (unsigned long r = m_j; r < j; r++)
+        {
+          const double* y_r = &y[r * n_member];
+          for (unsigned k = 0; k < n_member; k++)
+          {
+            y_j[k] -= col_j[r * n_member + k] * y_r[k];
+          }
+        }
+      }
+
+      // D z = y
+      for (unsigned long j = 0; j < n; j++)
+      {
+        const double* d_j = column_pt(j) + j * n_member;
+        for (unsigned k = 0; k < n_member; k++)
+        {
+          y[j * n_member + k] /= d_j[k];
+        }
+      }
+
+      // L^T x = z
+      for (unsigned long j = n; j-- > 0;)
+      {
+        const unsigned long m_j = Structure_pt->first_row(j);
+        const double* col_j = column_pt(j);
+        const double* y_j = &y[j * n_member];
+        for (unsigned long r = m_j; r < j; r++)
+        {
+          double* y_r = &y[r * n_member];
+          for (unsigned k = 0; k < n_member; k++)
+          {
+            y_r[k] -= col_j[r * n_member + k] * y_j[k];
+          }
+        }
+      }
+
+      for (unsigned k = 0; k < n_member; k++)
+      {
+        for (unsigned long i = 0; i < n; i++)
+        {
+          x[k][i] = y[Structure_pt->perm(i) * n_member + k];
+        }
+      }
+    }
+
+  private:
+    /// Column j of the interleaved profile storage, offset so that entry
+    /// (i,j) of member k is at column_pt(j)[i * nmember() + k] (for
+    /// first_row(j) <= i <= j)
+    double* column_pt(const unsigned long& j)
+    {
+      return &Factors[Structure_pt->column_start(j) * Nmember] -
+             Structure_pt->first_row(j) * Nmember;
+    }
+
+    /// Symbolic analysis (shared; not owned)
+    SkylineStructure* Structure_pt;
+
+    /// Number of ensemble members
+    unsigned Nmember;
+
+    /// Tolerance for (near-)zero pivots
+    double Zero_pivot_tolerance;
+
+    /// Interleaved matrices/factors in profile storage
+    Vector<double> Factors;
+  };
+
+} // namespace oomph
+
+#endif
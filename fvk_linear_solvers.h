@@ -0,0 +1,930 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2023 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Header file for the linear solvers used by the FvK drivers
+#ifndef OOMPH_FVK_LINEAR_SOLVERS_HEADER
+#define OOMPH_FVK_LINEAR_SOLVERS_HEADER
+
+// Generic oomph-lib routines
+#include "generic.h"
+
+// Symmetric skyline solver (in-core and out-of-core)
+#include "fvk_ldlt_solver.h"
+#include "fvk_out_of_core_ldlt_solver.h"
+
+// The problems that own the solvers
+#include "fvk_solver_problem.h"
+
+namespace oomph
+{
+
+  //===========================================================================
+  /// Right-preconditioned GMRES with Krylov subspace recycling across
+  /// sequences of linear solves (GCRO-DR style; Parks et al., SISC 2006):
+  /// A recycle space U (with C = A M^{-1} U orthonormal) is carried from
+  /// one solve to the next; each solve first removes the component of the
+  /// residual in range(C) and then runs GMRES cycles for the deflated
+  /// operator (I - C C^T) A M^{-1}, so the Krylov iteration only has to
+  /// resolve what is not already captured by the recycle space. This is
+  /// effective for the sequence of nearly identical Jacobians arising
+  /// in Newton iterations and load sweeps.
+  ///
+  /// NOTE: Rather than harmonic Ritz vectors (which would require a dense
+  /// generalised nonsymmetric eigensolver), the recycle space is formed
+  /// from the most recent corrections computed in the GMRES cycles
+  /// (as in GCROT), which requires no additional work.
+  ///
+  /// The preconditioner can be any oomph-lib Preconditioner. The
+  /// matrices must not be distributed. The number of iterations taken by
+  /// each solve is recorded and can be documented with
+  /// doc_iteration_history(...).
+  //===========================================================================
+  class GCRODR : public IterativeLinearSolver
+  {
+  public:
+    /// Constructor
+    GCRODR()
+      : Restart(30),
+        Max_recycle_dimension(10),
+        Recycling_is_enabled(true),
+        Iterations(0),
+        Matrix_pt(0),
+        Matrix_can_be_deleted(false)
+    {
+    }
+
+    /// Broken copy constructor
+    GCRODR(const GCRODR&) = delete;
+
+    /// Broken assignment operator
+    void operator=(const GCRODR&) = delete;
+
+    /// Destructor
+    virtual ~GCRODR()
+    {
+      clean_up_memory();
+    }
+
+    /// Number of Krylov vectors per GMRES cycle (default 30)
+    unsigned& restart()
+    {
+      return Restart;
+    }
+
+    /// Max. dimension of the recycle space (default 10)
+    unsigned& max_recycle_dimension()
+    {
+      return Max_recycle_dimension;
+    }
+
+    /// Carry the recycle space from one solve to the next (default)
+    void enable_recycling()
+    {
+      Recycling_is_enabled = true;
+    }
+
+    /// Start each solve from scratch (i.e. restarted GMRES)
+    void disable_recycling()
+    {
+      Recycling_is_enabled = false;
+      Recycle_space.clear();
+    }
+
+    /// Current dimension of the recycle space
+    unsigned recycle_dimension() const
+    {
+      return Recycle_space.size();
+    }
+
+    /// Number of iterations taken by the last solve
+    unsigned iterations() const
+    {
+      return Iterations;
+    }
+
+    /// Document the number of iterations and the dimension of the
+    /// recycle space for each solve
+    void doc_iteration_history(std::ostream& outfile) const
+    {
+      outfile << "# solve n_iter recycle_dimension" << std::endl;
+      const unsigned n_solve = Iteration_history.size();
+      for (unsigned i = 0; i < n_solve; i++)
+      {
+        outfile << i << " " << Iteration_history[i] << " "
+                << Recycle_dimension_history[i] << std::endl;
+      }
+    }
+
+    /// Solve the linear system J dx = r for the problem's Jacobian and
+    /// residuals
+    void solve(Problem* const& problem_pt, DoubleVector& result)
+    {
+      clean_up_matrix();
+      CRDoubleMatrix* matrix_pt =
+        new CRDoubleMatrix(problem_pt->dof_distribution_pt());
+      DoubleVector residuals(problem_pt->dof_distribution_pt(), 0.0);
+      problem_pt->get_jacobian(residuals, *matrix_pt);
+      solve(matrix_pt, residuals, result);
+
+      // Keep the matrix for resolves
+      if (Enable_resolve)
+      {
+        Matrix_pt = matrix_pt;
+        Matrix_can_be_deleted = true;
+      }
+      else
+      {
+        delete matrix_pt;
+        Matrix_pt = 0;
+      }
+    }
+
+    /// Solve the linear system A x = rhs
+    void solve(DoubleMatrixBase* const& matrix_pt,
+               const DoubleVector& rhs,
+               DoubleVector& solution)
+    {
+      if (rhs.distributed())
+      {
+        throw OomphLibError("GCRODR only works for non-distributed vectors",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      if (Matrix_pt != matrix_pt)
+      {
+        clean_up_matrix();
+        Matrix_pt = matrix_pt;
+      }
+      if (Setup_preconditioner_before_solve)
+      {
+        preconditioner_pt()->setup(matrix_pt);
+      }
+      recycled_gmres(rhs, solution);
+    }
+
+    /// Re-solve with the matrix (and preconditioner) from the last solve
+    void resolve(const DoubleVector& rhs, DoubleVector& result)
+    {
+      if (Matrix_pt == 0)
+      {
+        throw OomphLibError("No matrix for resolve; call solve(...) first",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      recycled_gmres(rhs, result);
+    }
+
+    /// Clean up the memory (the recycle space is retained)
+    void clean_up_memory()
+    {
+      clean_up_matrix();
+      if (preconditioner_pt() != 0)
+      {
+        preconditioner_pt()->clean_up_memory();
+      }
+    }
+
+  private:
+    /// Delete the matrix (if we own it)
+    void clean_up_matrix()
+    {
+      if (Matrix_can_be_deleted)
+      {
+        delete Matrix_pt;
+      }
+      Matrix_pt = 0;
+      Matrix_can_be_deleted = false;
+    }
+
+    /// y += a x
+    static void add_scaled(const double& a,
+                           const DoubleVector& x,
+                           DoubleVector& y)
+    {
+      const unsigned long n = x.nrow_local();
+      const double* x_pt = x.values_pt();
+      double* y_pt = y.values_pt();
+      for (unsigned long i = 0; i < n; i++)
+      {
+        y_pt[i] += a * x_pt[i];
+      }
+    }
+
+    /// Apply the right-preconditioned operator: w = A M^{-1} v
+    void apply_operator(const DoubleVector& v, DoubleVector& w)
+    {
+      DoubleVector z(v.distribution_pt(), 0.0);
+      preconditioner_pt()->preconditioner_solve(v, z);
+      Matrix_pt->multiply(z, w);
+    }
+
+    /// The recycled GMRES iteration for the matrix stored in Matrix_pt
+    void recycled_gmres(const DoubleVector& rhs, DoubleVector& solution)
+    {
+      const LinearAlgebraDistribution* dist_pt = rhs.distribution_pt();
+      Iterations = 0;
+
+      // Solution in the preconditioned space, x = M^{-1} y
+      DoubleVector y(dist_pt, 0.0);
+      DoubleVector r(rhs);
+      double rhs_norm = rhs.norm();
+      if (rhs_norm == 0.0)
+      {
+        solution.build(dist_pt, 0.0);
+        record_history();
+        return;
+      }
+      double target_norm = Tolerance * rhs_norm;
+
+      // Get C = A M^{-1} U for the current matrix and orthonormalise it
+      // (applying the same operations to U)
+      Vector<DoubleVector> c;
+      Vector<DoubleVector> u;
+      const unsigned n_recycle = Recycle_space.size();
+      for (unsigned l = 0; l < n_recycle; l++)
+      {
+        DoubleVector w(dist_pt, 0.0);
+        apply_operator(Recycle_space[l], w);
+        DoubleVector u_l(Recycle_space[l]);
+        double initial_norm = w.norm();
+        for (unsigned i = 0; i < c.size(); i++)
+        {
+          double h = c[i].dot(w);
+          add_scaled(-h, c[i], w);
+          add_scaled(-h, u[i], u_l);
+        }
+
+        // Skip (nearly) linearly dependent vectors
+        double norm = w.norm();
+        if (norm <= 1.0e-10 * initial_norm)
+        {
+          continue;
+        }
+        w *= 1.0 / norm;
+        u_l *= 1.0 / norm;
+        c.push_back(w);
+        u.push_back(u_l);
+      }
+      const unsigned n_c = c.size();
+
+      // Remove the component of the residual in range(C)
+      for (unsigned i = 0; i < n_c; i++)
+      {
+        double h = c[i].dot(r);
+        add_scaled(-h, c[i], r);
+        add_scaled(h, u[i], y);
+      }
+      double r_norm = r.norm();
+
+      // GMRES cycles for the deflated operator
+      Vector<DoubleVector> corrections;
+      while ((r_norm > target_norm) && (Iterations < Max_iter))
+      {
+        const unsigned m = Restart;
+        Vector<DoubleVector> v(1, r);
+        v[0] *= 1.0 / r_norm;
+        DenseMatrix<double> h(m + 1, m, 0.0);
+        DenseMatrix<double> b(std::max(n_c, 1u), m, 0.0);
+        Vector<double> g(m + 1, 0.0);
+        Vector<double> cs(m, 0.0);
+        Vector<double> sn(m, 0.0);
+        g[0] = r_norm;
+        unsigned j = 0;
+        while ((j < m) && (Iterations < Max_iter))
+        {
+          DoubleVector w(dist_pt, 0.0);
+          apply_operator(v[j], w);
+
+          // Orthogonalise against C...
+          for (unsigned i = 0; i < n_c; i++)
+          {
+            b(i, j) = c[i].dot(w);
+            add_scaled(-b(i, j), c[i], w);
+          }
+
+          // ...and the Krylov basis (modified Gram-Schmidt)
+          for (unsigned i = 0; i <= j; i++)
+          {
+            h(i, j) = v[i].dot(w);
+            add_scaled(-h(i, j), v[i], w);
+          }
+          h(j + 1, j) = w.norm();
+          double h_new = h(j + 1, j);
+          if (h_new != 0.0)
+          {
+            w *= 1.0 / h_new;
+          }
+          v.push_back(w);
+
+          // Apply the previous Givens rotations to the new column...
+          for (unsigned i = 0; i < j; i++)
+          {
+            double temp = cs[i] * h(i, j) + sn[i] * h(i + 1, j);
+            h(i + 1, j) = -sn[i] * h(i, j) + cs[i] * h(i + 1, j);
+            h(i, j) = temp;
+          }
+
+          // ...and eliminate the subdiagonal entry
+          double denominator = std::sqrt(h(j, j) * h(j, j) + h_new * h_new);
+          cs[j] = h(j, j) / denominator;
+          sn[j] = h_new / denominator;
+          h(j, j) = denominator;
+          h(j + 1, j) = 0.0;
+          g[j + 1] = -sn[j] * g[j];
+          g[j] = cs[j] * g[j];
+
+          Iterations++;
+          j++;
+          if ((std::fabs(g[j]) <= target_norm) || (h_new == 0.0))
+          {
+            break;
+          }
+        }
+
+        // Solve the upper triangular system for the coefficients
+        Vector<double> z(j, 0.0);
+        for (int i = int(j) - 1; i >= 0; i--)
+        {
+          double sum = g[i];
+          for (unsigned k = i + 1; k < j; k++)
+          {
+            sum -= h(i, k) * z[k];
+          }
+          z[i] = sum / h(i, i);
+        }
+
+        // Correction d = (V - U B) z
+        DoubleVector d(dist_pt, 0.0);
+        for (unsigned i = 0; i < j; i++)
+        {
+          add_scaled(z[i], v[i], d);
+        }
+        for (unsigned l = 0; l < n_c; l++)
+        {
+          double b_z = 0.0;
+          for (unsigned i = 0; i < j; i++)
+          {
+            b_z += b(l, i) * z[i];
+          }
+          add_scaled(-b_z, u[l], d);
+        }
+        y += d;
+        corrections.push_back(d);
+
+        // True residual (kept orthogonal to C)
+        DoubleVector a_y(dist_pt, 0.0);
+        apply_operator(y, a_y);
+        r = rhs;
+        r -= a_y;
+        for (unsigned i = 0; i < n_c; i++)
+        {
+          double h_c = c[i].dot(r);
+          add_scaled(-h_c, c[i], r);
+          add_scaled(h_c, u[i], y);
+        }
+        r_norm = r.norm();
+      }
+
+      // Update the recycle space: the most recent corrections, topped up
+      // with the previous recycle space
+      if (Recycling_is_enabled)
+      {
+        Vector<DoubleVector> new_recycle_space;
+        const unsigned n_correction = corrections.size();
+        for (int i = int(n_correction) - 1; i >= 0; i--)
+        {
+          if (new_recycle_space.size() == Max_recycle_dimension)
+          {
+            break;
+          }
+          new_recycle_space.push_back(corrections[i]);
+        }
+        for (unsigned l = 0; l < n_c; l++)
+        {
+          if (new_recycle_space.size() == Max_recycle_dimension)
+          {
+            break;
+          }
+          new_recycle_space.push_back(u[l]);
+        }
+        for (unsigned l = 0; l < new_recycle_space.size(); l++)
+        {
+          double norm = new_recycle_space[l].norm();
+          if (norm > 0.0)
+          {
+            new_recycle_space[l] *= 1.0 / norm;
+          }
+        }
+        Recycle_space = new_recycle_space;
+      }
+
+      // Undo the preconditioning
+      solution.build(dist_pt, 0.0);
+      preconditioner_pt()->preconditioner_solve(y, solution);
+      record_history();
+
+      if (r_norm > target_norm)
+      {
+        std::ostringstream error_stream;
+        error_stream << "GCRODR did not converge to the required tolerance "
+                     << "in " << Iterations << " iterations; relative "
+                     << "residual " << r_norm / rhs_norm << std::endl;
+        if (Throw_error_after_max_iter)
+        {
+          throw OomphLibError(error_stream.str(),
+                              OOMPH_CURRENT_FUNCTION,
+                              OOMPH_EXCEPTION_LOCATION);
+        }
+        oomph_info << error_stream.str();
+      }
+    }
+
+    /// Record the iteration count for the last solve
+    void record_history()
+    {
+      Iteration_history.push_back(Iterations);
+      Recycle_dimension_history.push_back(Recycle_space.size());
+    }
+
+    /// Number of Krylov vectors per GMRES cycle
+    unsigned Restart;
+
+    /// Max. dimension of the recycle space
+    unsigned Max_recycle_dimension;
+
+    /// Carry the recycle space from one solve to the next?
+    bool Recycling_is_enabled;
+
+    /// Number of iterations taken by the last solve
+    unsigned Iterations;
+
+    /// The recycle space (in the preconditioned space)
+    Vector<DoubleVector> Recycle_space;
+
+    /// Number of iterations for each solve
+    Vector<unsigned> Iteration_history;
+
+    /// Dimension of the recycle space after each solve
+    Vector<unsigned> Recycle_dimension_history;
+
+    /// Matrix from the last solve
+    DoubleMatrixBase* Matrix_pt;
+
+    /// Was the matrix created (and is it therefore owned) by the solver?
+    bool Matrix_can_be_deleted;
+  };
+
+
+  //===========================================================================
+  /// Helper functions for the scaling of the Hermite dofs
+  //===========================================================================
+  namespace HermiteDofScalingHelpers
+  {
+    /// Get the initial scaling for the dofs stored at the nodes of
+    /// the mesh: The value with index i at a node is a derivative of
+    /// order derivative_order[i] (e.g. 0 for w, 1 for w_x and w_y, 2 for
+    /// w_xx, w_xy and w_yy) and is scaled by h^derivative_order[i], where
+    /// h is the characteristic size (square root of the mean area) of the
+    /// elements adjacent to the node. This makes the Hermite dofs of an
+    /// element commensurate with one another. Dofs that aren't stored at
+    /// nodes (or whose index exceeds the size of derivative_order) are
+    /// not scaled.
+    inline void get_dof_scaling(Mesh* const& mesh_pt,
+                                const unsigned long& n_dof,
+                                const Vector<unsigned>& derivative_order,
+                                Vector<double>& dof_scaling)
+    {
+      // Characteristic element size at the nodes
+      std::map<Node*, double> total_size;
+      std::map<Node*, unsigned> n_adjacent_element;
+      const unsigned long n_element = mesh_pt->nelement();
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        FiniteElement* el_pt = mesh_pt->finite_element_pt(e);
+        double h = std::sqrt(el_pt->size());
+        const unsigned n_node = el_pt->nnode();
+        for (unsigned j = 0; j < n_node; j++)
+        {
+          total_size[el_pt->node_pt(j)] += h;
+          n_adjacent_element[el_pt->node_pt(j)]++;
+        }
+      }
+
+      // Scale the nodal dofs
+      dof_scaling.assign(n_dof, 1.0);
+      const unsigned n_order = derivative_order.size();
+      for (std::map<Node*, double>::iterator it = total_size.begin();
+           it != total_size.end();
+           it++)
+      {
+        Node* nod_pt = it->first;
+        double h = it->second / double(n_adjacent_element[nod_pt]);
+        const unsigned n_value = std::min(nod_pt->nvalue(), n_order);
+        for (unsigned i = 0; i < n_value; i++)
+        {
+          long eqn = nod_pt->eqn_number(i);
+          if (eqn >= 0)
+          {
+            dof_scaling[eqn] =
+              std::pow(h, double(derivative_order[i]));
+          }
+        }
+      }
+    }
+
+  } // namespace HermiteDofScalingHelpers
+
+
+  //===========================================================================
+  /// Wrapper for a linear solver that solves the symmetrically scaled
+  /// system \f$ (D A D) y = D b \f$ and returns \f$ x = D y \f$, so the
+  /// scaled matrix is symmetric if A is (as required by the LDL^T
+  /// solvers). The scaling is initialised from a specified scaling (e.g.
+  /// by the characteristic element size for the Hermite derivative dofs;
+  /// see HermiteDofScalingHelpers) and then refined by the symmetric
+  /// variant of Ruiz's iterative equilibration, which drives the max.
+  /// norms of all rows and columns of the scaled matrix to one. This
+  /// balances the contributions of dofs of very different magnitudes (w
+  /// and its derivatives; in-plane and out-of-plane displacements for
+  /// large Eta) and so improves the convergence of iterative solvers and
+  /// the pivot stability of direct ones. Since only the linear solve is
+  /// scaled, the Newton iteration (and its convergence checks) are
+  /// unaffected.
+  ///
+  /// NOTE: The wrapped solver is called with the scaled matrix rather
+  /// than the problem, so it cannot set the sign of the Jacobian
+  /// required by arc-length continuation. The matrix must not be
+  /// distributed.
+  //===========================================================================
+  class EquilibratedLinearSolver : public LinearSolver
+  {
+  public:
+    /// Constructor: Pass the linear solver for the scaled system
+    EquilibratedLinearSolver(LinearSolver* const& solver_pt)
+      : Solver_pt(solver_pt),
+        Max_equilibration_iteration(10),
+        Equilibration_tolerance(0.1),
+        Scaled_matrix_pt(0)
+    {
+    }
+
+    /// Broken copy constructor
+    EquilibratedLinearSolver(const EquilibratedLinearSolver&) = delete;
+
+    /// Broken assignment operator
+    void operator=(const EquilibratedLinearSolver&) = delete;
+
+    /// Destructor (the wrapped solver is not deleted)
+    virtual ~EquilibratedLinearSolver()
+    {
+      clean_up_memory();
+    }
+
+    /// The wrapped solver
+    LinearSolver*& solver_pt()
+    {
+      return Solver_pt;
+    }
+
+    /// Specify the initial scaling (one entry per dof)
+    void set_initial_scaling(const Vector<double>& scaling)
+    {
+      Initial_scaling = scaling;
+    }
+
+    /// Max. number of equilibration sweeps (default 10; 0 for the
+    /// initial scaling only)
+    unsigned& max_equilibration_iteration()
+    {
+      return Max_equilibration_iteration;
+    }
+
+    /// Tolerance for the deviation of the row and column norms from
+    /// one (default 0.1)
+    double& equilibration_tolerance()
+    {
+      return Equilibration_tolerance;
+    }
+
+    /// Scaling from the last solve
+    const Vector<double>& scaling() const
+    {
+      return Scaling;
+    }
+
+    /// Solve the linear system J dx = r for the problem's Jacobian and
+    /// residuals
+    void solve(Problem* const& problem_pt, DoubleVector& result)
+    {
+      CRDoubleMatrix matrix(problem_pt->dof_distribution_pt());
+      DoubleVector residuals(problem_pt->dof_distribution_pt(), 0.0);
+      problem_pt->get_jacobian(residuals, matrix);
+      solve(&matrix, residuals, result);
+    }
+
+    /// Solve the linear system A x = rhs
+    void solve(DoubleMatrixBase* const& matrix_pt,
+               const DoubleVector& rhs,
+               DoubleVector& solution)
+    {
+      CRDoubleMatrix* cr_matrix_pt = dynamic_cast<CRDoubleMatrix*>(matrix_pt);
+      if ((cr_matrix_pt == 0) || cr_matrix_pt->distributed())
+      {
+        throw OomphLibError(
+          "EquilibratedLinearSolver requires a non-distributed CRDoubleMatrix",
+          OOMPH_CURRENT_FUNCTION,
+          OOMPH_EXCEPTION_LOCATION);
+      }
+
+      // Scale a copy of the matrix
+      clean_up_memory();
+      Scaled_matrix_pt = new CRDoubleMatrix(*cr_matrix_pt);
+      equilibrate(Scaled_matrix_pt);
+
+      // Solve
+      if (Enable_resolve)
+      {
+        Solver_pt->enable_resolve();
+      }
+      DoubleVector scaled_rhs(rhs);
+      scale(Scaling, scaled_rhs);
+      Solver_pt->solve(Scaled_matrix_pt, scaled_rhs, solution);
+      scale(Scaling, solution);
+
+      // The wrapped solver may need the matrix for resolves
+      if (!Enable_resolve)
+      {
+        delete Scaled_matrix_pt;
+        Scaled_matrix_pt = 0;
+      }
+    }
+
+    /// Re-solve with the (scaled) matrix from the last solve
+    void resolve(const DoubleVector& rhs, DoubleVector& result)
+    {
+      DoubleVector scaled_rhs(rhs);
+      scale(Scaling, scaled_rhs);
+      Solver_pt->resolve(scaled_rhs, result);
+      scale(Scaling, result);
+    }
+
+    /// Disable resolves (for the wrapped solver, too)
+    void disable_resolve()
+    {
+      LinearSolver::disable_resolve();
+      Solver_pt->disable_resolve();
+    }
+
+    /// Clean up the memory
+    void clean_up_memory()
+    {
+      delete Scaled_matrix_pt;
+      Scaled_matrix_pt = 0;
+      Solver_pt->clean_up_memory();
+    }
+
+  private:
+    /// Multiply the entries of the vector by the scaling factors
+    static void scale(const Vector<double>& scaling, DoubleVector& vector)
+    {
+      const unsigned long n = vector.nrow_local();
+      double* values_pt = vector.values_pt();
+      for (unsigned long i = 0; i < n; i++)
+      {
+        values_pt[i] *= scaling[i];
+      }
+    }
+
+    /// Scale the matrix in place and store the scaling: Apply the
+    /// initial scaling, then the symmetric Ruiz equilibration (repeated
+    /// scaling of each row and the corresponding column by the inverse
+    /// square root of the larger of their max. norms).
+    void equilibrate(CRDoubleMatrix* const& matrix_pt)
+    {
+      const unsigned long n_row = matrix_pt->nrow();
+      double* value_pt = matrix_pt->value();
+      const int* column_index_pt = matrix_pt->column_index();
+      const int* row_start_pt = matrix_pt->row_start();
+      if (matrix_pt->ncol() != n_row)
+      {
+        throw OomphLibError(
+          "EquilibratedLinearSolver requires a square matrix",
+          OOMPH_CURRENT_FUNCTION,
+          OOMPH_EXCEPTION_LOCATION);
+      }
+
+      Scaling.assign(n_row, 1.0);
+      if (Initial_scaling.size() == n_row)
+      {
+        Scaling = Initial_scaling;
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+          {
+            value_pt[k] *= Scaling[i] * Scaling[column_index_pt[k]];
+          }
+        }
+      }
+
+      Vector<double> norm(n_row);
+      for (unsigned iter = 0; iter < Max_equilibration_iteration; iter++)
+      {
+        // Larger of the max. norms of each row and the corresponding
+        // column (the same for a symmetric matrix)
+        norm.assign(n_row, 0.0);
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+          {
+            double abs_value = std::fabs(value_pt[k]);
+            norm[i] = std::max(norm[i], abs_value);
+            norm[column_index_pt[k]] =
+              std::max(norm[column_index_pt[k]], abs_value);
+          }
+        }
+
+        // Converged?
+        double max_deviation = 0.0;
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          if (norm[i] > 0.0)
+          {
+            max_deviation = std::max(max_deviation, std::fabs(1.0 - norm[i]));
+          }
+        }
+        if (max_deviation < Equilibration_tolerance)
+        {
+          break;
+        }
+
+        // Scale
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          norm[i] = (norm[i] > 0.0) ? 1.0 / std::sqrt(norm[i]) : 1.0;
+          Scaling[i] *= norm[i];
+        }
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+          {
+            value_pt[k] *= norm[i] * norm[column_index_pt[k]];
+          }
+        }
+      }
+    }
+
+    /// The wrapped solver
+    LinearSolver* Solver_pt;
+
+    /// Max. number of equilibration sweeps
+    unsigned Max_equilibration_iteration;
+
+    /// Tolerance for the equilibration
+    double Equilibration_tolerance;
+
+    /// Initial scaling
+    Vector<double> Initial_scaling;
+
+    /// Scaling
+    Vector<double> Scaling;
+
+    /// The scaled matrix
+    CRDoubleMatrix* Scaled_matrix_pt;
+  };
+
+
+  //===========================================================================
+  /// Run-time selection of the direct linear solver used by the drivers
+  //===========================================================================
+  namespace FvKDirectSolvers
+  {
+    /// Memory budget (in MB) for the out-of-core solver
+    inline double& out_of_core_memory_budget_mb()
+    {
+      static double budget = 1024.0;
+      return budget;
+    }
+
+    /// Directory for the out-of-core solver's scratch file
+    inline std::string& out_of_core_scratch_directory()
+    {
+      static std::string directory = ".";
+      return directory;
+    }
+
+    /// Specify the command line flags for the options of the direct
+    /// solvers (to be called before CommandLineArgs::parse_and_assign())
+    inline void specify_command_line_flags()
+    {
+      CommandLineArgs::specify_command_line_flag(
+        "--out_of_core_memory_budget_mb", &out_of_core_memory_budget_mb());
+      CommandLineArgs::specify_command_line_flag(
+        "--out_of_core_scratch_dir", &out_of_core_scratch_directory());
+    }
+
+    /// Names of the available direct solvers (for the documentation of
+    /// command line flags): "default" (the problem's default solver),
+    /// "superlu" (supernodal LU), "frontal" (HSL MA42 frontal LU; requires
+    /// the HSL sources), "ldlt" (symmetric skyline LDL^T),
+    /// "out_of_core_ldlt" (the same, with the factors stored on disk) and
+    /// "mumps" (MUMPS multifrontal LU, if available; only for drivers
+    /// that initialise MPI)
+    inline std::string available_solvers()
+    {
+      std::string names = "default superlu frontal ldlt out_of_core_ldlt";
+#ifdef OOMPH_HAS_MUMPS
+      names += " mumps";
+#endif
+      return names;
+    }
+
+    /// Create the direct solver with the specified name (null for
+    /// "default")
+    inline LinearSolver* create_solver(const std::string& name)
+    {
+      if (name == "default")
+      {
+        return 0;
+      }
+      else if (name == "superlu")
+      {
+        return new SuperLUSolver;
+      }
+      else if (name == "frontal")
+      {
+        return new HSL_MA42;
+      }
+      else if (name == "ldlt")
+      {
+        return new SymmetricLDLTSolver;
+      }
+      else if (name == "out_of_core_ldlt")
+      {
+        OutOfCoreLDLTSolver* solver_pt = new OutOfCoreLDLTSolver;
+        solver_pt->memory_budget_mb() = out_of_core_memory_budget_mb();
+        solver_pt->scratch_directory() = out_of_core_scratch_directory();
+        return solver_pt;
+      }
+#ifdef OOMPH_HAS_MUMPS
+      else if (name == "mumps")
+      {
+        // MUMPS runs on MPI, which only some of the drivers initialise
+        if (!MPI_Helpers::mpi_has_been_initialised())
+        {
+          throw OomphLibError(
+            "MUMPS requires MPI, but this driver doesn't initialise it",
+            OOMPH_CURRENT_FUNCTION,
+            OOMPH_EXCEPTION_LOCATION);
+        }
+        return new MumpsSolver;
+      }
+#endif
+      throw OomphLibError("Unknown (or unavailable) direct solver " + name +
+                            "; available: " + available_solvers(),
+                          OOMPH_CURRENT_FUNCTION,
+                          OOMPH_EXCEPTION_LOCATION);
+    }
+
+    /// Use the direct solver with the specified name for the problem
+    /// (no change for "default"), which takes ownership of it. NOTE: Only
+    /// SuperLU and the LDL^T solver determine the sign of the Jacobian,
+    /// required to detect folds/bifurcations during arc-length
+    /// continuation.
+    inline void set_solver(FvKSolverProblem* const& problem_pt,
+                           const std::string& name)
+    {
+      LinearSolver* solver_pt = create_solver(name);
+      if (solver_pt != 0)
+      {
+        problem_pt->adopt_linear_solver(solver_pt);
+        problem_pt->linear_solver_pt() = solver_pt;
+      }
+    }
+
+  } // namespace FvKDirectSolvers
+
+} // namespace oomph
+
+#endif
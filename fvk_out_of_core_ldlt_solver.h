@@ -0,0 +1,677 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2023 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Header file for an out-of-core version of the skyline LDL^T solver
+#ifndef OOMPH_FVK_OUT_OF_CORE_LDLT_SOLVER_HEADER
+#define OOMPH_FVK_OUT_OF_CORE_LDLT_SOLVER_HEADER
+
+// In-core version
+#include "fvk_ldlt_solver.h"
+
+#include <climits>
+
+namespace oomph
+{
+
+  //===========================================================================
+  /// Out-of-core version of the SymmetricLDLTSolver for problems whose
+  /// factors don't fit into memory: The columns of the profile are split
+  /// into panels (contiguous ranges of columns) that are assembled and
+  /// factorised one at a time and then written to a scratch file. The
+  /// factorisation of a column only requires the columns in its profile,
+  /// which (after the reverse Cuthill-McKee ordering) live in the
+  /// current panel and the panels just before it; panels are read back
+  /// on demand (the ones a panel's profile reaches back into are
+  /// prefetched while it is assembled) and the least recently used ones
+  /// are dropped to stay within the memory budget. The back-substitutions stream through the
+  /// panels (forwards, then backwards), asking the operating system to
+  /// prefetch the next panel while the current one is processed.
+  ///
+  /// The panels are sized so that four of them fit into the memory
+  /// budget; if the profile of a panel reaches further back than that,
+  /// panels are re-read during the factorisation (correct, but slow).
+  /// Elements that contribute to several panels are assembled for each
+  /// of them.
+  ///
+  /// Linear systems with a given matrix (e.g. from the preconditioners or
+  /// the equilibrating wrapper) are solved in core with the
+  /// SymmetricLDLTSolver's profile storage; such matrices are assumed to
+  /// be small enough for that.
+  //===========================================================================
+  class OutOfCoreLDLTSolver : public SymmetricLDLTSolver
+  {
+  public:
+    /// Constructor
+    OutOfCoreLDLTSolver()
+      : Memory_budget_mb(1024.0),
+        Scratch_directory("."),
+        Scratch_file_descriptor(-1),
+        Panel_structure_pt(0),
+        Panel_structure_nprofile(0),
+        Locked_panel(UINT_MAX),
+        Nresident_double(0),
+        Use_counter(0),
+        Npanel_read(0),
+        Npanel_write(0),
+        Factors_are_in_core(false)
+    {
+    }
+
+    /// Broken copy constructor
+    OutOfCoreLDLTSolver(const OutOfCoreLDLTSolver&) = delete;
+
+    /// Broken assignment operator
+    void operator=(const OutOfCoreLDLTSolver&) = delete;
+
+    /// Destructor
+    virtual ~OutOfCoreLDLTSolver()
+    {
+      clean_up_memory();
+    }
+
+    /// Memory budget for the panels (in MB; default 1024)
+    double& memory_budget_mb()
+    {
+      return Memory_budget_mb;
+    }
+
+    /// Directory for the scratch file (default: the current directory)
+    std::string& scratch_directory()
+    {
+      return Scratch_directory;
+    }
+
+    /// Number of panels
+    unsigned npanel() const
+    {
+      return Panel_data.size();
+    }
+
+    /// Number of panels read from the scratch file since the last reset
+    unsigned long npanel_read() const
+    {
+      return Npanel_read;
+    }
+
+    /// Number of panels written to the scratch file since the last reset
+    unsigned long npanel_write() const
+    {
+      return Npanel_write;
+    }
+
+    /// Reset the counters for the panel reads/writes
+    void reset_panel_io_counters()
+    {
+      Npanel_read = 0;
+      Npanel_write = 0;
+    }
+
+    /// Solve the linear system J dx = r for the problem's Jacobian and
+    /// residuals: Assemble and factorise panel by panel, then solve
+    void solve(Problem* const& problem_pt, DoubleVector& result)
+    {
+      double t_start = TimingHelpers::timer();
+      const unsigned long n_dof = problem_pt->ndof();
+      if ((Structure_pt == 0) || (Structure_pt->ndof() != n_dof))
+      {
+        build_structure(problem_pt);
+      }
+      if ((Panel_structure_pt != Structure_pt) ||
+          (Panel_structure_nprofile != Structure_pt->nprofile()))
+      {
+        setup_panels(problem_pt);
+      }
+
+      DoubleVector residuals;
+      Factors_are_in_core = false;
+      assemble_and_factorise(problem_pt, residuals);
+      problem_pt->sign_of_jacobian() = sign_of_determinant();
+
+      back_substitute(residuals, result);
+      if (!Enable_resolve)
+      {
+        clean_up_memory();
+      }
+      if (Doc_time)
+      {
+        oomph_info << "Time for out-of-core LDL^T solve [sec]: "
+                   << TimingHelpers::timer() - t_start << std::endl;
+      }
+    }
+
+    /// Solve the linear system A x = rhs in core (see
+    /// SymmetricLDLTSolver::solve(...)); the panels are set up again for
+    /// the next solve for a problem if the symbolic analysis changes.
+    void solve(DoubleMatrixBase* const& matrix_pt,
+               const DoubleVector& rhs,
+               DoubleVector& result)
+    {
+      clean_up_memory();
+      if ((Structure_pt == 0) || (Structure_pt->ndof() != matrix_pt->nrow()))
+      {
+        Panel_structure_pt = 0;
+      }
+      Factors_are_in_core = true;
+      SymmetricLDLTSolver::solve(matrix_pt, rhs, result);
+    }
+
+    /// Delete the panels and the scratch file (the symbolic analysis is
+    /// retained)
+    void clean_up_memory()
+    {
+      const unsigned n_panel = Panel_data.size();
+      for (unsigned p = 0; p < n_panel; p++)
+      {
+        release_panel(p);
+        Panel_is_on_disk[p] = false;
+      }
+      if (Scratch_file_descriptor >= 0)
+      {
+        close(Scratch_file_descriptor);
+        Scratch_file_descriptor = -1;
+      }
+      SymmetricLDLTSolver::clean_up_memory();
+    }
+
+  protected:
+    /// Column j (see SymmetricLDLTSolver::column_pt(...)); its panel is
+    /// read back from the scratch file if necessary
+    double* column_pt(const unsigned long& j)
+    {
+      if (Factors_are_in_core)
+      {
+        return SymmetricLDLTSolver::column_pt(j);
+      }
+      const unsigned p = Panel_of_column[j];
+      make_resident(p);
+      Panel_last_use[p] = ++Use_counter;
+      return &Panel_data[p][Structure_pt->column_start(j) -
+                            panel_offset(p)] -
+             Structure_pt->first_row(j);
+    }
+
+    /// Solve L D L^T x = b (in the new ordering) in place, streaming
+    /// through the panels
+    void solve_with_factors(Vector<double>& x)
+    {
+      if (Factors_are_in_core)
+      {
+        SymmetricLDLTSolver::solve_with_factors(x);
+        return;
+      }
+      const unsigned n_panel = Panel_data.size();
+
+      // L y = b and D z = y (keep y for the remaining columns)
+      Vector<double> z(x.size());
+      for (unsigned p = 0; p < n_panel; p++)
+      {
+        Locked_panel = p;
+        if (p + 1 < n_panel)
+        {
+          prefetch_panel(p + 1);
+        }
+        for (unsigned long j = Panel_first_column[p];
+             j < Panel_first_column[p + 1];
+             j++)
+        {
+          const unsigned long m_j = Structure_pt->first_row(j);
+          const double* col_j = column_pt(j);
+          double sum = 0.0;
+          for (unsigned long r = m_j; r < j; r++)
+          {
+            sum += col_j[r] * x[r];
+          }
+          x[j] -= sum;
+          z[j] = x[j] / col_j[j];
+        }
+      }
+      x = z;
+
+      // L^T x = z
+      for (unsigned p = n_panel; p-- > 0;)
+      {
+        Locked_panel = p;
+        if (p > 0)
+        {
+          prefetch_panel(p - 1);
+        }
+        for (unsigned long j = Panel_first_column[p + 1];
+             j-- > Panel_first_column[p];)
+        {
+          const unsigned long m_j = Structure_pt->first_row(j);
+          const double* col_j = column_pt(j);
+          for (unsigned long r = m_j; r < j; r++)
+          {
+            x[r] -= col_j[r] * x[j];
+          }
+        }
+      }
+      Locked_panel = UINT_MAX;
+    }
+
+  private:
+    /// Split the columns into panels that fit into a quarter of the
+    /// memory budget and find the elements that contribute to each panel
+    void setup_panels(Problem* const& problem_pt)
+    {
+      clean_up_memory();
+      const unsigned long n_dof = Structure_pt->ndof();
+      const unsigned long panel_capacity =
+        std::max(1.0, Memory_budget_mb * 1024.0 * 1024.0 /
+                        (4.0 * sizeof(double)));
+      Panel_first_column.assign(1, 0);
+      Panel_of_column.resize(n_dof);
+      unsigned long panel_size = 0;
+      for (unsigned long j = 0; j < n_dof; j++)
+      {
+        const unsigned long column_size =
+          Structure_pt->column_start(j + 1) - Structure_pt->column_start(j);
+        if ((panel_size > 0) && (panel_size + column_size > panel_capacity))
+        {
+          Panel_first_column.push_back(j);
+          panel_size = 0;
+        }
+        panel_size += column_size;
+        Panel_of_column[j] = Panel_first_column.size() - 1;
+      }
+      Panel_first_column.push_back(n_dof);
+      const unsigned n_panel = Panel_first_column.size() - 1;
+      Panel_data.clear();
+      Panel_data.resize(n_panel);
+      Panel_is_on_disk.assign(n_panel, false);
+      Panel_last_use.assign(n_panel, 0);
+
+      // Elements that contribute to each panel
+      Mesh* mesh_pt = problem_pt->mesh_pt();
+      AssemblyHandler* handler_pt = problem_pt->assembly_handler_pt();
+      const unsigned long n_element = mesh_pt->nelement();
+      Panel_element.clear();
+      Panel_element.resize(n_panel);
+      Vector<unsigned> el_panel;
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        el_panel.clear();
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          el_panel.push_back(Panel_of_column[Structure_pt->perm(
+            handler_pt->eqn_number(el_pt, i))]);
+        }
+        std::sort(el_panel.begin(), el_panel.end());
+        el_panel.erase(std::unique(el_panel.begin(), el_panel.end()),
+                       el_panel.end());
+        const unsigned n_el_panel = el_panel.size();
+        for (unsigned k = 0; k < n_el_panel; k++)
+        {
+          Panel_element[el_panel[k]].push_back(e);
+        }
+      }
+
+      // First panel in the profile of each panel; does it fit into memory?
+      unsigned max_window = 0;
+      Panel_profile_first_panel.resize(n_panel);
+      for (unsigned p = 0; p < n_panel; p++)
+      {
+        unsigned long first_row = Panel_first_column[p];
+        for (unsigned long j = Panel_first_column[p];
+             j < Panel_first_column[p + 1];
+             j++)
+        {
+          first_row = std::min(first_row, Structure_pt->first_row(j));
+        }
+        Panel_profile_first_panel[p] = Panel_of_column[first_row];
+        max_window = std::max(max_window, p - Panel_of_column[first_row] + 1);
+      }
+      if (max_window > 4)
+      {
+        oomph_info << "Out-of-core LDL^T: the profile spans up to "
+                   << max_window << " panels but only 4 fit into the "
+                   << "memory budget; panels will be re-read" << std::endl;
+      }
+      if (Doc_stats)
+      {
+        oomph_info << "Out-of-core LDL^T: " << n_panel << " panels; "
+                   << "max. panels in profile: " << max_window << std::endl;
+      }
+      Panel_structure_pt = Structure_pt;
+      Panel_structure_nprofile = Structure_pt->nprofile();
+    }
+
+    /// Assemble the residuals and assemble/factorise the Jacobian panel
+    /// by panel, writing the factorised panels to the scratch file
+    void assemble_and_factorise(Problem* const& problem_pt,
+                                DoubleVector& residuals)
+    {
+      clean_up_memory();
+      open_scratch_file();
+      residuals.build(problem_pt->dof_distribution_pt(), 0.0);
+      Npositive_pivot = 0;
+      Nnegative_pivot = 0;
+      Nzero_pivot = 0;
+
+      Mesh* mesh_pt = problem_pt->mesh_pt();
+      AssemblyHandler* handler_pt = problem_pt->assembly_handler_pt();
+      std::vector<bool> residuals_done(mesh_pt->nelement(), false);
+      Vector<double> el_residuals;
+      DenseMatrix<double> el_jacobian;
+      const unsigned n_panel = Panel_data.size();
+      for (unsigned p = 0; p < n_panel; p++)
+      {
+        // Start reading the earlier panels that its columns' profiles
+        // reach back into (if they've been dropped), so the reads overlap
+        // with the assembly
+        for (unsigned q = Panel_profile_first_panel[p]; q < p; q++)
+        {
+          prefetch_panel(q);
+        }
+
+        // Assemble the upper triangle in this panel's columns
+        Locked_panel = p;
+        allocate_panel(p);
+        const unsigned long first_column = Panel_first_column[p];
+        const unsigned long end_column = Panel_first_column[p + 1];
+        const unsigned long offset = panel_offset(p);
+        const unsigned long n_panel_element = Panel_element[p].size();
+        for (unsigned long k = 0; k < n_panel_element; k++)
+        {
+          const unsigned long e = Panel_element[p][k];
+          GeneralisedElement* el_pt = mesh_pt->element_pt(e);
+          const unsigned n_el_dof = handler_pt->ndof(el_pt);
+          el_residuals.resize(n_el_dof);
+          el_jacobian.resize(n_el_dof, n_el_dof);
+          handler_pt->get_jacobian(el_pt, el_residuals, el_jacobian);
+          if (!residuals_done[e])
+          {
+            if (Check_symmetry && (Nassembly == 0))
+            {
+              check_symmetry(e, el_jacobian);
+            }
+            for (unsigned i = 0; i < n_el_dof; i++)
+            {
+              residuals[handler_pt->eqn_number(el_pt, i)] += el_residuals[i];
+            }
+            residuals_done[e] = true;
+          }
+          for (unsigned j = 0; j < n_el_dof; j++)
+          {
+            unsigned long j_new =
+              Structure_pt->perm(handler_pt->eqn_number(el_pt, j));
+            if ((j_new < first_column) || (j_new >= end_column))
+            {
+              continue;
+            }
+            for (unsigned i = 0; i < n_el_dof; i++)
+            {
+              unsigned long i_new =
+                Structure_pt->perm(handler_pt->eqn_number(el_pt, i));
+              if (i_new <= j_new)
+              {
+                Panel_data[p][Structure_pt->position(i_new, j_new) -
+                              offset] += el_jacobian(i, j);
+              }
+            }
+          }
+        }
+
+        // Factorise its columns
+        for (unsigned long j = first_column; j < end_column; j++)
+        {
+          double a_jj = column_pt(j)[j];
+          factorise_column(j);
+          update_inertia(column_pt(j)[j], a_jj);
+        }
+        write_panel(p);
+      }
+      Locked_panel = UINT_MAX;
+      Nassembly++;
+      Is_factorised = true;
+      if (Doc_stats)
+      {
+        oomph_info << "Out-of-core LDL^T inertia: " << Npositive_pivot
+                   << " positive, " << Nnegative_pivot << " negative, "
+                   << Nzero_pivot << " zero pivots; " << Npanel_read
+                   << " panel reads, " << Npanel_write << " panel writes"
+                   << std::endl;
+      }
+    }
+
+    /// Offset of panel p in the profile storage
+    unsigned long panel_offset(const unsigned& p) const
+    {
+      return Structure_pt->column_start(Panel_first_column[p]);
+    }
+
+    /// Number of entries in panel p
+    unsigned long panel_size(const unsigned& p) const
+    {
+      return Structure_pt->column_start(Panel_first_column[p + 1]) -
+             panel_offset(p);
+    }
+
+    /// Create the scratch file (it's unlinked straight away so it
+    /// disappears when it's closed, even if the run is aborted)
+    void open_scratch_file()
+    {
+      std::string file_name = Scratch_directory + "/fvk_ldlt_panels_XXXXXX";
+      std::vector<char> file_name_template(file_name.begin(),
+                                           file_name.end());
+      file_name_template.push_back('\0');
+      Scratch_file_descriptor = mkstemp(&file_name_template[0]);
+      if (Scratch_file_descriptor < 0)
+      {
+        throw OomphLibError("Can't create a scratch file in " +
+                              Scratch_directory,
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      unlink(&file_name_template[0]);
+    }
+
+    /// Allocate (zeroed) memory for panel p, dropping other panels if
+    /// necessary
+    void allocate_panel(const unsigned& p)
+    {
+      const unsigned long n_entry = panel_size(p);
+      make_room(n_entry);
+      Panel_data[p].assign(n_entry, 0.0);
+      Nresident_double += n_entry;
+      Panel_last_use[p] = ++Use_counter;
+    }
+
+    /// Make sure panel p is in memory (reading it back from the scratch
+    /// file if necessary)
+    void make_resident(const unsigned& p)
+    {
+      if (!Panel_data[p].empty())
+      {
+        return;
+      }
+      if (!Panel_is_on_disk[p])
+      {
+        throw OomphLibError("Panel has neither been computed nor stored",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      const unsigned long n_entry = panel_size(p);
+      make_room(n_entry);
+      Panel_data[p].resize(n_entry);
+      Nresident_double += n_entry;
+      char* buffer_pt = reinterpret_cast<char*>(&Panel_data[p][0]);
+      size_t n_byte = n_entry * sizeof(double);
+      off_t position = panel_offset(p) * sizeof(double);
+      while (n_byte > 0)
+      {
+        ssize_t n_read =
+          pread(Scratch_file_descriptor, buffer_pt, n_byte, position);
+        if (n_read <= 0)
+        {
+          throw OomphLibError("Failed to read a panel from the scratch file",
+                              OOMPH_CURRENT_FUNCTION,
+                              OOMPH_EXCEPTION_LOCATION);
+        }
+        buffer_pt += n_read;
+        n_byte -= n_read;
+        position += n_read;
+      }
+      Npanel_read++;
+    }
+
+    /// Write panel p to the scratch file (it stays in memory until it's
+    /// dropped)
+    void write_panel(const unsigned& p)
+    {
+      const char* buffer_pt =
+        reinterpret_cast<const char*>(&Panel_data[p][0]);
+      size_t n_byte = Panel_data[p].size() * sizeof(double);
+      off_t position = panel_offset(p) * sizeof(double);
+      while (n_byte > 0)
+      {
+        ssize_t n_written =
+          pwrite(Scratch_file_descriptor, buffer_pt, n_byte, position);
+        if (n_written <= 0)
+        {
+          throw OomphLibError("Failed to write a panel to the scratch file",
+                              OOMPH_CURRENT_FUNCTION,
+                              OOMPH_EXCEPTION_LOCATION);
+        }
+        buffer_pt += n_written;
+        n_byte -= n_written;
+        position += n_written;
+      }
+      Panel_is_on_disk[p] = true;
+      Npanel_write++;
+    }
+
+    /// Ask the operating system to read panel p (asynchronously) if it's
+    /// not in memory
+    void prefetch_panel(const unsigned& p)
+    {
+#ifdef POSIX_FADV_WILLNEED
+      if (Panel_data[p].empty() && Panel_is_on_disk[p])
+      {
+        posix_fadvise(Scratch_file_descriptor,
+                      panel_offset(p) * sizeof(double),
+                      panel_size(p) * sizeof(double),
+                      POSIX_FADV_WILLNEED);
+      }
+#endif
+    }
+
+    /// Drop the least recently used panels (other than the locked one,
+    /// and only if they're stored on disk) until another n_entry entries
+    /// fit into the memory budget
+    void make_room(const unsigned long& n_entry)
+    {
+      const double budget =
+        Memory_budget_mb * 1024.0 * 1024.0 / double(sizeof(double));
+      const unsigned n_panel = Panel_data.size();
+      while (double(Nresident_double + n_entry) > budget)
+      {
+        unsigned lru_panel = UINT_MAX;
+        for (unsigned p = 0; p < n_panel; p++)
+        {
+          if ((p != Locked_panel) && (!Panel_data[p].empty()) &&
+              Panel_is_on_disk[p] &&
+              ((lru_panel == UINT_MAX) ||
+               (Panel_last_use[p] < Panel_last_use[lru_panel])))
+          {
+            lru_panel = p;
+          }
+        }
+        if (lru_panel == UINT_MAX)
+        {
+          return;
+        }
+        release_panel(lru_panel);
+      }
+    }
+
+    /// Free the memory for panel p
+    void release_panel(const unsigned& p)
+    {
+      Nresident_double -= Panel_data[p].size();
+      Panel_data[p].clear();
+      Panel_data[p].shrink_to_fit();
+    }
+
+    /// Memory budget for the panels (in MB)
+    double Memory_budget_mb;
+
+    /// Directory for the scratch file
+    std::string Scratch_directory;
+
+    /// File descriptor of the scratch file (-1 if not open)
+    int Scratch_file_descriptor;
+
+    /// Symbolic analysis the panels were set up for
+    SkylineStructure* Panel_structure_pt;
+
+    /// Size of the profile the panels were set up for
+    unsigned long Panel_structure_nprofile;
+
+    /// First column of each panel (and the number of columns at the end)
+    Vector<unsigned long> Panel_first_column;
+
+    /// Panel that contains each column
+    Vector<unsigned> Panel_of_column;
+
+    /// Elements that contribute to each panel
+    Vector<Vector<unsigned long>> Panel_element;
+
+    /// First panel that the profile of each panel reaches back into
+    Vector<unsigned> Panel_profile_first_panel;
+
+    /// Entries of the panels in memory (empty if not)
+    Vector<Vector<double>> Panel_data;
+
+    /// Has the (factorised) panel been written to the scratch file?
+    std::vector<bool> Panel_is_on_disk;
+
+    /// When was each panel last used?
+    Vector<unsigned long> Panel_last_use;
+
+    /// Panel that's currently being processed (can't be dropped)
+    unsigned Locked_panel;
+
+    /// Number of entries in the panels in memory
+    unsigned long Nresident_double;
+
+    /// Counter for the least-recently-used bookkeeping
+    unsigned long Use_counter;
+
+    /// Number of panels read from the scratch file
+    unsigned long Npanel_read;
+
+    /// Number of panels written to the scratch file
+    unsigned long Npanel_write;
+
+    /// Are the current factors those of a given matrix, held in core?
+    bool Factors_are_in_core;
+  };
+
+} // namespace oomph
+
+#endif
@@ -0,0 +1,1128 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2023 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Header file for the preconditioners used by the FvK drivers
+#ifndef OOMPH_FVK_PRECONDITIONERS_HEADER
+#define OOMPH_FVK_PRECONDITIONERS_HEADER
+
+// Generic oomph-lib routines
+#include "generic.h"
+
+namespace oomph
+{
+
+  //===========================================================================
+  /// Helper functions for the partitioning of the dofs into subdomains
+  //===========================================================================
+  namespace SubdomainPartitioningHelpers
+  {
+    /// Recursive coordinate bisection of the elements (with the specified
+    /// indices) based on their centroids: Split the set across the
+    /// coordinate direction of largest extent into two halves whose sizes
+    /// are proportional to the number of subdomains each of them receives.
+    inline void bisect_elements(const Vector<Vector<double>>& centroid,
+                                Vector<unsigned>& element_index,
+                                const unsigned& first_subdomain,
+                                const unsigned& n_subdomain,
+                                Vector<unsigned>& element_subdomain)
+    {
+      const unsigned n_element = element_index.size();
+      if ((n_subdomain == 1) || (n_element == 0))
+      {
+        for (unsigned e = 0; e < n_element; e++)
+        {
+          element_subdomain[element_index[e]] = first_subdomain;
+        }
+        return;
+      }
+
+      // Direction of largest extent
+      const unsigned n_dim = centroid[element_index[0]].size();
+      unsigned split_direction = 0;
+      double max_extent = -1.0;
+      for (unsigned i = 0; i < n_dim; i++)
+      {
+        double x_min = DBL_MAX;
+        double x_max = -DBL_MAX;
+        for (unsigned e = 0; e < n_element; e++)
+        {
+          x_min = std::min(x_min, centroid[element_index[e]][i]);
+          x_max = std::max(x_max, centroid[element_index[e]][i]);
+        }
+        if (x_max - x_min > max_extent)
+        {
+          max_extent = x_max - x_min;
+          split_direction = i;
+        }
+      }
+
+      // Split
+      unsigned n_subdomain_left = n_subdomain / 2;
+      unsigned n_element_left = (n_element * n_subdomain_left) / n_subdomain;
+      std::nth_element(element_index.begin(),
+                       element_index.begin() + n_element_left,
+                       element_index.end(),
+                       [&](const unsigned& e1, const unsigned& e2) {
+                         return centroid[e1][split_direction] <
+                                centroid[e2][split_direction];
+                       });
+      Vector<unsigned> left(element_index.begin(),
+                            element_index.begin() + n_element_left);
+      Vector<unsigned> right(element_index.begin() + n_element_left,
+                             element_index.end());
+      bisect_elements(
+        centroid, left, first_subdomain, n_subdomain_left, element_subdomain);
+      bisect_elements(centroid,
+                      right,
+                      first_subdomain + n_subdomain_left,
+                      n_subdomain - n_subdomain_left,
+                      element_subdomain);
+    }
+
+    /// Partition the elements in the mesh into n_subdomain (geometrically
+    /// compact) subdomains by recursive coordinate bisection and assign
+    /// each dof to the subdomain of the first element that it's associated
+    /// with. The dofs must have been numbered.
+    inline void partition_dofs_by_mesh(Mesh* const& mesh_pt,
+                                       const unsigned long& n_dof,
+                                       const unsigned& n_subdomain,
+                                       Vector<unsigned>& dof_subdomain)
+    {
+      // Get the element centroids
+      const unsigned long n_element = mesh_pt->nelement();
+      Vector<Vector<double>> centroid(n_element);
+      Vector<unsigned> element_index(n_element);
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        FiniteElement* el_pt = mesh_pt->finite_element_pt(e);
+        const unsigned n_node = el_pt->nnode();
+        const unsigned n_dim = el_pt->node_pt(0)->ndim();
+        centroid[e].resize(n_dim, 0.0);
+        for (unsigned j = 0; j < n_node; j++)
+        {
+          for (unsigned i = 0; i < n_dim; i++)
+          {
+            centroid[e][i] += el_pt->node_pt(j)->x(i) / double(n_node);
+          }
+        }
+        element_index[e] = e;
+      }
+
+      // Partition the elements
+      Vector<unsigned> element_subdomain(n_element, 0);
+      bisect_elements(
+        centroid, element_index, 0, n_subdomain, element_subdomain);
+
+      // Assign the dofs
+      dof_subdomain.assign(n_dof, n_subdomain);
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = mesh_pt->element_pt(e);
+        const unsigned n_el_dof = el_pt->ndof();
+        for (unsigned j = 0; j < n_el_dof; j++)
+        {
+          unsigned long eqn = el_pt->eqn_number(j);
+          if (dof_subdomain[eqn] == n_subdomain)
+          {
+            dof_subdomain[eqn] = element_subdomain[e];
+          }
+        }
+      }
+
+      // Dofs that aren't associated with any element (shouldn't happen)
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        if (dof_subdomain[i] == n_subdomain)
+        {
+          dof_subdomain[i] = 0;
+        }
+      }
+    }
+
+  } // namespace SubdomainPartitioningHelpers
+
+
+  //===========================================================================
+  /// Overlapping additive Schwarz preconditioner with a coarse space
+  /// correction:
+  /// \f[ P^{-1} = \sum_i R_i^T A_i^{-1} R_i + Z A_0^{-1} Z^T, \f]
+  /// where R_i restricts to the dofs in subdomain i (extended by a
+  /// specified number of layers of overlap in the matrix graph), A_i is
+  /// the corresponding diagonal block of the matrix (factorised by
+  /// SuperLU) and \f$ A_0 = Z^T A Z \f$. The columns of Z span the
+  /// piecewise constant fields on the non-overlapping subdomains
+  /// (Nicolaides' coarse space): If the nodal values that store the
+  /// fields (for the FvK elements: u_x, u_y and w) are specified with
+  /// set_coarse_space_fields(...), there's one column per field and
+  /// subdomain, which is 1 for the (nodal) value of that field and 0 for
+  /// all other dofs (in particular the Hermite derivative dofs, for which
+  /// a constant isn't a low-energy mode); otherwise there's one column
+  /// per subdomain, which is 1 for all its dofs. There's no coarse space
+  /// correction for a single subdomain (which is solved exactly anyway).
+  /// With the restricted variant (default) the subdomain corrections are
+  /// only added for the subdomains' own (non-overlapping) dofs, which
+  /// typically converges faster.
+  ///
+  /// The partition of the dofs into subdomains can be specified (e.g.
+  /// from a partition of the mesh, see
+  /// SubdomainPartitioningHelpers::partition_dofs_by_mesh(...));
+  /// otherwise the dofs are partitioned by a breadth-first traversal of
+  /// the matrix graph.
+  ///
+  /// If run on multiple MPI processes, the matrix is replicated on all
+  /// processes, but each process only factorises (and solves for) the
+  /// subdomains it owns (subdomain i lives on process i % nproc); the
+  /// subdomain corrections are then summed across the processes. The
+  /// number of subdomains defaults to the number of processes.
+  //===========================================================================
+  class AdditiveSchwarzPreconditioner : public Preconditioner
+  {
+  public:
+    /// Constructor
+    AdditiveSchwarzPreconditioner()
+      : Nsubdomain(0),
+        Noverlap(1),
+        Use_restricted_schwarz(true),
+        Use_coarse_space(true),
+        Coarse_space_mesh_pt(0),
+        Ncoarse_dof(0),
+        Global_distribution_pt(0)
+    {
+    }
+
+    /// Broken copy constructor
+    AdditiveSchwarzPreconditioner(const AdditiveSchwarzPreconditioner&) =
+      delete;
+
+    /// Broken assignment operator
+    void operator=(const AdditiveSchwarzPreconditioner&) = delete;
+
+    /// Destructor
+    ~AdditiveSchwarzPreconditioner()
+    {
+      clean_up_memory();
+    }
+
+    /// Number of subdomains (if not specified, the number of entries in
+    /// the partition or, failing that, the number of processes)
+    unsigned& nsubdomain()
+    {
+      return Nsubdomain;
+    }
+
+    /// Number of layers of overlap (in the matrix graph; default 1)
+    unsigned& noverlap()
+    {
+      return Noverlap;
+    }
+
+    /// Specify the subdomain for each (global) dof
+    void set_dof_subdomain(const Vector<unsigned>& dof_subdomain)
+    {
+      Dof_subdomain = dof_subdomain;
+    }
+
+    /// Add the subdomain corrections for all (overlapping) dofs
+    void disable_restricted_schwarz()
+    {
+      Use_restricted_schwarz = false;
+    }
+
+    /// Only add the subdomain corrections for the subdomains' own dofs
+    /// (default)
+    void enable_restricted_schwarz()
+    {
+      Use_restricted_schwarz = true;
+    }
+
+    /// Add the coarse space correction (default)
+    void enable_coarse_space()
+    {
+      Use_coarse_space = true;
+    }
+
+    /// No coarse space correction (one-level method)
+    void disable_coarse_space()
+    {
+      Use_coarse_space = false;
+    }
+
+    /// Specify the mesh and the indices of the nodal values that store
+    /// the fields whose (subdomain-wise) constants span the coarse space
+    void set_coarse_space_fields(Mesh* const& mesh_pt,
+                                 const Vector<unsigned>& field_value_index)
+    {
+      Coarse_space_mesh_pt = mesh_pt;
+      Coarse_space_field_value_index = field_value_index;
+    }
+
+    /// Set up the preconditioner: Partition the dofs, extract and
+    /// factorise the subdomain matrices and the coarse matrix
+    void setup()
+    {
+      clean_up_memory();
+
+      CRDoubleMatrix* cr_matrix_pt = dynamic_cast<CRDoubleMatrix*>(matrix_pt());
+      if (cr_matrix_pt == 0)
+      {
+        throw OomphLibError(
+          "AdditiveSchwarzPreconditioner requires a CRDoubleMatrix",
+          OOMPH_CURRENT_FUNCTION,
+          OOMPH_EXCEPTION_LOCATION);
+      }
+      this->build_distribution(cr_matrix_pt->distribution_pt());
+
+      // Replicate the matrix on all processes
+      Global_distribution_pt = new LinearAlgebraDistribution(
+        comm_pt(), cr_matrix_pt->nrow(), false);
+      CRDoubleMatrix* global_matrix_pt = cr_matrix_pt;
+      if (cr_matrix_pt->distributed())
+      {
+        global_matrix_pt = new CRDoubleMatrix(*cr_matrix_pt);
+        global_matrix_pt->redistribute(Global_distribution_pt);
+      }
+      const unsigned long n_row = global_matrix_pt->nrow();
+      const double* value_pt = global_matrix_pt->value();
+      const int* column_index_pt = global_matrix_pt->column_index();
+      const int* row_start_pt = global_matrix_pt->row_start();
+
+      // Partition the dofs
+      unsigned n_proc = 1;
+      unsigned my_rank = 0;
+#ifdef OOMPH_HAS_MPI
+      n_proc = comm_pt()->nproc();
+      my_rank = comm_pt()->my_rank();
+#endif
+      if (Dof_subdomain.size() != n_row)
+      {
+        if (Nsubdomain == 0)
+        {
+          Nsubdomain = n_proc;
+        }
+        partition_dofs_by_matrix_graph(global_matrix_pt);
+      }
+      else if (Nsubdomain == 0)
+      {
+        Nsubdomain = 1 + *std::max_element(Dof_subdomain.begin(),
+                                            Dof_subdomain.end());
+      }
+
+      // Set up the subdomains owned by this process
+      Subdomain_dof.resize(Nsubdomain);
+      Subdomain_solver_pt.resize(Nsubdomain, 0);
+      Subdomain_distribution_pt.resize(Nsubdomain, 0);
+      for (unsigned s = my_rank; s < Nsubdomain; s += n_proc)
+      {
+        // Own dofs...
+        Vector<int> in_subdomain(n_row, -1);
+        Vector<unsigned long>& subdomain_dof = Subdomain_dof[s];
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          if (Dof_subdomain[i] == s)
+          {
+            in_subdomain[i] = subdomain_dof.size();
+            subdomain_dof.push_back(i);
+          }
+        }
+
+        // ...plus overlap
+        unsigned long first_new = 0;
+        for (unsigned l = 0; l < Noverlap; l++)
+        {
+          unsigned long n_old = subdomain_dof.size();
+          for (unsigned long k = first_new; k < n_old; k++)
+          {
+            unsigned long row = subdomain_dof[k];
+            for (int j = row_start_pt[row]; j < row_start_pt[row + 1]; j++)
+            {
+              int column = column_index_pt[j];
+              if (in_subdomain[column] < 0)
+              {
+                in_subdomain[column] = subdomain_dof.size();
+                subdomain_dof.push_back(column);
+              }
+            }
+          }
+          first_new = n_old;
+        }
+
+        // Extract the subdomain matrix
+        const unsigned long n_sub = subdomain_dof.size();
+        if (n_sub == 0)
+        {
+          continue;
+        }
+        Vector<double> sub_value;
+        Vector<int> sub_column_index;
+        Vector<int> sub_row_start(n_sub + 1, 0);
+        for (unsigned long k = 0; k < n_sub; k++)
+        {
+          unsigned long row = subdomain_dof[k];
+          for (int j = row_start_pt[row]; j < row_start_pt[row + 1]; j++)
+          {
+            int sub_column = in_subdomain[column_index_pt[j]];
+            if (sub_column >= 0)
+            {
+              sub_value.push_back(value_pt[j]);
+              sub_column_index.push_back(sub_column);
+            }
+          }
+          sub_row_start[k + 1] = sub_value.size();
+        }
+        Subdomain_distribution_pt[s] =
+          new LinearAlgebraDistribution(comm_pt(), n_sub, false);
+        CRDoubleMatrix sub_matrix(Subdomain_distribution_pt[s],
+                                  n_sub,
+                                  sub_value,
+                                  sub_column_index,
+                                  sub_row_start);
+
+        // Factorise (the solve for a dummy rhs does the factorisation;
+        // subsequent solves are back-substitutions)
+        SuperLUSolver* solver_pt = new SuperLUSolver;
+#ifdef OOMPH_HAS_MPI
+        solver_pt->use_serial_solve_in_parallel();
+#endif
+        solver_pt->enable_resolve();
+        DoubleVector dummy_rhs(Subdomain_distribution_pt[s], 0.0);
+        DoubleVector dummy_result;
+        solver_pt->solve(&sub_matrix, dummy_rhs, dummy_result);
+        Subdomain_solver_pt[s] = solver_pt;
+      }
+
+      // Coarse matrix A_0 = Z^T A Z
+      if (Use_coarse_space && (Nsubdomain > 1))
+      {
+        setup_coarse_dofs(n_row);
+        Coarse_matrix.resize(Ncoarse_dof, Ncoarse_dof, 0.0);
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          if (Coarse_dof[i] < 0)
+          {
+            continue;
+          }
+          for (int j = row_start_pt[i]; j < row_start_pt[i + 1]; j++)
+          {
+            long coarse_column = Coarse_dof[column_index_pt[j]];
+            if (coarse_column >= 0)
+            {
+              Coarse_matrix(Coarse_dof[i], coarse_column) += value_pt[j];
+            }
+          }
+        }
+        Coarse_matrix.ludecompose();
+      }
+
+      if (global_matrix_pt != cr_matrix_pt)
+      {
+        delete global_matrix_pt;
+      }
+    }
+
+    /// Apply the preconditioner: z = P^{-1} r
+    void preconditioner_solve(const DoubleVector& r, DoubleVector& z)
+    {
+      // Replicate the rhs on all processes
+      DoubleVector global_r(r);
+      global_r.redistribute(Global_distribution_pt);
+      const unsigned long n_row = global_r.nrow();
+
+      // Subdomain corrections from the subdomains on this process
+      Vector<double> correction(n_row, 0.0);
+      for (unsigned s = 0; s < Nsubdomain; s++)
+      {
+        if (Subdomain_solver_pt[s] == 0)
+        {
+          continue;
+        }
+        const Vector<unsigned long>& subdomain_dof = Subdomain_dof[s];
+        const unsigned long n_sub = subdomain_dof.size();
+        DoubleVector sub_r(Subdomain_distribution_pt[s], 0.0);
+        for (unsigned long k = 0; k < n_sub; k++)
+        {
+          sub_r[k] = global_r[subdomain_dof[k]];
+        }
+        DoubleVector sub_z;
+        Subdomain_solver_pt[s]->resolve(sub_r, sub_z);
+        for (unsigned long k = 0; k < n_sub; k++)
+        {
+          unsigned long i = subdomain_dof[k];
+          if ((!Use_restricted_schwarz) || (Dof_subdomain[i] == s))
+          {
+            correction[i] += sub_z[k];
+          }
+        }
+      }
+
+      // Sum over the processes
+#ifdef OOMPH_HAS_MPI
+      if (comm_pt()->nproc() > 1)
+      {
+        Vector<double> local_correction(correction);
+        MPI_Allreduce(&local_correction[0],
+                      &correction[0],
+                      n_row,
+                      MPI_DOUBLE,
+                      MPI_SUM,
+                      comm_pt()->mpi_comm());
+      }
+#endif
+
+      // Coarse space correction
+      if (Use_coarse_space && (Nsubdomain > 1))
+      {
+        DoubleVector coarse_r(
+          LinearAlgebraDistribution(comm_pt(), Ncoarse_dof, false), 0.0);
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          if (Coarse_dof[i] >= 0)
+          {
+            coarse_r[Coarse_dof[i]] += global_r[i];
+          }
+        }
+        Coarse_matrix.lubksub(coarse_r);
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          if (Coarse_dof[i] >= 0)
+          {
+            correction[i] += coarse_r[Coarse_dof[i]];
+          }
+        }
+      }
+
+      // Return in the distribution of the rhs
+      z.build(Global_distribution_pt, 0.0);
+      for (unsigned long i = 0; i < n_row; i++)
+      {
+        z[i] = correction[i];
+      }
+      z.redistribute(r.distribution_pt());
+    }
+
+    /// Clean up the memory (the partition is retained)
+    void clean_up_memory()
+    {
+      const unsigned n_solver = Subdomain_solver_pt.size();
+      for (unsigned s = 0; s < n_solver; s++)
+      {
+        delete Subdomain_solver_pt[s];
+        delete Subdomain_distribution_pt[s];
+      }
+      Subdomain_solver_pt.clear();
+      Subdomain_distribution_pt.clear();
+      Subdomain_dof.clear();
+      delete Global_distribution_pt;
+      Global_distribution_pt = 0;
+    }
+
+  private:
+    /// Identify the coarse dof (column of Z) that each dof contributes to
+    /// (-1 for none): the pair (subdomain, field) if the fields have been
+    /// specified (only the pairs that have any unpinned dofs are kept, so
+    /// the coarse matrix has no empty rows), otherwise the subdomain
+    void setup_coarse_dofs(const unsigned long& n_row)
+    {
+      Coarse_dof.assign(n_row, -1);
+      if (Coarse_space_mesh_pt == 0)
+      {
+        for (unsigned long i = 0; i < n_row; i++)
+        {
+          Coarse_dof[i] = Dof_subdomain[i];
+        }
+        Ncoarse_dof = Nsubdomain;
+        return;
+      }
+
+      const unsigned n_field = Coarse_space_field_value_index.size();
+      std::map<std::pair<unsigned, unsigned>, long> coarse_dof_of_field;
+      Ncoarse_dof = 0;
+      const unsigned long n_node = Coarse_space_mesh_pt->nnode();
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = Coarse_space_mesh_pt->node_pt(j);
+        for (unsigned f = 0; f < n_field; f++)
+        {
+          unsigned index = Coarse_space_field_value_index[f];
+          if (index >= nod_pt->nvalue())
+          {
+            continue;
+          }
+          long eqn = nod_pt->eqn_number(index);
+          if (eqn < 0)
+          {
+            continue;
+          }
+          std::pair<unsigned, unsigned> key(Dof_subdomain[eqn], f);
+          std::map<std::pair<unsigned, unsigned>, long>::iterator it =
+            coarse_dof_of_field.find(key);
+          if (it == coarse_dof_of_field.end())
+          {
+            it = coarse_dof_of_field.insert(std::make_pair(key, Ncoarse_dof))
+                   .first;
+            Ncoarse_dof++;
+          }
+          Coarse_dof[eqn] = it->second;
+        }
+      }
+    }
+
+    /// Partition the dofs into Nsubdomain subdomains of (roughly) equal
+    /// size by a breadth-first traversal of the matrix graph, so each
+    /// subdomain is a connected set of dofs (if the graph is connected).
+    void partition_dofs_by_matrix_graph(CRDoubleMatrix* const& matrix_pt)
+    {
+      const unsigned long n_row = matrix_pt->nrow();
+      const int* column_index_pt = matrix_pt->column_index();
+      const int* row_start_pt = matrix_pt->row_start();
+
+      // Breadth-first ordering (restarted for disconnected components)
+      Vector<unsigned long> order;
+      order.reserve(n_row);
+      std::vector<bool> visited(n_row, false);
+      for (unsigned long seed = 0; seed < n_row; seed++)
+      {
+        if (visited[seed])
+        {
+          continue;
+        }
+        visited[seed] = true;
+        unsigned long first = order.size();
+        order.push_back(seed);
+        while (first < order.size())
+        {
+          unsigned long row = order[first++];
+          for (int j = row_start_pt[row]; j < row_start_pt[row + 1]; j++)
+          {
+            int column = column_index_pt[j];
+            if (!visited[column])
+            {
+              visited[column] = true;
+              order.push_back(column);
+            }
+          }
+        }
+      }
+
+      // Chop the ordering into chunks
+      Dof_subdomain.resize(n_row);
+      for (unsigned long k = 0; k < n_row; k++)
+      {
+        Dof_subdomain[order[k]] = (k * Nsubdomain) / n_row;
+      }
+    }
+
+    /// Number of subdomains
+    unsigned Nsubdomain;
+
+    /// Number of layers of overlap
+    unsigned Noverlap;
+
+    /// Use the restricted variant?
+    bool Use_restricted_schwarz;
+
+    /// Use the coarse space correction?
+    bool Use_coarse_space;
+
+    /// Mesh whose nodes store the fields that span the coarse space (null
+    /// if not specified)
+    Mesh* Coarse_space_mesh_pt;
+
+    /// Indices of the nodal values that store those fields
+    Vector<unsigned> Coarse_space_field_value_index;
+
+    /// Coarse dof (column of Z) for each (global) dof; -1 for none
+    Vector<long> Coarse_dof;
+
+    /// Number of coarse dofs
+    unsigned long Ncoarse_dof;
+
+    /// Subdomain for each (global) dof
+    Vector<unsigned> Dof_subdomain;
+
+    /// Dofs in each subdomain (incl. overlap; only for the subdomains
+    /// owned by this process)
+    Vector<Vector<unsigned long>> Subdomain_dof;
+
+    /// Factorised subdomain matrices (null for the subdomains that
+    /// aren't owned by this process)
+    Vector<SuperLUSolver*> Subdomain_solver_pt;
+
+    /// Distributions of the subdomain matrices
+    Vector<LinearAlgebraDistribution*> Subdomain_distribution_pt;
+
+    /// Non-distributed distribution of the full matrix
+    LinearAlgebraDistribution* Global_distribution_pt;
+
+    /// LU decomposition of the coarse matrix
+    DenseDoubleMatrix Coarse_matrix;
+  };
+
+
+  //===========================================================================
+  /// Two-level p-multigrid preconditioner for the C1 FvK elements: The
+  /// coarse level retains all (Hermite) dofs for the out-of-plane
+  /// deflection but interpolates the in-plane displacements
+  /// quadratically (as in FoepplVonKarmanC1CurvableBellElement<3>) rather
+  /// than cubically (as in the <4> elements used for the fine level) on
+  /// the same triangulation. The prolongation P evaluates the quadratic
+  /// interpolant (from the vertex values and one value per edge) at the
+  /// fine element's nodes, so no mesh hierarchy is required; the coarse
+  /// operator is the Galerkin product \f$ A_c = P^T A P \f$, which is
+  /// factorised by SuperLU. One application of the preconditioner
+  /// comprises damped Jacobi pre-smoothing, the coarse grid correction
+  /// and damped Jacobi post-smoothing.
+  ///
+  /// The mesh and the indices of the nodal values that store the in-plane
+  /// displacements must be specified before the setup. The (triangular)
+  /// elements must be able to provide the local coordinates of their
+  /// nodes.
+  //===========================================================================
+  class PMultigridPreconditioner : public Preconditioner
+  {
+  public:
+    /// Constructor
+    PMultigridPreconditioner()
+      : Mesh_pt(0),
+        Nsmooth(2),
+        Jacobi_damping_factor(2.0 / 3.0),
+        Ncoarse_dof(0),
+        Coarse_solver_pt(0),
+        Coarse_distribution_pt(0),
+        Matrix_pt(0)
+    {
+    }
+
+    /// Broken copy constructor
+    PMultigridPreconditioner(const PMultigridPreconditioner&) = delete;
+
+    /// Broken assignment operator
+    void operator=(const PMultigridPreconditioner&) = delete;
+
+    /// Destructor
+    ~PMultigridPreconditioner()
+    {
+      clean_up_memory();
+    }
+
+    /// Specify the mesh and the indices of the nodal values that store
+    /// the in-plane displacements
+    void set_mesh(Mesh* const& mesh_pt,
+                  const Vector<unsigned>& in_plane_value_index)
+    {
+      Mesh_pt = mesh_pt;
+      In_plane_value_index = in_plane_value_index;
+    }
+
+    /// Number of pre- and post-smoothing sweeps (default 2)
+    unsigned& nsmooth()
+    {
+      return Nsmooth;
+    }
+
+    /// Damping factor for the Jacobi smoother (default 2/3)
+    double& jacobi_damping_factor()
+    {
+      return Jacobi_damping_factor;
+    }
+
+    /// Number of coarse dofs
+    unsigned long ncoarse_dof() const
+    {
+      return Ncoarse_dof;
+    }
+
+    /// Set up the preconditioner: Build the prolongation, form and
+    /// factorise the coarse operator
+    void setup()
+    {
+      clean_up_memory();
+      if (Mesh_pt == 0)
+      {
+        throw OomphLibError(
+          "Mesh must be specified with set_mesh(...) before setup",
+          OOMPH_CURRENT_FUNCTION,
+          OOMPH_EXCEPTION_LOCATION);
+      }
+      Matrix_pt = dynamic_cast<CRDoubleMatrix*>(matrix_pt());
+      if ((Matrix_pt == 0) || Matrix_pt->distributed())
+      {
+        throw OomphLibError(
+          "PMultigridPreconditioner requires a non-distributed CRDoubleMatrix",
+          OOMPH_CURRENT_FUNCTION,
+          OOMPH_EXCEPTION_LOCATION);
+      }
+      this->build_distribution(Matrix_pt->distribution_pt());
+
+      build_prolongation();
+      const unsigned long n_fine = Matrix_pt->nrow();
+      const unsigned long n_coarse = Ncoarse_dof;
+
+      // Inverse diagonal for the smoother
+      const double* value_pt = Matrix_pt->value();
+      const int* column_index_pt = Matrix_pt->column_index();
+      const int* row_start_pt = Matrix_pt->row_start();
+      Inverse_diagonal.assign(n_fine, 1.0);
+      for (unsigned long i = 0; i < n_fine; i++)
+      {
+        for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+        {
+          if ((unsigned long)(column_index_pt[k]) == i && value_pt[k] != 0.0)
+          {
+            Inverse_diagonal[i] = 1.0 / value_pt[k];
+          }
+        }
+      }
+
+      // Galerkin coarse operator A_c = P^T A P
+      Vector<std::map<unsigned long, double>> coarse_row(n_coarse);
+      for (unsigned long i = 0; i < n_fine; i++)
+      {
+        const unsigned n_p_i = Prolongation_column[i].size();
+        for (int k = row_start_pt[i]; k < row_start_pt[i + 1]; k++)
+        {
+          unsigned long j = column_index_pt[k];
+          const unsigned n_p_j = Prolongation_column[j].size();
+          for (unsigned a = 0; a < n_p_i; a++)
+          {
+            double factor = Prolongation_weight[i][a] * value_pt[k];
+            for (unsigned b = 0; b < n_p_j; b++)
+            {
+              coarse_row[Prolongation_column[i][a]]
+                        [Prolongation_column[j][b]] +=
+                factor * Prolongation_weight[j][b];
+            }
+          }
+        }
+      }
+      Vector<double> coarse_value;
+      Vector<int> coarse_column_index;
+      Vector<int> coarse_row_start(n_coarse + 1, 0);
+      for (unsigned long i = 0; i < n_coarse; i++)
+      {
+        for (std::map<unsigned long, double>::iterator it =
+               coarse_row[i].begin();
+             it != coarse_row[i].end();
+             it++)
+        {
+          coarse_value.push_back(it->second);
+          coarse_column_index.push_back(it->first);
+        }
+        coarse_row_start[i + 1] = coarse_value.size();
+      }
+      Coarse_distribution_pt =
+        new LinearAlgebraDistribution(comm_pt(), n_coarse, false);
+      CRDoubleMatrix coarse_matrix(Coarse_distribution_pt,
+                                   n_coarse,
+                                   coarse_value,
+                                   coarse_column_index,
+                                   coarse_row_start);
+
+      // Factorise
+      Coarse_solver_pt = new SuperLUSolver;
+      Coarse_solver_pt->enable_resolve();
+      DoubleVector dummy_rhs(Coarse_distribution_pt, 0.0);
+      DoubleVector dummy_result;
+      Coarse_solver_pt->solve(&coarse_matrix, dummy_rhs, dummy_result);
+    }
+
+    /// Apply the preconditioner: z = P^{-1} r
+    void preconditioner_solve(const DoubleVector& r, DoubleVector& z)
+    {
+      const unsigned long n_fine = r.nrow();
+      const unsigned long n_coarse = Ncoarse_dof;
+      z.build(r.distribution_pt(), 0.0);
+
+      // Pre-smoothing
+      smooth(r, z);
+
+      // Restrict the residual
+      DoubleVector residual(r.distribution_pt(), 0.0);
+      get_residual(r, z, residual);
+      DoubleVector coarse_r(Coarse_distribution_pt, 0.0);
+      for (unsigned long i = 0; i < n_fine; i++)
+      {
+        const unsigned n_p = Prolongation_column[i].size();
+        for (unsigned a = 0; a < n_p; a++)
+        {
+          coarse_r[Prolongation_column[i][a]] +=
+            Prolongation_weight[i][a] * residual[i];
+        }
+      }
+
+      // Coarse grid correction
+      DoubleVector coarse_z;
+      if (n_coarse > 0)
+      {
+        Coarse_solver_pt->resolve(coarse_r, coarse_z);
+      }
+      for (unsigned long i = 0; i < n_fine; i++)
+      {
+        const unsigned n_p = Prolongation_column[i].size();
+        for (unsigned a = 0; a < n_p; a++)
+        {
+          z[i] +=
+            Prolongation_weight[i][a] * coarse_z[Prolongation_column[i][a]];
+        }
+      }
+
+      // Post-smoothing
+      smooth(r, z);
+    }
+
+    /// Clean up the memory
+    void clean_up_memory()
+    {
+      delete Coarse_solver_pt;
+      Coarse_solver_pt = 0;
+      delete Coarse_distribution_pt;
+      Coarse_distribution_pt = 0;
+    }
+
+  private:
+    /// Residual r - A z
+    void get_residual(const DoubleVector& r,
+                      const DoubleVector& z,
+                      DoubleVector& residual)
+    {
+      Matrix_pt->multiply(z, residual);
+      const unsigned long n = r.nrow();
+      for (unsigned long i = 0; i < n; i++)
+      {
+        residual[i] = r[i] - residual[i];
+      }
+    }
+
+    /// Nsmooth damped Jacobi sweeps for A z = r
+    void smooth(const DoubleVector& r, DoubleVector& z)
+    {
+      DoubleVector residual(r.distribution_pt(), 0.0);
+      const unsigned long n = r.nrow();
+      for (unsigned iter = 0; iter < Nsmooth; iter++)
+      {
+        get_residual(r, z, residual);
+        for (unsigned long i = 0; i < n; i++)
+        {
+          z[i] += Jacobi_damping_factor * Inverse_diagonal[i] * residual[i];
+        }
+      }
+    }
+
+    /// Build the prolongation from the coarse to the fine dofs
+    void build_prolongation()
+    {
+      const unsigned long n_fine = Matrix_pt->nrow();
+      Prolongation_column.assign(n_fine, Vector<unsigned long>());
+      Prolongation_weight.assign(n_fine, Vector<double>());
+
+      // Identify the in-plane dofs
+      std::vector<bool> is_in_plane(n_fine, false);
+      const unsigned long n_node = Mesh_pt->nnode();
+      const unsigned n_index = In_plane_value_index.size();
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = Mesh_pt->node_pt(j);
+        for (unsigned k = 0; k < n_index; k++)
+        {
+          if (In_plane_value_index[k] < nod_pt->nvalue())
+          {
+            long eqn = nod_pt->eqn_number(In_plane_value_index[k]);
+            if (eqn >= 0)
+            {
+              is_in_plane[eqn] = true;
+            }
+          }
+        }
+      }
+
+      // Coarse dofs: the out-of-plane dofs are injected...
+      unsigned long n_coarse = 0;
+      for (unsigned long i = 0; i < n_fine; i++)
+      {
+        if (!is_in_plane[i])
+        {
+          Prolongation_column[i].push_back(n_coarse++);
+          Prolongation_weight[i].push_back(1.0);
+        }
+      }
+
+      // ...the in-plane dofs are interpolated from the quadratic
+      // interpolant, defined by its values at the vertices (keyed by the
+      // vertex node and the value index) and at the edges' midpoints
+      // (keyed by the two vertex nodes and the value index)
+      std::map<std::pair<std::pair<Node*, Node*>, unsigned>, unsigned long>
+        coarse_in_plane_dof;
+      std::vector<bool> done(n_fine, false);
+      const unsigned long n_element = Mesh_pt->nelement();
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        FiniteElement* el_pt = Mesh_pt->finite_element_pt(e);
+        const unsigned n_el_node = el_pt->nnode();
+
+        // Barycentric coordinates of the nodes and the vertex nodes
+        Vector<Vector<double>> barycentric(n_el_node, Vector<double>(3));
+        Vector<Node*> vertex_pt(3, 0);
+        Vector<double> s(2);
+        for (unsigned j = 0; j < n_el_node; j++)
+        {
+          el_pt->local_coordinate_of_node(j, s);
+          barycentric[j][0] = s[0];
+          barycentric[j][1] = s[1];
+          barycentric[j][2] = 1.0 - s[0] - s[1];
+          for (unsigned v = 0; v < 3; v++)
+          {
+            if (barycentric[j][v] > 1.0 - 1.0e-8)
+            {
+              vertex_pt[v] = el_pt->node_pt(j);
+            }
+          }
+        }
+
+        for (unsigned j = 0; j < n_el_node; j++)
+        {
+          Node* nod_pt = el_pt->node_pt(j);
+          const Vector<double>& l = barycentric[j];
+          for (unsigned k = 0; k < n_index; k++)
+          {
+            unsigned index = In_plane_value_index[k];
+            if (index >= nod_pt->nvalue())
+            {
+              continue;
+            }
+            long eqn = nod_pt->eqn_number(index);
+            if ((eqn < 0) || done[eqn])
+            {
+              continue;
+            }
+            done[eqn] = true;
+
+            // Vertex contributions (pinned vertex values don't contribute
+            // to the correction)
+            for (unsigned v = 0; v < 3; v++)
+            {
+              double weight = l[v] * (2.0 * l[v] - 1.0);
+              if ((std::fabs(weight) > 1.0e-12) &&
+                  (vertex_pt[v]->eqn_number(index) >= 0))
+              {
+                add_coarse_in_plane_contribution(vertex_pt[v],
+                                                 vertex_pt[v],
+                                                 index,
+                                                 weight,
+                                                 eqn,
+                                                 n_coarse,
+                                                 coarse_in_plane_dof);
+              }
+            }
+
+            // Edge contributions
+            for (unsigned v = 0; v < 3; v++)
+            {
+              unsigned v_next = (v + 1) % 3;
+              double weight = 4.0 * l[v] * l[v_next];
+              if (std::fabs(weight) > 1.0e-12)
+              {
+                add_coarse_in_plane_contribution(
+                  std::min(vertex_pt[v], vertex_pt[v_next]),
+                  std::max(vertex_pt[v], vertex_pt[v_next]),
+                  index,
+                  weight,
+                  eqn,
+                  n_coarse,
+                  coarse_in_plane_dof);
+              }
+            }
+          }
+        }
+      }
+      Ncoarse_dof = n_coarse;
+    }
+
+    /// Add the contribution of the coarse in-plane dof associated with
+    /// the two vertex nodes (the same node for a vertex dof) and the value
+    /// index to the prolongation for the fine dof eqn
+    void add_coarse_in_plane_contribution(
+      Node* const& first_node_pt,
+      Node* const& second_node_pt,
+      const unsigned& index,
+      const double& weight,
+      const long& eqn,
+      unsigned long& n_coarse,
+      std::map<std::pair<std::pair<Node*, Node*>, unsigned>, unsigned long>&
+        coarse_in_plane_dof)
+    {
+      std::pair<std::pair<Node*, Node*>, unsigned> key(
+        std::make_pair(first_node_pt, second_node_pt), index);
+      std::map<std::pair<std::pair<Node*, Node*>, unsigned>,
+               unsigned long>::iterator it = coarse_in_plane_dof.find(key);
+      unsigned long coarse_dof = 0;
+      if (it == coarse_in_plane_dof.end())
+      {
+        coarse_dof = n_coarse++;
+        coarse_in_plane_dof[key] = coarse_dof;
+      }
+      else
+      {
+        coarse_dof = it->second;
+      }
+      Prolongation_column[eqn].push_back(coarse_dof);
+      Prolongation_weight[eqn].push_back(weight);
+    }
+
+    /// Mesh
+    Mesh* Mesh_pt;
+
+    /// Indices of the nodal values that store the in-plane displacements
+    Vector<unsigned> In_plane_value_index;
+
+    /// Number of smoothing sweeps
+    unsigned Nsmooth;
+
+    /// Damping factor for the Jacobi smoother
+    double Jacobi_damping_factor;
+
+    /// Coarse dofs contributing to each fine dof...
+    Vector<Vector<unsigned long>> Prolongation_column;
+
+    /// ...and their weights
+    Vector<Vector<double>> Prolongation_weight;
+
+    /// Number of coarse dofs
+    unsigned long Ncoarse_dof;
+
+    /// Inverse of the diagonal of the matrix
+    Vector<double> Inverse_diagonal;
+
+    /// Factorised coarse operator
+    SuperLUSolver* Coarse_solver_pt;
+
+    /// Distribution of the coarse dofs
+    LinearAlgebraDistribution* Coarse_distribution_pt;
+
+    /// The (fine) matrix
+    CRDoubleMatrix* Matrix_pt;
+  };
+
+} // namespace oomph
+
+#endif
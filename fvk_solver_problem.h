@@ -0,0 +1,4758 @@
+//LIC// ====================================================================
+//LIC// This file forms part of oomph-lib, the object-oriented,
+//LIC// multi-physics finite-element library, available
+//LIC// at http://www.oomph-lib.org.
+//LIC//
+//LIC// Copyright (C) 2006-2023 Matthias Heil and Andrew Hazel
+//LIC//
+//LIC// This library is free software; you can redistribute it and/or
+//LIC// modify it under the terms of the GNU Lesser General Public
+//LIC// License as published by the Free Software Foundation; either
+//LIC// version 2.1 of the License, or (at your option) any later version.
+//LIC//
+//LIC// This library is distributed in the hope that it will be useful,
+//LIC// but WITHOUT ANY WARRANTY; without even the implied warranty of
+//LIC// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+//LIC// Lesser General Public License for more details.
+//LIC//
+//LIC// You should have received a copy of the GNU Lesser General Public
+//LIC// License along with this library; if not, write to the Free Software
+//LIC// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+//LIC// 02110-1301  USA.
+//LIC//
+//LIC// The authors may be contacted at oomph-lib@maths.man.ac.uk.
+//LIC//
+//LIC//====================================================================
+// Header file for the solution strategies shared by the FvK drivers
+#ifndef OOMPH_FVK_SOLVER_PROBLEM_HEADER
+#define OOMPH_FVK_SOLVER_PROBLEM_HEADER
+
+// Generic oomph-lib routines
+#include "generic.h"
+
+// Symmetric skyline solver (for the inertia of the Jacobian)
+#include "fvk_ldlt_solver.h"
+
+namespace oomph
+{
+
+  //===========================================================================
+  /// Assembly handler that adds the inertia terms, M a, to the elements'
+  /// residuals (and c M to their Jacobians) for the implicit time
+  /// integration in FvKSolverProblem. The mass matrix is lumped: the
+  /// element's mass (the mass per unit area times its area) is shared
+  /// equally between those of its nodes that store the displacement
+  /// values with the specified indices; all other dofs (e.g. the Hermite
+  /// derivative dofs) are massless. The time integration scheme provides
+  /// the acceleration of each dof as a linear function of its value,
+  /// a_i = c u_i + d_i. The elements' contributions are computed by the
+  /// problem's own assembly handler (which this one temporarily replaces).
+  //===========================================================================
+  class FvKInertiaAssemblyHandler : public AssemblyHandler
+  {
+  public:
+    /// Constructor: Pass the mass per unit area and the indices of the
+    /// nodal values that represent displacements
+    FvKInertiaAssemblyHandler(const double& mass_per_unit_area,
+                              const Vector<unsigned>& value_index)
+      : Mass_per_unit_area(mass_per_unit_area),
+        Value_index(value_index),
+        Acceleration_weight(0.0),
+        Problem_assembly_handler_pt(0)
+    {
+    }
+
+    /// The problem's own assembly handler, which computes the elements'
+    /// contributions (must be set before the assembly)
+    AssemblyHandler*& problem_assembly_handler_pt()
+    {
+      return Problem_assembly_handler_pt;
+    }
+
+    /// Coefficient c in the acceleration a_i = c u_i + d_i
+    double& acceleration_weight()
+    {
+      return Acceleration_weight;
+    }
+
+    /// Offsets d_i in the acceleration a_i = c u_i + d_i (indexed by the
+    /// global equation numbers)
+    Vector<double>& acceleration_offset()
+    {
+      return Acceleration_offset;
+    }
+
+    /// Get the element's residuals, including the inertia terms
+    void get_residuals(GeneralisedElement* const& elem_pt,
+                       Vector<double>& residuals)
+    {
+      Problem_assembly_handler_pt->get_residuals(elem_pt, residuals);
+      add_inertia(elem_pt, residuals, 0);
+    }
+
+    /// Get the element's residuals and Jacobian, including the inertia
+    /// terms
+    void get_jacobian(GeneralisedElement* const& elem_pt,
+                      Vector<double>& residuals,
+                      DenseMatrix<double>& jacobian)
+    {
+      Problem_assembly_handler_pt->get_jacobian(elem_pt, residuals, jacobian);
+      add_inertia(elem_pt, residuals, &jacobian);
+    }
+
+    /// Assemble the (diagonal) lumped mass matrix for the elements in the
+    /// mesh
+    void get_lumped_masses(Mesh* const& mesh_pt,
+                           const unsigned long& n_dof,
+                           Vector<double>& mass)
+    {
+      mass.assign(n_dof, 0.0);
+      const unsigned long n_element = mesh_pt->nelement();
+      Vector<int> local_eqn;
+      Vector<double> local_mass;
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* elem_pt = mesh_pt->element_pt(e);
+        get_element_lumped_masses(elem_pt, local_eqn, local_mass);
+        const unsigned n_mass = local_eqn.size();
+        for (unsigned i = 0; i < n_mass; i++)
+        {
+          mass[eqn_number(elem_pt, local_eqn[i])] += local_mass[i];
+        }
+      }
+    }
+
+  private:
+    /// Local equation numbers of the element's (free) displacement dofs
+    /// and their share of the element's mass
+    void get_element_lumped_masses(GeneralisedElement* const& elem_pt,
+                                   Vector<int>& local_eqn,
+                                   Vector<double>& local_mass)
+    {
+      local_eqn.clear();
+      local_mass.clear();
+      FiniteElement* el_pt = dynamic_cast<FiniteElement*>(elem_pt);
+      if (el_pt == 0)
+      {
+        return;
+      }
+      const unsigned n_node = el_pt->nnode();
+      const unsigned n_index = Value_index.size();
+      const double el_mass = Mass_per_unit_area * el_pt->size();
+      for (unsigned k = 0; k < n_index; k++)
+      {
+        // Number of nodes that store this value
+        unsigned n_mass_node = 0;
+        for (unsigned l = 0; l < n_node; l++)
+        {
+          if (Value_index[k] < el_pt->node_pt(l)->nvalue())
+          {
+            n_mass_node++;
+          }
+        }
+        for (unsigned l = 0; l < n_node; l++)
+        {
+          if (Value_index[k] < el_pt->node_pt(l)->nvalue())
+          {
+            int eqn = el_pt->nodal_local_eqn(l, Value_index[k]);
+            if (eqn >= 0)
+            {
+              local_eqn.push_back(eqn);
+              local_mass.push_back(el_mass / double(n_mass_node));
+            }
+          }
+        }
+      }
+    }
+
+    /// Add the inertia terms to the element's residuals (and Jacobian,
+    /// unless jacobian_pt is null)
+    void add_inertia(GeneralisedElement* const& elem_pt,
+                     Vector<double>& residuals,
+                     DenseMatrix<double>* const& jacobian_pt)
+    {
+      Vector<int> local_eqn;
+      Vector<double> local_mass;
+      get_element_lumped_masses(elem_pt, local_eqn, local_mass);
+      const unsigned n_mass = local_eqn.size();
+      for (unsigned i = 0; i < n_mass; i++)
+      {
+        const int eqn = local_eqn[i];
+        const double u = *(elem_pt->dof_pt(eqn));
+        residuals[eqn] +=
+          local_mass[i] * (Acceleration_weight * u +
+                           Acceleration_offset[eqn_number(elem_pt, eqn)]);
+        if (jacobian_pt != 0)
+        {
+          (*jacobian_pt)(eqn, eqn) += local_mass[i] * Acceleration_weight;
+        }
+      }
+    }
+
+    /// Mass per unit area
+    double Mass_per_unit_area;
+
+    /// Indices of the nodal values that represent displacements
+    Vector<unsigned> Value_index;
+
+    /// Coefficient c in the acceleration a_i = c u_i + d_i
+    double Acceleration_weight;
+
+    /// Offsets d_i in the acceleration a_i = c u_i + d_i
+    Vector<double> Acceleration_offset;
+
+    /// The problem's own assembly handler
+    AssemblyHandler* Problem_assembly_handler_pt;
+  };
+
+
+  class FvKSolverProblem;
+
+  //===========================================================================
+  /// Assembly handler for problems that own their parameters but whose
+  /// elements can only call context-free load functions (that read the
+  /// parameters of the "current" problem): It makes the problem's
+  /// parameters current (see FvKSolverProblem::make_parameters_current())
+  /// before each element's contributions are computed, so every path that
+  /// assembles the problem's equations uses them, not just those that
+  /// start with actions_before_newton_solve().
+  //===========================================================================
+  class FvKParameterContextAssemblyHandler : public AssemblyHandler
+  {
+  public:
+    /// Constructor: Pass the problem whose parameters are to be used
+    FvKParameterContextAssemblyHandler(FvKSolverProblem* const& problem_pt)
+      : Problem_pt(problem_pt)
+    {
+    }
+
+    /// Get the element's residuals
+    void get_residuals(GeneralisedElement* const& elem_pt,
+                       Vector<double>& residuals);
+
+    /// Get the element's residuals and Jacobian
+    void get_jacobian(GeneralisedElement* const& elem_pt,
+                      Vector<double>& residuals,
+                      DenseMatrix<double>& jacobian);
+
+    /// Get the element's residuals and Jacobian (and mass matrix, etc.)
+    void get_all_vectors_and_matrices(GeneralisedElement* const& elem_pt,
+                                      Vector<Vector<double>>& vec,
+                                      Vector<DenseMatrix<double>>& matrix);
+
+    /// Get the derivatives of the element's residuals with respect to a
+    /// parameter
+    void get_dresiduals_dparameter(GeneralisedElement* const& elem_pt,
+                                   double* const& parameter_pt,
+                                   Vector<double>& dres_dparam);
+
+    /// Get the derivatives of the element's residuals and Jacobian with
+    /// respect to a parameter
+    void get_djacobian_dparameter(GeneralisedElement* const& elem_pt,
+                                  double* const& parameter_pt,
+                                  Vector<double>& dres_dparam,
+                                  DenseMatrix<double>& djac_dparam);
+
+    /// Get the products of the element's Hessian with the vectors Y
+    void get_hessian_vector_products(GeneralisedElement* const& elem_pt,
+                                     Vector<double> const& Y,
+                                     DenseMatrix<double> const& C,
+                                     DenseMatrix<double>& product);
+
+  private:
+    /// The problem whose parameters are used
+    FvKSolverProblem* Problem_pt;
+  };
+
+
+  //===========================================================================
+  /// Problem base class that provides the solution strategies shared by
+  /// the FvK demo drivers (load continuation etc.). Driver problems
+  /// should derive from this instead of deriving directly from Problem.
+  /// NOTE: The class uses actions_before_newton_solve() and
+  /// actions_before_newton_step() to count the Newton iterations (and
+  /// for deflation and the inexact Newton method); derived classes that
+  /// overload these functions must call the versions defined here.
+  ///
+  /// Arc-length continuation: continuation_step(...) is a thin wrapper
+  /// around Problem::arc_length_step_solve(...) which caps the arc-length
+  /// increment and detects folds/bifurcations by monitoring the sign of
+  /// the Jacobian determinant (as set by the direct linear solver) across
+  /// the step.
+  ///
+  /// If the linear solver is the SymmetricLDLTSolver the inertia of the
+  /// Jacobian (its number of negative eigenvalues) is available at no
+  /// extra cost after each solve; a change in the inertia along the
+  /// solution path indicates a change in stability.
+  ///
+  /// Adaptive load stepping: adaptive_load_step(...) increments a global
+  /// parameter, extrapolates the initial guess for the Newton iteration
+  /// from previous converged solutions (secant) or from the solution's
+  /// derivative w.r.t. the parameter (Euler tangent) and adjusts the
+  /// step size according to the number of Newton iterations taken. Failed
+  /// steps are re-attempted with a smaller increment. All accepted and
+  /// rejected steps are recorded and can be documented with
+  /// doc_load_step_history(...).
+  ///
+  /// Linearised stability analysis: solve_for_buckling_modes(...)
+  /// computes the eigenvalues of the Jacobian that are closest to zero
+  /// (and the associated modes) at a converged, prestressed state by
+  /// shift-invert Lanczos iteration which only requires back-substitutions
+  /// with a single factorisation of the Jacobian. The sensitivity of
+  /// each eigenvalue to the load parameter along the solution path is
+  /// then used to estimate the critical load at which it passes through
+  /// zero. The analysis assumes that the Jacobian is symmetric (true for
+  /// the FvK equations with conservative loads).
+  ///
+  /// Bifurcation tracking: Once a critical point has been located (e.g.
+  /// from a buckling analysis), track_critical_load(...) follows it as a
+  /// second parameter varies. It solves the augmented system for the
+  /// state, the null vector and the critical load with Newton's method,
+  /// using oomph-lib's bifurcation tracking machinery with block (bordered)
+  /// solves that re-use the linear solver for the base Jacobian.
+  ///
+  /// Deflation: When deflation is enabled, the residuals are (implicitly)
+  /// multiplied by the deflation operator
+  /// \f$ M(u) = \prod_j ( 1/|u-u_j|^p + \sigma ) \f$, where the
+  /// \f$ u_j \f$ are previously found solutions, so subsequent Newton
+  /// solves from the same initial guess are repelled from them. The
+  /// deflated Newton step is a scalar multiple of the standard one (by the
+  /// Sherman-Morrison formula), so the step is simply rescaled in
+  /// actions_after_newton_step(); derived classes that overload this
+  /// function must call FvKSolverProblem::actions_after_newton_step().
+  ///
+  /// Globalised Newton: The (full) Newton step can be damped by a
+  /// backtracking line search on the merit function
+  /// \f$ f = \frac{1}{2} |R|^2 \f$ (with quadratic/cubic interpolation
+  /// and an Armijo sufficient-decrease test) or restricted by a trust
+  /// region whose radius is adjusted according to the ratio of the
+  /// actual to the predicted reduction of the merit function. Since the
+  /// Jacobian is not available in actions_after_newton_step(), the trust
+  /// region step is taken along the Newton direction (rather than along a
+  /// dogleg path); the predicted reduction follows from the linear model,
+  /// for which the residual along the Newton step decays linearly.
+  ///
+  /// Nonlinear elimination of the in-plane displacements: For a given
+  /// out-of-plane deflection the FvK in-plane equations are linear in the
+  /// in-plane displacements, so they can be solved exactly (by a single
+  /// linear solve with the in-plane block of the Jacobian) at the start
+  /// of each Newton step. The subsequent Newton step for the full system
+  /// then only has to correct the out-of-plane deflection (it is
+  /// equivalent to a Newton step on the Schur complement system for the
+  /// deflection), and the Newton iteration effectively acts on the
+  /// deflection only. This improves the convergence for stiff plates
+  /// (large Eta). The in-plane block is the membrane stiffness, which
+  /// doesn't depend on the solution, so it is factorised once (and again
+  /// only if the in-plane equation numbers or the parameters it depends
+  /// on change); each elimination then only requires the assembly of the
+  /// residuals and a back-substitution.
+  ///
+  /// Inexact Newton: If the linear solver is iterative, the tolerance for
+  /// the linear solves can be chosen adaptively, based on the reduction of
+  /// the nonlinear residual (Eisenstat & Walker's "choice 2"), so the early
+  /// Newton iterations are only solved loosely. The residual norms,
+  /// forcing terms and the number of linear iterations are recorded for
+  /// each Newton iteration and can be documented with
+  /// doc_inexact_newton_history(...).
+  ///
+  /// Changing boundary conditions by low-rank updates: Additional
+  /// Dirichlet conditions can be imposed as constraints on (free) dofs
+  /// rather than by pinning, so the equation numbering, and hence the
+  /// (symbolic and, with Jacobian re-use, numeric) factorisation of the
+  /// Jacobian for the less constrained problem, is retained. Each Newton
+  /// step is corrected by a bordered solve: for the k constrained dofs
+  /// (columns of the Boolean matrix C) the responses Y = J^{-1} C are
+  /// obtained by k back-substitutions and the step is corrected by
+  /// -Y S^{-1} (C^T dx - g), where S = C^T Y is the (dense, k x k) Schur
+  /// complement and g is the required change in the constrained dofs
+  /// (Sherman-Morrison-Woodbury). The residuals of the constrained
+  /// equations are replaced by the constraints themselves. Y and the
+  /// factorised S are retained for as long as the Jacobian is re-used.
+  ///
+  /// Energy minimisation: As an alternative to Newton's method,
+  /// minimise_energy() minimises the total potential energy (whose
+  /// gradient is the residual vector and whose Hessian is the Jacobian)
+  /// by a matrix-free trust-region Newton-CG (Steihaug) method: The
+  /// element Jacobians are stored (memory linear in the number of
+  /// elements) and the Hessian-vector products for the truncated CG
+  /// iteration are evaluated element by element, so the Jacobian is never
+  /// assembled or factorised. Directions of negative curvature are
+  /// followed to the trust-region boundary, so unstable equilibria are
+  /// avoided and the energy decreases monotonically, e.g. through
+  /// snap-through. The change in energy over a step s is the integral of
+  /// R(u + t s).s over t in [0,1]; since the FvK energy is quartic in the
+  /// dofs this is a cubic in t and Simpson's rule (two extra residual
+  /// evaluations) is exact, so the energy itself is never required.
+  /// When enabled, adaptive_load_step(...) and nonlinear_solve() use the
+  /// energy minimisation instead of Newton's method.
+  ///
+  /// Dynamic relaxation: dynamic_relaxation(...) integrates the fictitious
+  /// dynamics M u'' = -R(u) explicitly (central differences, unit time
+  /// step) with a lumped mass matrix chosen from Gerschgorin bounds of the
+  /// element Jacobians (so the scheme is stable) and kinetic damping:
+  /// whenever the kinetic energy passes through a maximum the dofs are
+  /// moved back to (an estimate of) the position of the peak and the
+  /// velocities are reset to zero. Each step only requires a residual-only
+  /// loop over the elements (via the assembly handler's get_residuals(),
+  /// i.e. the elements' fill_in_contribution_to_residuals()) and no
+  /// matrix is ever factorised, so it is robust (if slow) for heavily
+  /// wrinkled states. It can be used to generate the initial guess for
+  /// nonlinear_solve().
+  ///
+  /// Implicit dynamics: After enable_dynamics(...), implicit_time_step(...)
+  /// and adaptive_implicit_time_step(...) integrate M u'' + R(u) = 0 with
+  /// Newmark's trapezoidal rule or variable-step BDF2 (applied to the
+  /// displacements and velocities). The lumped mass matrix M is added to
+  /// the equations by a FvKInertiaAssemblyHandler, so any linear solver
+  /// can be used. The adaptive steps control the local truncation error,
+  /// estimated from the difference between an explicit predictor and the
+  /// solution. Within and across time steps the factorisation of the
+  /// Jacobian is reused (modified Newton) until the convergence becomes
+  /// too slow or dt changes; to make this possible dt is only increased
+  /// in sufficiently large jumps.
+  ///
+  /// Ensemble Newton: ensemble_newton_solve(...) solves the problem for
+  /// many values of the (load) parameters at once. Each iteration
+  /// assembles the Jacobians of all members that haven't converged yet
+  /// in a single pass over the elements (swapping in each member's
+  /// parameters, pinned values and dofs) and factorises them together
+  /// with an EnsembleLDLTSolver, sharing the symbolic analysis (with the
+  /// SymmetricLDLTSolver, if that's the linear solver). The Jacobians
+  /// must be symmetric. The members' boundary conditions are set up by
+  /// apply_parameter_dependent_boundary_conditions(), which problems
+  /// whose boundary conditions depend on the parameters must overload.
+  ///
+  /// Homotopy: homotopy_solve(...) ramps a parameter (e.g. Eta, or any
+  /// double registered with CommandLineArgs) from a value for which the
+  /// problem is easy to solve up to its target by adaptive load steps,
+  /// geometrically for positive parameters. Parameters can be identified
+  /// by name: drivers whose problems own their parameters (so several
+  /// problems can be solved concurrently) register them with
+  /// register_parameter(...); otherwise the doubles registered with
+  /// CommandLineArgs are used. If their elements read the parameters
+  /// through context-free load functions, such problems overload
+  /// make_parameters_current() and call
+  /// enable_parameter_context_assembly(), so the elements are always
+  /// assembled with the problem's own parameters.
+  //===========================================================================
+  class FvKSolverProblem : public virtual Problem
+  {
+  public:
+    /// Constructor: Initialise continuation parameters
+    FvKSolverProblem()
+      : Max_ds(DBL_MAX),
+        Ncontinuation_step(0),
+        Nsign_change(0),
+        Sign_change_detected(false),
+        Load_step_predictor(Secant_predictor),
+        Desired_newton_iterations_dp(4),
+        Max_dp_growth_factor(2.0),
+        Dp_cut_factor(0.5),
+        Min_dp(1.0e-12),
+        Max_dp(DBL_MAX),
+        Load_step_parameter_pt(0),
+        Nnewton_step(0),
+        Nlanczos_iteration_max(100),
+        Lanczos_tolerance(1.0e-10),
+        Deflation_is_enabled(false),
+        Deflation_power(2.0),
+        Deflation_shift(1.0),
+        Deflation_tolerance(1.0e-6),
+        Nnewton_solve(0),
+        Eisenstat_walker_forcing_is_enabled(false),
+        Eisenstat_walker_gamma(0.9),
+        Eisenstat_walker_alpha(2.0),
+        Initial_forcing_term(0.5),
+        Max_forcing_term(0.9),
+        Previous_residual_norm(0.0),
+        Forcing_term(0.0),
+        Newton_globalisation(No_globalisation),
+        Residual_norm_before_newton_step(0.0),
+        Deflation_step_scaling_factor(1.0),
+        Armijo_parameter(1.0e-4),
+        Min_newton_step_length(1.0e-4),
+        Initial_trust_region_radius(DBL_MAX),
+        Trust_region_radius(DBL_MAX),
+        Min_trust_region_radius(1.0e-12),
+        Ndamped_newton_step(0),
+        Nresidual_evaluation_in_globalisation(0),
+        In_plane_elimination_mesh_pt(0),
+        In_plane_linear_solver_pt(&Default_in_plane_linear_solver),
+        In_plane_distribution_pt(0),
+        In_plane_factorisation_is_current(false),
+        Nin_plane_elimination(0),
+        Nin_plane_factorisation(0),
+        Constraint_response_is_current(false),
+        Sign_of_schur_complement_determinant(1),
+        Sign_of_unconstrained_jacobian(0),
+        Sign_of_unconstrained_jacobian_is_current(false),
+        Nconstraint_response_solve(0),
+        Energy_minimisation_is_enabled(false),
+        Max_energy_minimisation_iterations(200),
+        Cg_relative_tolerance(0.1),
+        Max_cg_iterations(1000),
+        Initial_energy_trust_region_radius(1.0),
+        Nenergy_minimisation(0),
+        Dynamic_relaxation_mass_safety_factor(2.0),
+        Dynamic_relaxation_mass_update_interval(100),
+        Ndynamic_relaxation_initial_guess_step(0),
+        Dynamic_relaxation_initial_guess_tolerance(0.0),
+        Nkinetic_energy_peak(0),
+        Inertia_assembly_handler_pt(0),
+        Time_integration_scheme(Newmark_scheme),
+        Dynamic_time(0.0),
+        Previous_dt(0.0),
+        Dt_safety_factor(0.9),
+        Max_dt_growth_factor(2.0),
+        Dt_increase_threshold(1.5),
+        Dt_cut_factor(0.5),
+        Min_dt(1.0e-12),
+        Max_modified_newton_contraction(0.5),
+        Factorised_acceleration_weight(-1.0),
+        Nnewton_solve_at_time_step(0),
+        Log_homotopy_parameter_pt(0),
+        Log_homotopy_parameter(0.0),
+        Parameter_context_assembly_handler_pt(0),
+        Replaced_assembly_handler_pt(0)
+    {
+    }
+
+    /// Broken copy constructor
+    FvKSolverProblem(const FvKSolverProblem& dummy) = delete;
+
+    /// Broken assignment operator
+    void operator=(const FvKSolverProblem&) = delete;
+
+    /// Destructor: Delete the inertia and parameter context assembly
+    /// handlers (if any) and the linear solvers and preconditioners owned
+    /// by the problem
+    virtual ~FvKSolverProblem()
+    {
+      delete Inertia_assembly_handler_pt;
+      delete Parameter_context_assembly_handler_pt;
+      delete In_plane_distribution_pt;
+
+      // Wrappers (e.g. EquilibratedLinearSolver) and iterative solvers
+      // clean up the solvers and preconditioners they use, so delete in
+      // reverse order of adoption, and the preconditioners last
+      const unsigned n_solver = Owned_linear_solver_pt.size();
+      for (unsigned i = n_solver; i > 0; i--)
+      {
+        delete Owned_linear_solver_pt[i - 1];
+      }
+      const unsigned n_preconditioner = Owned_preconditioner_pt.size();
+      for (unsigned i = 0; i < n_preconditioner; i++)
+      {
+        delete Owned_preconditioner_pt[i];
+      }
+    }
+
+    /// Take ownership of a linear solver (created with new), which is
+    /// then deleted with the problem. Solvers that use (e.g. wrap) other
+    /// solvers must be adopted after them.
+    void adopt_linear_solver(LinearSolver* const& solver_pt)
+    {
+      Owned_linear_solver_pt.push_back(solver_pt);
+    }
+
+    /// Take ownership of a preconditioner (created with new), which is
+    /// then deleted with the problem (after the solvers)
+    void adopt_preconditioner(Preconditioner* const& preconditioner_pt)
+    {
+      Owned_preconditioner_pt.push_back(preconditioner_pt);
+    }
+
+    /// Bookkeeping at the start of each Newton solve. Derived classes
+    /// that overload this function must call it.
+    virtual void actions_before_newton_solve()
+    {
+      Nnewton_step = 0;
+      Nnewton_solve++;
+
+      // The constraint responses can only survive with the Jacobian
+      if (!jacobian_reuse_is_enabled())
+      {
+        Constraint_response_is_current = false;
+        Sign_of_unconstrained_jacobian_is_current = false;
+      }
+    }
+
+    /// Count the Newton iterations (etc.). Derived classes that overload
+    /// this function must call it.
+    virtual void actions_before_newton_step()
+    {
+      Nnewton_step++;
+
+      // Solve for the in-plane displacements with the out-of-plane ones
+      // held fixed
+      if (In_plane_elimination_mesh_pt != 0)
+      {
+        eliminate_in_plane_displacements();
+      }
+
+      // Residual norm at the start of the step (for the choice of the
+      // linear solver tolerance and/or the globalisation)
+      double max_residual = 0.0;
+      if (Eisenstat_walker_forcing_is_enabled ||
+          (Newton_globalisation != No_globalisation))
+      {
+        DoubleVector residuals;
+        get_residuals(residuals);
+        Residual_norm_before_newton_step = residuals.norm();
+        max_residual = residuals.max();
+      }
+
+      // Choose the tolerance for the linear solve
+      if (Eisenstat_walker_forcing_is_enabled)
+      {
+        set_eisenstat_walker_forcing_term(Residual_norm_before_newton_step,
+                                          max_residual);
+      }
+
+      // A new Jacobian will be factorised for this step, so the responses
+      // to the constraints (and the sign of the Jacobian) must be
+      // recomputed
+      if (!jacobian_reuse_is_enabled())
+      {
+        Constraint_response_is_current = false;
+        Sign_of_unconstrained_jacobian_is_current = false;
+      }
+
+      // Backup the dofs so we can rescale/correct the Newton step
+      Deflation_step_scaling_factor = 1.0;
+      if (Deflation_is_enabled || (Newton_globalisation != No_globalisation) ||
+          (!Constrained_dof_eqn.empty()))
+      {
+        const unsigned long n_dof = ndof();
+        Dofs_before_newton_step.resize(n_dof);
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          Dofs_before_newton_step[i] = dof(i);
+        }
+      }
+    }
+
+    /// Correct the Newton step for the constraints and rescale it if
+    /// deflation is enabled. Derived classes that overload this function
+    /// must call it.
+    virtual void actions_after_newton_step()
+    {
+      // Impose the additional Dirichlet constraints
+      if (!Constrained_dof_eqn.empty())
+      {
+        apply_constraints_to_newton_step();
+      }
+
+      if (Deflation_is_enabled)
+      {
+        apply_deflation_to_newton_step();
+      }
+
+      // Damp the (possibly deflated) step
+      if (Newton_globalisation == Line_search)
+      {
+        apply_line_search_to_newton_step();
+      }
+      else if (Newton_globalisation == Trust_region)
+      {
+        apply_trust_region_to_newton_step();
+      }
+
+      // Record the number of linear iterations
+      if (Eisenstat_walker_forcing_is_enabled)
+      {
+        Inexact_newton_history.back().Nlinear_iter =
+          iterative_linear_solver_pt()->iterations();
+      }
+    }
+
+    /// Number of Newton iterations taken during the most recent
+    /// (attempted) solve via adaptive_load_step(...)
+    unsigned nnewton_step() const
+    {
+      return Nnewton_step;
+    }
+
+
+    // Arc-length continuation
+    //------------------------
+
+    /// Take a single pseudo-arclength continuation step of (signed) size
+    /// ds in the global parameter pointed to by parameter_pt, using the
+    /// tangent predictor and step-size control of
+    /// Problem::arc_length_step_solve(...). Returns the arc-length to be
+    /// used for the next step, limited to max_ds() in magnitude.
+    /// If the sign of the Jacobian determinant changed during the step
+    /// a fold/bifurcation has been passed; this can be queried via
+    /// sign_change_detected().
+    double continuation_step(double* const& parameter_pt, const double& ds)
+    {
+      // Sign of the Jacobian determinant at the previous converged
+      // solution (zero if it has not been computed yet)
+      int old_sign = sign_of_jacobian();
+
+      // Do the actual step
+      double next_ds = arc_length_step_solve(parameter_pt, ds);
+
+      // Don't let the arc-length grow without bound
+      if (std::fabs(next_ds) > Max_ds)
+      {
+        next_ds = (next_ds > 0.0) ? Max_ds : -Max_ds;
+      }
+
+      // Check for fold/bifurcation
+      int new_sign = sign_of_jacobian();
+      Sign_change_detected =
+        ((old_sign != 0) && (new_sign != 0) && (old_sign != new_sign));
+      if (Sign_change_detected)
+      {
+        Nsign_change++;
+        oomph_info << "Sign of Jacobian changed during continuation step "
+                   << Ncontinuation_step << ": passed fold/bifurcation at "
+                   << "parameter value " << *parameter_pt << std::endl;
+      }
+
+      Ncontinuation_step++;
+      return next_ds;
+    }
+
+    /// Reset the continuation parameters (e.g. before continuing in a
+    /// different parameter)
+    void reset_continuation()
+    {
+      reset_arc_length_parameters();
+      Ncontinuation_step = 0;
+      Nsign_change = 0;
+      Sign_change_detected = false;
+    }
+
+    /// Number of negative eigenvalues of the Jacobian, from the last
+    /// LDL^T factorisation (i.e. at the last Newton iterate, which
+    /// is close to the converged solution). Returns -1 if the linear
+    /// solver isn't a SymmetricLDLTSolver.
+    long nnegative_jacobian_eigenvalue() const
+    {
+      SymmetricLDLTSolver* ldlt_solver_pt =
+        dynamic_cast<SymmetricLDLTSolver*>(linear_solver_pt());
+      if (ldlt_solver_pt == 0)
+      {
+        return -1;
+      }
+      return ldlt_solver_pt->nnegative_pivot();
+    }
+
+    /// Max. magnitude of the arc-length increment
+    double& max_ds()
+    {
+      return Max_ds;
+    }
+
+    /// Did the sign of the Jacobian change during the most recent
+    /// continuation step?
+    bool sign_change_detected() const
+    {
+      return Sign_change_detected;
+    }
+
+    /// Number of sign changes of the Jacobian (i.e. folds/bifurcations
+    /// passed) since the last reset
+    unsigned nsign_change() const
+    {
+      return Nsign_change;
+    }
+
+    /// Number of continuation steps taken since the last reset
+    unsigned ncontinuation_step() const
+    {
+      return Ncontinuation_step;
+    }
+
+
+    // Adaptive load stepping
+    //-----------------------
+
+    /// Predictors for the initial guess in adaptive_load_step(...)
+    enum LoadStepPredictor
+    {
+      Zeroth_order_predictor,
+      Secant_predictor,
+      Tangent_predictor
+    };
+
+    /// Record of an (accepted or rejected) load step
+    struct LoadStepRecord
+    {
+      /// Parameter value at the end of the step
+      double Parameter;
+
+      /// Parameter increment
+      double Dp;
+
+      /// Number of Newton iterations taken
+      unsigned Nnewton_iter;
+
+      /// Was the step accepted?
+      bool Accepted;
+    };
+
+    /// Increment the global parameter pointed to by parameter_pt by
+    /// (at most) dp and solve. The initial guess is extrapolated from
+    /// previous converged solutions, according to load_step_predictor().
+    /// If the Newton solver fails, the increment is cut back and the
+    /// step re-attempted. Returns the suggested increment for the next
+    /// step, based on the number of Newton iterations taken relative to
+    /// desired_newton_iterations_dp().
+    double adaptive_load_step(double* const& parameter_pt, const double& dp)
+    {
+      // Wipe the history if we're stepping in a different parameter
+      if (parameter_pt != Load_step_parameter_pt)
+      {
+        Load_step_parameter_pt = parameter_pt;
+        Previous_load_step_dofs.clear();
+      }
+
+      // Backup the current (converged) state
+      const unsigned long n_dof = ndof();
+      Vector<double> current_dofs(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        current_dofs[i] = dof(i);
+      }
+      const double current_parameter = *parameter_pt;
+
+      // Get the derivative of the solution w.r.t. the parameter if
+      // required (only once; it doesn't depend on the step size)
+      bool use_tangent =
+        (Load_step_predictor == Tangent_predictor) ||
+        ((Load_step_predictor == Secant_predictor) &&
+         (Previous_load_step_dofs.size() != n_dof));
+      Vector<double> dofs_deriv;
+      if (use_tangent)
+      {
+        get_dofs_derivative_wrt_parameter(parameter_pt, dofs_deriv);
+      }
+
+      // Keep trying until the step succeeds
+      double actual_dp = dp;
+      if (std::fabs(actual_dp) > Max_dp)
+      {
+        actual_dp = (actual_dp > 0.0) ? Max_dp : -Max_dp;
+      }
+      while (true)
+      {
+        // Predict the solution at the new parameter value
+        if (use_tangent)
+        {
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            dof(i) = current_dofs[i] + actual_dp * dofs_deriv[i];
+          }
+        }
+        else if (Load_step_predictor == Secant_predictor)
+        {
+          double ratio =
+            actual_dp / (current_parameter - Previous_load_step_parameter);
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            dof(i) = current_dofs[i] +
+                     ratio * (current_dofs[i] - Previous_load_step_dofs[i]);
+          }
+        }
+        *parameter_pt = current_parameter + actual_dp;
+
+        // Try to solve
+        bool success = true;
+        try
+        {
+          nonlinear_solve();
+        }
+        catch (NewtonSolverError& error)
+        {
+          success = false;
+        }
+
+        // Record the step
+        LoadStepRecord record;
+        record.Parameter = *parameter_pt;
+        record.Dp = actual_dp;
+        record.Nnewton_iter = Nnewton_step;
+        record.Accepted = success;
+        Load_step_history.push_back(record);
+
+        // Done: Shift the history and suggest the next increment
+        if (success)
+        {
+          Previous_load_step_dofs = current_dofs;
+          Previous_load_step_parameter = current_parameter;
+
+          double factor = Max_dp_growth_factor;
+          if (Nnewton_step > 0)
+          {
+            factor = std::min(Max_dp_growth_factor,
+                              double(Desired_newton_iterations_dp) /
+                                double(Nnewton_step));
+          }
+          factor = std::max(factor, Dp_cut_factor);
+          return factor * actual_dp;
+        }
+
+        // Failed: Reset and try again with a smaller increment
+        oomph_info << "Load step from " << current_parameter << " by "
+                   << actual_dp << " failed; cutting back the increment."
+                   << std::endl;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          dof(i) = current_dofs[i];
+        }
+        *parameter_pt = current_parameter;
+        actual_dp *= Dp_cut_factor;
+        if (std::fabs(actual_dp) < Min_dp)
+        {
+          std::ostringstream error_stream;
+          error_stream << "Load step from " << current_parameter
+                       << " failed with increments down to "
+                       << actual_dp / Dp_cut_factor << std::endl;
+          throw OomphLibError(error_stream.str(),
+                              OOMPH_CURRENT_FUNCTION,
+                              OOMPH_EXCEPTION_LOCATION);
+        }
+      }
+    }
+
+    /// Step the global parameter pointed to by parameter_pt to the
+    /// target value with adaptive_load_step(...), starting with
+    /// increment dp. Returns the suggested increment for the next step.
+    double adaptive_load_step_to(double* const& parameter_pt,
+                                 const double& target,
+                                 const double& dp)
+    {
+      double sign = (target > *parameter_pt) ? 1.0 : -1.0;
+      double next_dp = sign * std::fabs(dp);
+      while (sign * (target - *parameter_pt) > 0.0)
+      {
+        // Don't overshoot
+        double actual_dp = next_dp;
+        if (sign * (*parameter_pt + actual_dp - target) > 0.0)
+        {
+          actual_dp = target - *parameter_pt;
+        }
+        next_dp = adaptive_load_step(parameter_pt, actual_dp);
+      }
+      return next_dp;
+    }
+
+    /// Document the history of accepted and rejected load steps
+    void doc_load_step_history(std::ostream& outfile) const
+    {
+      outfile << "# parameter dp n_newton_iter accepted" << std::endl;
+      const unsigned n_step = Load_step_history.size();
+      for (unsigned i = 0; i < n_step; i++)
+      {
+        outfile << Load_step_history[i].Parameter << " "
+                << Load_step_history[i].Dp << " "
+                << Load_step_history[i].Nnewton_iter << " "
+                << Load_step_history[i].Accepted << std::endl;
+      }
+    }
+
+    /// Predictor used to get the initial guess in adaptive_load_step(...)
+    /// (Secant_predictor by default; falls back to Tangent_predictor
+    /// until two converged solutions are available)
+    LoadStepPredictor& load_step_predictor()
+    {
+      return Load_step_predictor;
+    }
+
+    /// Desired number of Newton iterations per load step
+    unsigned& desired_newton_iterations_dp()
+    {
+      return Desired_newton_iterations_dp;
+    }
+
+    /// Max. factor by which the load increment grows between steps
+    double& max_dp_growth_factor()
+    {
+      return Max_dp_growth_factor;
+    }
+
+    /// Factor by which the load increment is cut after a failed step
+    double& dp_cut_factor()
+    {
+      return Dp_cut_factor;
+    }
+
+    /// Min. magnitude of the load increment before we give up
+    double& min_dp()
+    {
+      return Min_dp;
+    }
+
+    /// Max. magnitude of the load increment
+    double& max_dp()
+    {
+      return Max_dp;
+    }
+
+    /// Wipe the load stepping history (e.g. after a change in the
+    /// boundary conditions)
+    void reset_load_step_history()
+    {
+      Load_step_parameter_pt = 0;
+      Previous_load_step_dofs.clear();
+      Load_step_history.clear();
+    }
+
+    /// Forget the previous solution used by the secant predictor (e.g.
+    /// after the current state has been reset externally); the next step
+    /// uses the tangent predictor. The history is retained.
+    void reset_load_step_predictor()
+    {
+      Previous_load_step_dofs.clear();
+    }
+
+
+    // Linearised stability analysis
+    //-------------------------------
+
+    /// Compute the n_mode eigenvalues of the Jacobian (at the current,
+    /// converged state) that are closest to zero, together with the
+    /// associated (normalised) eigenmodes, by shift-invert Lanczos
+    /// iteration. For each mode the derivative of the eigenvalue w.r.t.
+    /// the global load parameter pointed to by parameter_pt (along the
+    /// solution path) is computed and used to estimate the value of the
+    /// parameter at which the eigenvalue (linearly extrapolated) vanishes.
+    /// Returns the number of modes computed (may be fewer than requested
+    /// for very small problems).
+    unsigned solve_for_buckling_modes(double* const& parameter_pt,
+                                      const unsigned& n_mode)
+    {
+      // Factorise the Jacobian at the current state and keep the
+      // factors for the back-substitutions below
+      bool resolve_was_enabled = linear_solver_pt()->is_resolve_enabled();
+      linear_solver_pt()->enable_resolve();
+      DoubleVector dx;
+      linear_solver_pt()->solve(this, dx);
+      Sign_of_unconstrained_jacobian_is_current = false;
+      const unsigned n_row = dx.nrow_local();
+
+      // Number of Lanczos vectors
+      unsigned n_lanczos = std::min(
+        std::max(2 * n_mode + 20, Nlanczos_iteration_max / 2), n_row);
+      n_lanczos = std::min(n_lanczos, Nlanczos_iteration_max);
+
+      // Lanczos vectors and the tridiagonal matrix
+      Vector<Vector<double>> lanczos_vector;
+      Vector<double> alpha;
+      Vector<double> beta;
+
+      // Start vector: Something arbitrary but deterministic
+      Vector<double> v(n_row);
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        v[i] = 1.0 + 0.5 * std::sin(double(i));
+      }
+      scale_to_unit_norm(v);
+
+      // Lanczos iteration with full re-orthogonalisation for the operator
+      // J^{-1} (whose largest eigenvalues are the reciprocals of J's
+      // eigenvalues closest to zero)
+      DoubleVector rhs(dx.distribution_pt(), 0.0);
+      DoubleVector w(dx.distribution_pt(), 0.0);
+      for (unsigned j = 0; j < n_lanczos; j++)
+      {
+        lanczos_vector.push_back(v);
+
+        // Apply the operator
+        for (unsigned i = 0; i < n_row; i++)
+        {
+          rhs[i] = v[i];
+        }
+        linear_solver_pt()->resolve(rhs, w);
+        Vector<double> w_vec(n_row);
+        for (unsigned i = 0; i < n_row; i++)
+        {
+          w_vec[i] = w[i];
+        }
+
+        // Diagonal entry
+        alpha.push_back(dot_product(v, w_vec));
+
+        // Orthogonalise against all previous vectors (twice, for
+        // numerical stability)
+        for (unsigned sweep = 0; sweep < 2; sweep++)
+        {
+          for (unsigned k = 0; k <= j; k++)
+          {
+            double proj = dot_product(lanczos_vector[k], w_vec);
+            for (unsigned i = 0; i < n_row; i++)
+            {
+              w_vec[i] -= proj * lanczos_vector[k][i];
+            }
+          }
+        }
+
+        // Off-diagonal entry; stop if we've found an invariant subspace
+        double b = std::sqrt(dot_product(w_vec, w_vec));
+        if ((b < Lanczos_tolerance * std::fabs(alpha[j])) ||
+            (j == n_lanczos - 1))
+        {
+          break;
+        }
+        beta.push_back(b);
+        for (unsigned i = 0; i < n_row; i++)
+        {
+          v[i] = w_vec[i] / b;
+        }
+      }
+
+      // Eigenvalues and eigenvectors of the tridiagonal matrix
+      const unsigned n_ritz = alpha.size();
+      DenseMatrix<double> tridiagonal(n_ritz, n_ritz, 0.0);
+      for (unsigned j = 0; j < n_ritz; j++)
+      {
+        tridiagonal(j, j) = alpha[j];
+        if (j + 1 < n_ritz)
+        {
+          tridiagonal(j, j + 1) = beta[j];
+          tridiagonal(j + 1, j) = beta[j];
+        }
+      }
+      Vector<double> ritz_value;
+      DenseMatrix<double> ritz_vector;
+      symmetric_eigen_decomposition(tridiagonal, ritz_value, ritz_vector);
+
+      // Sort by decreasing magnitude of the Ritz values of J^{-1}
+      Vector<unsigned> order(n_ritz);
+      for (unsigned j = 0; j < n_ritz; j++)
+      {
+        order[j] = j;
+      }
+      std::sort(order.begin(),
+                order.end(),
+                [&ritz_value](const unsigned& a, const unsigned& b) {
+                  return std::fabs(ritz_value[a]) > std::fabs(ritz_value[b]);
+                });
+
+      // Assemble the modes and the eigenvalues of J
+      const unsigned n_mode_computed = std::min(n_mode, n_ritz);
+      Buckling_eigenvalue.resize(n_mode_computed);
+      Buckling_mode.resize(n_mode_computed);
+      for (unsigned m = 0; m < n_mode_computed; m++)
+      {
+        unsigned jj = order[m];
+        Buckling_eigenvalue[m] = 1.0 / ritz_value[jj];
+        Buckling_mode[m].assign(n_row, 0.0);
+        for (unsigned j = 0; j < n_ritz; j++)
+        {
+          for (unsigned i = 0; i < n_row; i++)
+          {
+            Buckling_mode[m][i] += ritz_vector(j, jj) * lanczos_vector[j][i];
+          }
+        }
+        scale_to_unit_norm(Buckling_mode[m]);
+      }
+
+      // Derivative of the solution w.r.t. the load parameter, using the
+      // existing factorisation: J du/dp = - dR/dp
+      const double parameter_backup = *parameter_pt;
+      Vector<double> dofs_backup(n_row);
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        dofs_backup[i] = dof(i);
+      }
+      const double fd_step =
+        1.0e-8 * std::max(1.0, std::fabs(parameter_backup));
+      DoubleVector residuals;
+      get_residuals(residuals);
+      *parameter_pt += fd_step;
+      DoubleVector perturbed_residuals;
+      get_residuals(perturbed_residuals);
+      *parameter_pt = parameter_backup;
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        rhs[i] = -(perturbed_residuals[i] - residuals[i]) / fd_step;
+      }
+      DoubleVector dofs_deriv;
+      linear_solver_pt()->resolve(rhs, dofs_deriv);
+
+      // Done with the factorisation
+      if (!resolve_was_enabled)
+      {
+        linear_solver_pt()->disable_resolve();
+      }
+
+      // Derivative of each eigenvalue along the solution path from the
+      // change in the Rayleigh quotient phi^T J phi; the Jacobian-vector
+      // products are obtained by finite differencing the residuals.
+      Buckling_eigenvalue_derivative.resize(n_mode_computed);
+      Buckling_critical_parameter.resize(n_mode_computed);
+      const double path_step =
+        1.0e-6 * std::max(1.0, std::fabs(parameter_backup));
+      for (unsigned m = 0; m < n_mode_computed; m++)
+      {
+        // Rayleigh quotient at the current state
+        double rayleigh =
+          rayleigh_quotient(Buckling_mode[m], dofs_backup, residuals);
+
+        // ...and at a state slightly further along the path
+        for (unsigned i = 0; i < n_row; i++)
+        {
+          dof(i) = dofs_backup[i] + path_step * dofs_deriv[i];
+        }
+        *parameter_pt = parameter_backup + path_step;
+        DoubleVector path_residuals;
+        get_residuals(path_residuals);
+        Vector<double> path_dofs(n_row);
+        for (unsigned i = 0; i < n_row; i++)
+        {
+          path_dofs[i] = dof(i);
+        }
+        double path_rayleigh =
+          rayleigh_quotient(Buckling_mode[m], path_dofs, path_residuals);
+
+        // Reset
+        for (unsigned i = 0; i < n_row; i++)
+        {
+          dof(i) = dofs_backup[i];
+        }
+        *parameter_pt = parameter_backup;
+
+        // Linear extrapolation to zero
+        double deriv = (path_rayleigh - rayleigh) / path_step;
+        Buckling_eigenvalue_derivative[m] = deriv;
+        if (deriv != 0.0)
+        {
+          Buckling_critical_parameter[m] =
+            parameter_backup - Buckling_eigenvalue[m] / deriv;
+        }
+        else
+        {
+          Buckling_critical_parameter[m] = DBL_MAX;
+        }
+      }
+      Buckling_parameter = parameter_backup;
+
+      return n_mode_computed;
+    }
+
+    /// Number of buckling modes computed by the most recent call to
+    /// solve_for_buckling_modes(...)
+    unsigned nbuckling_mode() const
+    {
+      return Buckling_mode.size();
+    }
+
+    /// i-th eigenvalue (closest to zero) of the Jacobian computed by the
+    /// most recent call to solve_for_buckling_modes(...)
+    double buckling_eigenvalue(const unsigned& i) const
+    {
+      return Buckling_eigenvalue[i];
+    }
+
+    /// Estimate for the value of the load parameter at which the i-th
+    /// eigenvalue vanishes
+    double buckling_critical_parameter(const unsigned& i) const
+    {
+      return Buckling_critical_parameter[i];
+    }
+
+    /// Overwrite the dofs with the i-th buckling mode, scaled by
+    /// amplitude, e.g. so it can be output with the problem's
+    /// doc_solution(). The current dofs are backed up and can be restored
+    /// with restore_dofs_after_buckling_mode().
+    void assign_buckling_mode_to_dofs(const unsigned& i,
+                                      const double& amplitude = 1.0)
+    {
+      const unsigned long n_dof = ndof();
+      Dofs_before_buckling_mode.resize(n_dof);
+      for (unsigned long j = 0; j < n_dof; j++)
+      {
+        Dofs_before_buckling_mode[j] = dof(j);
+        dof(j) = amplitude * Buckling_mode[i][j];
+      }
+    }
+
+    /// Restore the dofs backed up by assign_buckling_mode_to_dofs(...)
+    void restore_dofs_after_buckling_mode()
+    {
+      const unsigned long n_dof = Dofs_before_buckling_mode.size();
+      for (unsigned long j = 0; j < n_dof; j++)
+      {
+        dof(j) = Dofs_before_buckling_mode[j];
+      }
+      Dofs_before_buckling_mode.clear();
+    }
+
+    /// Document the results of the most recent buckling analysis:
+    /// Mode number, parameter value, eigenvalue, its derivative w.r.t.
+    /// the parameter and the estimated critical parameter value
+    void doc_buckling_analysis(std::ostream& outfile) const
+    {
+      outfile << "# mode parameter eigenvalue d_eigenvalue_d_parameter "
+              << "critical_parameter" << std::endl;
+      const unsigned n_mode = Buckling_mode.size();
+      for (unsigned m = 0; m < n_mode; m++)
+      {
+        outfile << m << " " << Buckling_parameter << " "
+                << Buckling_eigenvalue[m] << " "
+                << Buckling_eigenvalue_derivative[m] << " "
+                << Buckling_critical_parameter[m] << std::endl;
+      }
+    }
+
+    /// Max. number of Lanczos iterations in solve_for_buckling_modes(...)
+    unsigned& nlanczos_iteration_max()
+    {
+      return Nlanczos_iteration_max;
+    }
+
+
+    // Bifurcation tracking
+    //---------------------
+
+    /// Converge onto the critical point associated with the i-th
+    /// buckling mode (computed by solve_for_buckling_modes(...), which must
+    /// have been called with the same load parameter) and follow it as the
+    /// parameter pointed to by control_parameter_pt is stepped through the
+    /// specified values. The load parameter becomes an unknown while the
+    /// critical point is tracked. The (control parameter, critical load)
+    /// pairs are written to the trace_file; the values of the critical
+    /// load are also returned in critical_load. If the Newton solver fails
+    /// for a given value of the control parameter, the step towards that
+    /// value is bisected (at most max_nbisection times in succession);
+    /// after each successful sub-step the step is doubled again.
+    void track_critical_load(double* const& load_parameter_pt,
+                             const unsigned& i_mode,
+                             double* const& control_parameter_pt,
+                             const Vector<double>& control_value,
+                             std::ostream& trace_file,
+                             Vector<double>& critical_load,
+                             const unsigned& max_nbisection = 5)
+    {
+      // Start from the linearised estimate for the critical load
+      *load_parameter_pt = Buckling_critical_parameter[i_mode];
+
+      // Initial guess for the null vector
+      DoubleVector eigenvector(dof_distribution_pt(), 0.0);
+      const unsigned n_row = eigenvector.nrow_local();
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        eigenvector[i] = Buckling_mode[i_mode][i];
+      }
+
+      // Augment the system (block solve re-uses the base linear solver).
+      // The bifurcation handler calls the elements directly and deletes
+      // the handler it replaces (unless it's the default one), so
+      // select our parameters once and put the parameter context handler
+      // (if any) back afterwards.
+      make_parameters_current();
+      if (Parameter_context_assembly_handler_pt != 0)
+      {
+        assembly_handler_pt() = Replaced_assembly_handler_pt;
+      }
+      bool block_solve = true;
+      activate_bifurcation_tracking(
+        load_parameter_pt, eigenvector, block_solve);
+
+      // Converge onto the critical point at the current value of the
+      // control parameter
+      newton_solve();
+      trace_file << *control_parameter_pt << " " << *load_parameter_pt
+                 << std::endl;
+
+      // Now follow it
+      const unsigned n_value = control_value.size();
+      critical_load.resize(n_value);
+      for (unsigned v = 0; v < n_value; v++)
+      {
+        double previous_value = *control_parameter_pt;
+        double step = control_value[v] - previous_value;
+        unsigned n_bisection = 0;
+        while (*control_parameter_pt != control_value[v])
+        {
+          // Backup the augmented dofs (state, null vector and load)
+          const unsigned long n_dof = ndof();
+          Vector<double> dofs_backup(n_dof);
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            dofs_backup[i] = dof(i);
+          }
+
+          // Don't overshoot
+          double target_value = previous_value + step;
+          if (std::fabs(control_value[v] - previous_value) <=
+              std::fabs(step))
+          {
+            target_value = control_value[v];
+          }
+
+          *control_parameter_pt = target_value;
+          try
+          {
+            newton_solve();
+            previous_value = target_value;
+
+            // Grow the step back gradually
+            n_bisection = 0;
+            step *= 2.0;
+          }
+          catch (NewtonSolverError& error)
+          {
+            // Bisect the step towards the target
+            if (n_bisection == max_nbisection)
+            {
+              deactivate_bifurcation_tracking();
+              restore_parameter_context_assembly();
+              std::ostringstream error_stream;
+              error_stream << "Lost the critical point while stepping the "
+                           << "control parameter from " << previous_value
+                           << " to " << control_value[v] << std::endl;
+              throw OomphLibError(error_stream.str(),
+                                  OOMPH_CURRENT_FUNCTION,
+                                  OOMPH_EXCEPTION_LOCATION);
+            }
+            n_bisection++;
+            *control_parameter_pt = previous_value;
+            for (unsigned long i = 0; i < n_dof; i++)
+            {
+              dof(i) = dofs_backup[i];
+            }
+            step = 0.5 * (target_value - previous_value);
+          }
+        }
+
+        critical_load[v] = *load_parameter_pt;
+        oomph_info << "Critical load for control parameter "
+                   << *control_parameter_pt << ": " << critical_load[v]
+                   << std::endl;
+        trace_file << *control_parameter_pt << " " << critical_load[v]
+                   << std::endl;
+      }
+
+      // Back to the normal system
+      deactivate_bifurcation_tracking();
+      restore_parameter_context_assembly();
+    }
+
+
+    // Deflation
+    //----------
+
+    /// Enable deflation of the solutions stored with
+    /// add_deflation_solution()
+    void enable_deflation()
+    {
+      Deflation_is_enabled = true;
+    }
+
+    /// Disable deflation
+    void disable_deflation()
+    {
+      Deflation_is_enabled = false;
+    }
+
+    /// Add the current dofs to the solutions to be deflated
+    void add_deflation_solution()
+    {
+      const unsigned long n_dof = ndof();
+      Vector<double> solution(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        solution[i] = dof(i);
+      }
+      Deflation_solution.push_back(solution);
+    }
+
+    /// Wipe the solutions to be deflated
+    void clear_deflation_solutions()
+    {
+      Deflation_solution.clear();
+    }
+
+    /// Number of solutions to be deflated
+    unsigned ndeflation_solution() const
+    {
+      return Deflation_solution.size();
+    }
+
+    /// Overwrite the dofs with the i-th deflated solution
+    void assign_deflation_solution_to_dofs(const unsigned& i)
+    {
+      const unsigned long n_dof = ndof();
+      for (unsigned long j = 0; j < n_dof; j++)
+      {
+        dof(j) = Deflation_solution[i][j];
+      }
+    }
+
+    /// Do the current dofs coincide (to within deflation_tolerance(),
+    /// relative to the norm of the solution) with any of the deflated
+    /// solutions?
+    bool is_deflation_solution()
+    {
+      const unsigned long n_dof = ndof();
+      const unsigned n_solution = Deflation_solution.size();
+      for (unsigned j = 0; j < n_solution; j++)
+      {
+        double diff = 0.0;
+        double norm = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          double u = dof(i);
+          diff += std::pow(u - Deflation_solution[j][i], 2);
+          norm += u * u;
+        }
+        if (std::sqrt(diff) <=
+            Deflation_tolerance * std::max(1.0, std::sqrt(norm)))
+        {
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// Batch mode: Starting each solve from the given initial guess for
+    /// the dofs, find up to max_nsolution further solutions by deflated
+    /// Newton solves (the solutions already stored are deflated too).
+    /// Stops at the first solve that fails (or converges onto a solution
+    /// that has already been found). The new solutions are appended to the
+    /// deflated solutions; returns the number of new solutions found.
+    unsigned find_solutions_by_deflation(const Vector<double>& initial_guess,
+                                         const unsigned& max_nsolution)
+    {
+      bool deflation_was_enabled = Deflation_is_enabled;
+      enable_deflation();
+
+      const unsigned long n_dof = ndof();
+      unsigned n_found = 0;
+      for (unsigned k = 0; k < max_nsolution; k++)
+      {
+        // Reset the initial guess
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          dof(i) = initial_guess[i];
+        }
+
+        // Solve
+        bool success = true;
+        try
+        {
+          newton_solve();
+        }
+        catch (NewtonSolverError& error)
+        {
+          success = false;
+        }
+        if ((!success) || is_deflation_solution())
+        {
+          oomph_info << "Deflated Newton solve did not find a new solution; "
+                     << "stopping after " << n_found << " new solutions."
+                     << std::endl;
+          break;
+        }
+
+        // Got a new one
+        add_deflation_solution();
+        n_found++;
+        oomph_info << "Deflation found solution "
+                   << Deflation_solution.size() - 1 << std::endl;
+      }
+
+      if (!deflation_was_enabled)
+      {
+        disable_deflation();
+      }
+      return n_found;
+    }
+
+    /// Power, p, in the deflation operator (default 2)
+    double& deflation_power()
+    {
+      return Deflation_power;
+    }
+
+    /// Shift, sigma, in the deflation operator (default 1)
+    double& deflation_shift()
+    {
+      return Deflation_shift;
+    }
+
+    /// Relative tolerance for identifying solutions as duplicates
+    double& deflation_tolerance()
+    {
+      return Deflation_tolerance;
+    }
+
+
+    // Globalised Newton
+    //------------------
+
+    /// Globalisation strategies for the Newton iteration
+    enum NewtonGlobalisation
+    {
+      No_globalisation,
+      Line_search,
+      Trust_region
+    };
+
+    /// Damp the Newton steps by a backtracking line search
+    void enable_newton_line_search()
+    {
+      Newton_globalisation = Line_search;
+    }
+
+    /// Restrict the Newton steps to a trust region. The radius (in the
+    /// 2-norm of the dofs) is reset to initial_trust_region_radius() at
+    /// the start of each Newton solve.
+    void enable_newton_trust_region()
+    {
+      Newton_globalisation = Trust_region;
+    }
+
+    /// Take full Newton steps (default)
+    void disable_newton_globalisation()
+    {
+      Newton_globalisation = No_globalisation;
+    }
+
+    /// Globalisation strategy currently used
+    NewtonGlobalisation newton_globalisation() const
+    {
+      return Newton_globalisation;
+    }
+
+    /// Parameter c in the Armijo condition
+    /// \f$ f(\lambda) \le (1 - 2 c \lambda) f(0) \f$ (default 1e-4)
+    double& armijo_parameter()
+    {
+      return Armijo_parameter;
+    }
+
+    /// Min. fraction of the Newton step taken by the line search, and
+    /// min. ratio of the trust region radius to the Newton step
+    /// (default 1e-4); the step is accepted regardless when this is
+    /// reached
+    double& min_newton_step_length()
+    {
+      return Min_newton_step_length;
+    }
+
+    /// Initial trust region radius (default: unbounded, i.e. the first
+    /// Newton step is only restricted if it fails to reduce the residual)
+    double& initial_trust_region_radius()
+    {
+      return Initial_trust_region_radius;
+    }
+
+    /// Current trust region radius
+    double trust_region_radius() const
+    {
+      return Trust_region_radius;
+    }
+
+    /// Number of Newton steps that were damped since the last reset
+    unsigned ndamped_newton_step() const
+    {
+      return Ndamped_newton_step;
+    }
+
+    /// Number of additional residual evaluations performed by the
+    /// globalisation since the last reset
+    unsigned nresidual_evaluation_in_globalisation() const
+    {
+      return Nresidual_evaluation_in_globalisation;
+    }
+
+    /// Reset the counters for the globalisation
+    void reset_newton_globalisation_counters()
+    {
+      Ndamped_newton_step = 0;
+      Nresidual_evaluation_in_globalisation = 0;
+    }
+
+
+    // Nonlinear elimination
+    //----------------------
+
+    /// Eliminate the in-plane displacements (stored as the nodal values
+    /// with the specified indices at the nodes of the specified mesh) at
+    /// the start of each Newton step. The in-plane block of the Jacobian
+    /// is refactorised if any of the (optional) parameters it depends on
+    /// (e.g. Eta and Nu) change.
+    void enable_in_plane_elimination(
+      Mesh* const& mesh_pt,
+      const Vector<unsigned>& value_index,
+      const Vector<double*>& stiffness_parameter_pt = Vector<double*>())
+    {
+      In_plane_elimination_mesh_pt = mesh_pt;
+      In_plane_value_index = value_index;
+      In_plane_stiffness_parameter_pt = stiffness_parameter_pt;
+      In_plane_factorisation_is_current = false;
+    }
+
+    /// Solve for all dofs simultaneously (default)
+    void disable_in_plane_elimination()
+    {
+      In_plane_elimination_mesh_pt = 0;
+      In_plane_linear_solver_pt->clean_up_memory();
+      In_plane_factorisation_is_current = false;
+    }
+
+    /// Linear solver for the in-plane block (must be able to solve with
+    /// a given matrix and to resolve; SuperLU by default). The solver is
+    /// not deleted.
+    void set_in_plane_linear_solver(LinearSolver* const& solver_pt)
+    {
+      In_plane_linear_solver_pt->clean_up_memory();
+      In_plane_linear_solver_pt = solver_pt;
+      In_plane_factorisation_is_current = false;
+    }
+
+    /// Force the refactorisation of the in-plane block before the next
+    /// elimination (e.g. after a change in a parameter that it depends
+    /// on but that wasn't specified in enable_in_plane_elimination(...))
+    void invalidate_in_plane_factorisation()
+    {
+      In_plane_factorisation_is_current = false;
+    }
+
+    /// Number of in-plane solves performed since the last reset
+    unsigned nin_plane_elimination() const
+    {
+      return Nin_plane_elimination;
+    }
+
+    /// Number of factorisations of the in-plane block since the last
+    /// reset
+    unsigned nin_plane_factorisation() const
+    {
+      return Nin_plane_factorisation;
+    }
+
+    /// Reset the counters for the in-plane solves and factorisations
+    void reset_in_plane_elimination_counter()
+    {
+      Nin_plane_elimination = 0;
+      Nin_plane_factorisation = 0;
+    }
+
+
+    // Low-rank updates for changes in the boundary conditions
+    //---------------------------------------------------------
+
+    /// Impose the specified values for the dofs with the specified
+    /// (global) equation numbers as additional Dirichlet conditions. The
+    /// linear solver must support resolve(...); its factors are retained.
+    void set_constrained_dofs(const Vector<unsigned long>& eqn_number,
+                              const Vector<double>& value)
+    {
+#ifdef PARANOID
+      if (eqn_number.size() != value.size())
+      {
+        throw OomphLibError("Need one value per constrained dof",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+#endif
+      Constrained_dof_eqn = eqn_number;
+      Constrained_dof_value = value;
+      Constraint_response_is_current = false;
+      linear_solver_pt()->enable_resolve();
+    }
+
+    /// Remove the additional Dirichlet conditions
+    void clear_constrained_dofs()
+    {
+      Constrained_dof_eqn.clear();
+      Constrained_dof_value.clear();
+      Constraint_response.clear();
+      Constraint_response_is_current = false;
+    }
+
+    /// Number of constrained dofs
+    unsigned nconstrained_dof() const
+    {
+      return Constrained_dof_eqn.size();
+    }
+
+    /// Record the equation numbers of the nodal values (in the problem's
+    /// global mesh) before further values are pinned to change the
+    /// boundary conditions; see convert_new_pins_to_constrained_dofs()
+    void store_nodal_eqn_numbers()
+    {
+      const unsigned long n_node = mesh_pt()->nnode();
+      Stored_nodal_eqn_number.resize(n_node);
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = mesh_pt()->node_pt(j);
+        const unsigned n_value = nod_pt->nvalue();
+        Stored_nodal_eqn_number[j].resize(n_value);
+        for (unsigned i = 0; i < n_value; i++)
+        {
+          Stored_nodal_eqn_number[j][i] = nod_pt->eqn_number(i);
+        }
+      }
+    }
+
+    /// Turn the nodal values that have been pinned since the call to
+    /// store_nodal_eqn_numbers() into constrained dofs (with their
+    /// current values): They're unpinned again and get their previous
+    /// equation numbers back, so the equation numbering, and the
+    /// factorisation of the Jacobian, are unchanged.
+    void convert_new_pins_to_constrained_dofs()
+    {
+      const unsigned long n_node = mesh_pt()->nnode();
+      if (Stored_nodal_eqn_number.size() != n_node)
+      {
+        throw OomphLibError("Call store_nodal_eqn_numbers() first",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      Vector<unsigned long> eqn_number;
+      Vector<double> value;
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = mesh_pt()->node_pt(j);
+        const unsigned n_value = Stored_nodal_eqn_number[j].size();
+        for (unsigned i = 0; i < n_value; i++)
+        {
+          long eqn = Stored_nodal_eqn_number[j][i];
+          if ((eqn >= 0) && nod_pt->is_pinned(i))
+          {
+            eqn_number.push_back(eqn);
+            value.push_back(nod_pt->value(i));
+            nod_pt->unpin(i);
+            nod_pt->eqn_number(i) = eqn;
+          }
+        }
+      }
+      set_constrained_dofs(eqn_number, value);
+    }
+
+    /// Number of back-substitutions for the responses to the
+    /// constraints since the last reset
+    unsigned nconstraint_response_solve() const
+    {
+      return Nconstraint_response_solve;
+    }
+
+    /// Reset the counter for the back-substitutions
+    void reset_constraint_response_solve_counter()
+    {
+      Nconstraint_response_solve = 0;
+    }
+
+    /// Get the residuals; those of the constrained equations are replaced
+    /// by the constraints dof - value. (During a homotopy in the
+    /// logarithm of a parameter the parameter is updated first.)
+    void get_residuals(DoubleVector& residuals)
+    {
+      update_log_homotopy_parameter();
+      Problem::get_residuals(residuals);
+      const unsigned n_constraint = Constrained_dof_eqn.size();
+      for (unsigned c = 0; c < n_constraint; c++)
+      {
+        const unsigned long eqn = Constrained_dof_eqn[c];
+        residuals[eqn] = dof(eqn) - Constrained_dof_value[c];
+      }
+    }
+
+
+    // Inexact Newton
+    //---------------
+
+    /// Record of an inexact Newton iteration
+    struct InexactNewtonRecord
+    {
+      /// Number of the Newton solve
+      unsigned Newton_solve;
+
+      /// Number of the Newton iteration within the solve
+      unsigned Newton_iter;
+
+      /// 2-norm of the nonlinear residual before the iteration
+      double Residual_norm;
+
+      /// Forcing term (relative tolerance for the linear solve)
+      double Forcing_term;
+
+      /// Number of iterations taken by the linear solver
+      unsigned Nlinear_iter;
+    };
+
+    /// Choose the tolerance for the (iterative) linear solver adaptively
+    /// from the reduction in the nonlinear residual. The linear solver
+    /// must be an IterativeLinearSolver.
+    void enable_eisenstat_walker_forcing()
+    {
+      if (dynamic_cast<IterativeLinearSolver*>(linear_solver_pt()) == 0)
+      {
+        throw OomphLibError(
+          "Eisenstat-Walker forcing requires an iterative linear solver",
+          OOMPH_CURRENT_FUNCTION,
+          OOMPH_EXCEPTION_LOCATION);
+      }
+      Eisenstat_walker_forcing_is_enabled = true;
+    }
+
+    /// Use the linear solver's fixed tolerance
+    void disable_eisenstat_walker_forcing()
+    {
+      Eisenstat_walker_forcing_is_enabled = false;
+    }
+
+    /// Factor gamma in the forcing term
+    /// eta_k = gamma (|F_k|/|F_{k-1}|)^alpha (default 0.9)
+    double& eisenstat_walker_gamma()
+    {
+      return Eisenstat_walker_gamma;
+    }
+
+    /// Exponent alpha in the forcing term (default 2)
+    double& eisenstat_walker_alpha()
+    {
+      return Eisenstat_walker_alpha;
+    }
+
+    /// Forcing term for the first Newton iteration of each solve
+    double& initial_forcing_term()
+    {
+      return Initial_forcing_term;
+    }
+
+    /// Max. forcing term
+    double& max_forcing_term()
+    {
+      return Max_forcing_term;
+    }
+
+    /// Document the residual norm, forcing term and number of linear
+    /// iterations for each Newton iteration
+    void doc_inexact_newton_history(std::ostream& outfile) const
+    {
+      outfile << "# newton_solve newton_iter residual_norm forcing_term "
+              << "n_linear_iter" << std::endl;
+      const unsigned n_record = Inexact_newton_history.size();
+      for (unsigned i = 0; i < n_record; i++)
+      {
+        outfile << Inexact_newton_history[i].Newton_solve << " "
+                << Inexact_newton_history[i].Newton_iter << " "
+                << Inexact_newton_history[i].Residual_norm << " "
+                << Inexact_newton_history[i].Forcing_term << " "
+                << Inexact_newton_history[i].Nlinear_iter << std::endl;
+      }
+    }
+
+
+    // Energy minimisation
+    //--------------------
+
+    /// Record of an iteration of the energy minimisation
+    struct EnergyMinimisationRecord
+    {
+      /// Number of the minimisation
+      unsigned Minimisation;
+
+      /// Number of the iteration within the minimisation
+      unsigned Iteration;
+
+      /// 2-norm of the residuals (energy gradient) before the iteration
+      double Residual_norm;
+
+      /// Change in energy (zero if the step was rejected)
+      double Energy_change;
+
+      /// Trust-region radius for the step
+      double Trust_region_radius;
+
+      /// Number of CG iterations
+      unsigned Ncg_iter;
+
+      /// Was the step accepted?
+      bool Accepted;
+    };
+
+    /// Use the energy minimisation (rather than Newton's method) in
+    /// nonlinear_solve() and adaptive_load_step(...)
+    void enable_energy_minimisation()
+    {
+      Energy_minimisation_is_enabled = true;
+    }
+
+    /// Use Newton's method (default)
+    void disable_energy_minimisation()
+    {
+      Energy_minimisation_is_enabled = false;
+    }
+
+    /// Max. number of (accepted and rejected) trust-region iterations
+    unsigned& max_energy_minimisation_iterations()
+    {
+      return Max_energy_minimisation_iterations;
+    }
+
+    /// Relative tolerance for the truncated CG iteration
+    double& cg_relative_tolerance()
+    {
+      return Cg_relative_tolerance;
+    }
+
+    /// Max. number of CG iterations per step
+    unsigned& max_cg_iterations()
+    {
+      return Max_cg_iterations;
+    }
+
+    /// Initial trust-region radius (in the 2-norm of the dofs; default 1)
+    double& initial_energy_trust_region_radius()
+    {
+      return Initial_energy_trust_region_radius;
+    }
+
+    /// Solve the nonlinear problem with Newton's method or, if enabled,
+    /// by energy minimisation (after generating the initial guess by
+    /// dynamic relaxation, if enabled)
+    void nonlinear_solve()
+    {
+      update_log_homotopy_parameter();
+
+      // Get the initial guess by dynamic relaxation
+      if (Ndynamic_relaxation_initial_guess_step > 0)
+      {
+        dynamic_relaxation(Dynamic_relaxation_initial_guess_tolerance,
+                           Ndynamic_relaxation_initial_guess_step);
+      }
+
+      if (Energy_minimisation_is_enabled)
+      {
+        minimise_energy();
+      }
+      else
+      {
+        newton_solve();
+      }
+    }
+
+    /// Minimise the total potential energy (starting from the current
+    /// dofs) until the max. residual is below the Newton solver
+    /// tolerance. Returns the number of iterations; throws a
+    /// NewtonSolverError if it doesn't converge. The number of accepted
+    /// steps is also available from nnewton_step() (for the step-size
+    /// control in adaptive_load_step(...)).
+    unsigned minimise_energy()
+    {
+      // Same bookkeeping (and e.g. re-application of boundary conditions)
+      // as for a Newton solve
+      actions_before_newton_solve();
+      Nenergy_minimisation++;
+      const unsigned long n_dof = ndof();
+      double radius = Initial_energy_trust_region_radius;
+      Vector<double> gradient(n_dof);
+      Vector<double> step;
+      Vector<double> hessian_step(n_dof);
+      DoubleVector residuals;
+      double max_residual = 0.0;
+      unsigned iter = 0;
+      for (iter = 0; iter < Max_energy_minimisation_iterations; iter++)
+      {
+        // Gradient and convergence check
+        get_residuals(residuals);
+        max_residual = residuals.max();
+        double residual_norm = residuals.norm();
+        if (!Shut_up_in_newton_solve)
+        {
+          oomph_info << "Energy minimisation iteration " << iter
+                     << ": max. residual " << max_residual << std::endl;
+        }
+        if (max_residual < newton_solver_tolerance())
+        {
+          Element_hessian.clear();
+          actions_after_newton_solve();
+          return iter;
+        }
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          gradient[i] = residuals[i];
+        }
+
+        // Truncated CG step in the trust region
+        setup_element_hessians();
+        unsigned n_cg_iter = steihaug_cg_step(gradient, radius, step);
+        hessian_vector_product(step, hessian_step);
+        double predicted_reduction = 0.0;
+        double step_norm = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          predicted_reduction -=
+            step[i] * (gradient[i] + 0.5 * hessian_step[i]);
+          step_norm += step[i] * step[i];
+        }
+        step_norm = std::sqrt(step_norm);
+
+        // Actual change in energy (Simpson's rule along the step)
+        Vector<double> dofs_backup(n_dof);
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          dofs_backup[i] = dof(i);
+        }
+        double energy_change =
+          energy_change_along_step(dofs_backup, gradient, step);
+        double ratio = (predicted_reduction > 0.0) ?
+                         -energy_change / predicted_reduction :
+                         -1.0;
+
+        // Accept or reject the step and update the radius
+        bool accepted = (ratio > 0.1);
+        if (!accepted)
+        {
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            dof(i) = dofs_backup[i];
+          }
+        }
+        else
+        {
+          Nnewton_step++;
+        }
+
+        EnergyMinimisationRecord record;
+        record.Minimisation = Nenergy_minimisation;
+        record.Iteration = iter;
+        record.Residual_norm = residual_norm;
+        record.Energy_change = accepted ? energy_change : 0.0;
+        record.Trust_region_radius = radius;
+        record.Ncg_iter = n_cg_iter;
+        record.Accepted = accepted;
+        Energy_minimisation_history.push_back(record);
+
+        if (ratio < 0.25)
+        {
+          radius = 0.25 * step_norm;
+        }
+        else if ((ratio > 0.75) && (step_norm > 0.99 * radius))
+        {
+          radius = 2.0 * radius;
+        }
+        if (radius < 1.0e-14)
+        {
+          break;
+        }
+      }
+      Element_hessian.clear();
+      throw NewtonSolverError(iter, max_residual);
+    }
+
+    /// Document the iterations of the energy minimisation
+    void doc_energy_minimisation_history(std::ostream& outfile) const
+    {
+      outfile << "# minimisation iteration residual_norm energy_change "
+              << "trust_region_radius n_cg_iter accepted" << std::endl;
+      const unsigned n_record = Energy_minimisation_history.size();
+      for (unsigned i = 0; i < n_record; i++)
+      {
+        const EnergyMinimisationRecord& record =
+          Energy_minimisation_history[i];
+        outfile << record.Minimisation << " " << record.Iteration << " "
+                << record.Residual_norm << " " << record.Energy_change << " "
+                << record.Trust_region_radius << " " << record.Ncg_iter
+                << " " << record.Accepted << std::endl;
+      }
+    }
+
+
+    // Dynamic relaxation
+    //-------------------
+
+    /// Relax the dofs by dynamic relaxation until the max. residual is
+    /// below the tolerance or the max. number of steps has been taken.
+    /// Returns the number of steps taken.
+    unsigned dynamic_relaxation(const double& tolerance,
+                                const unsigned& max_step)
+    {
+      const unsigned long n_dof = ndof();
+      Vector<double> u(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        u[i] = dof(i);
+      }
+      Vector<double> velocity(n_dof, 0.0);
+      Vector<double> inverse_mass;
+      Vector<double> force;
+      double kinetic_energy = 0.0;
+      double max_residual = 0.0;
+      unsigned step = 0;
+      for (step = 0; step < max_step; step++)
+      {
+        // Update the lumped masses from time to time (the stiffness
+        // changes as the plate deforms)
+        if (step % Dynamic_relaxation_mass_update_interval == 0)
+        {
+          get_dynamic_relaxation_inverse_mass(inverse_mass);
+        }
+
+        // Out-of-balance forces
+        get_residuals_by_element_loop(force);
+        max_residual = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          force[i] = -force[i];
+          max_residual = std::max(max_residual, std::fabs(force[i]));
+        }
+        if (max_residual < tolerance)
+        {
+          break;
+        }
+
+        // Central difference step (half a step after a restart)
+        const double factor = (kinetic_energy == 0.0) ? 0.5 : 1.0;
+        double new_kinetic_energy = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          velocity[i] += factor * inverse_mass[i] * force[i];
+          new_kinetic_energy += velocity[i] * velocity[i] / inverse_mass[i];
+        }
+        new_kinetic_energy *= 0.5;
+
+        // Kinetic damping: if the kinetic energy has passed its peak, go
+        // back to the (estimated) position of the peak and restart from
+        // rest
+        if (new_kinetic_energy < kinetic_energy)
+        {
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            u[i] += -0.5 * velocity[i] + 0.5 * inverse_mass[i] * force[i];
+            velocity[i] = 0.0;
+          }
+          kinetic_energy = 0.0;
+          Nkinetic_energy_peak++;
+        }
+        else
+        {
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            u[i] += velocity[i];
+          }
+          kinetic_energy = new_kinetic_energy;
+        }
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          dof(i) = u[i];
+        }
+      }
+      oomph_info << "Dynamic relaxation: " << step << " steps; max. residual "
+                 << max_residual << std::endl;
+      return step;
+    }
+
+    /// Generate the initial guess for nonlinear_solve() by (at most)
+    /// n_step steps of dynamic relaxation (or until the max. residual is
+    /// below the tolerance)
+    void enable_dynamic_relaxation_initial_guess(const unsigned& n_step,
+                                                 const double& tolerance)
+    {
+      Ndynamic_relaxation_initial_guess_step = n_step;
+      Dynamic_relaxation_initial_guess_tolerance = tolerance;
+    }
+
+    /// Start nonlinear_solve() from the current dofs (default)
+    void disable_dynamic_relaxation_initial_guess()
+    {
+      Ndynamic_relaxation_initial_guess_step = 0;
+    }
+
+    /// Factor by which the lumped masses exceed the stability limit
+    /// (default 2)
+    double& dynamic_relaxation_mass_safety_factor()
+    {
+      return Dynamic_relaxation_mass_safety_factor;
+    }
+
+    /// Number of steps after which the lumped masses are updated
+    /// (default 100)
+    unsigned& dynamic_relaxation_mass_update_interval()
+    {
+      return Dynamic_relaxation_mass_update_interval;
+    }
+
+    /// Number of kinetic energy peaks (restarts) in the dynamic
+    /// relaxation so far
+    unsigned nkinetic_energy_peak() const
+    {
+      return Nkinetic_energy_peak;
+    }
+
+
+    // Implicit dynamics
+    //------------------
+
+    /// Time integration schemes for the implicit dynamics
+    enum TimeIntegrationScheme
+    {
+      Newmark_scheme,
+      BDF2_scheme
+    };
+
+    /// Record of an (accepted or rejected) time step
+    struct TimeStepRecord
+    {
+      /// Time at the end of the step
+      double Time;
+
+      /// Time step
+      double Dt;
+
+      /// Estimate of the (RMS) local truncation error
+      double Error;
+
+      /// Number of Newton iterations taken
+      unsigned Nnewton_iter;
+
+      /// Number of factorisations of the Jacobian
+      unsigned Nfactorisation;
+
+      /// Was the step accepted?
+      bool Accepted;
+    };
+
+    /// Add inertia: mass_per_unit_area times the accelerations of the
+    /// displacements, stored as the nodal values with the specified
+    /// indices, are added to the equations by a FvKInertiaAssemblyHandler
+    /// during the time steps. (Re-)starts the time integration from the
+    /// current state at rest at time zero.
+    void enable_dynamics(const double& mass_per_unit_area,
+                         const Vector<unsigned>& value_index)
+    {
+      delete Inertia_assembly_handler_pt;
+      Inertia_assembly_handler_pt =
+        new FvKInertiaAssemblyHandler(mass_per_unit_area, value_index);
+      Dynamic_time = 0.0;
+      initialise_dynamics();
+    }
+
+    /// Remove the inertia
+    void disable_dynamics()
+    {
+      delete Inertia_assembly_handler_pt;
+      Inertia_assembly_handler_pt = 0;
+    }
+
+    /// (Re-)start the time integration from the current dofs, at rest.
+    /// The initial accelerations follow from the equations of motion
+    /// (zero for the massless dofs).
+    void initialise_dynamics()
+    {
+      const unsigned long n_dof = ndof();
+      Dynamic_dofs.resize(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        Dynamic_dofs[i] = dof(i);
+      }
+      Dynamic_velocity.assign(n_dof, 0.0);
+      Dynamic_acceleration.assign(n_dof, 0.0);
+      Vector<double> mass;
+      Inertia_assembly_handler_pt->get_lumped_masses(mesh_pt(), n_dof, mass);
+      DoubleVector residuals;
+      get_residuals(residuals);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        if (mass[i] > 0.0)
+        {
+          Dynamic_acceleration[i] = -residuals[i] / mass[i];
+        }
+      }
+      Previous_dynamic_dofs.clear();
+      Previous_dynamic_velocity.clear();
+      Previous_dt = 0.0;
+      Factorised_acceleration_weight = -1.0;
+    }
+
+    /// Take a time step of size dt. Returns the estimate of the (RMS)
+    /// local truncation error; throws a NewtonSolverError if the Newton
+    /// iteration doesn't converge (the dofs are then reset).
+    double implicit_time_step(const double& dt)
+    {
+      TimeStepRecord record;
+      bool success = solve_time_step(dt, record);
+      Time_step_history.push_back(record);
+      if (!success)
+      {
+        throw NewtonSolverError(record.Nnewton_iter, DBL_MAX);
+      }
+      shift_dynamic_history(dt);
+      return record.Error;
+    }
+
+    /// Take a time step of size (at most) dt, cutting it back until the
+    /// estimate of the local truncation error is below epsilon. Returns
+    /// the suggested size of the next step. The time step is only
+    /// increased if it can grow by more than dt_increase_threshold() so
+    /// that the factorisation of the Jacobian can be reused as long as
+    /// possible.
+    double adaptive_implicit_time_step(const double& dt, const double& epsilon)
+    {
+      double actual_dt = dt;
+      while (true)
+      {
+        TimeStepRecord record;
+        bool success = solve_time_step(actual_dt, record);
+        if (success && (record.Error > epsilon))
+        {
+          record.Accepted = false;
+        }
+        Time_step_history.push_back(record);
+
+        // Optimal factor for the step size (second order accuracy)
+        double factor = Dt_cut_factor;
+        if (success)
+        {
+          factor = Max_dt_growth_factor;
+          if (record.Error > 0.0)
+          {
+            factor = std::min(
+              factor,
+              Dt_safety_factor * std::pow(epsilon / record.Error, 1.0 / 3.0));
+          }
+        }
+
+        // Accepted: Shift the history and suggest the next step
+        if (record.Accepted)
+        {
+          shift_dynamic_history(actual_dt);
+          if ((factor > 1.0) && (factor < Dt_increase_threshold))
+          {
+            factor = 1.0;
+          }
+          return factor * actual_dt;
+        }
+
+        // Rejected: Try again with a smaller step
+        oomph_info << "Time step from t = " << Dynamic_time << " with dt = "
+                   << actual_dt << " rejected; cutting back the step."
+                   << std::endl;
+        actual_dt *= std::max(std::min(factor, Dt_cut_factor), 0.1);
+        if (actual_dt < Min_dt)
+        {
+          std::ostringstream error_stream;
+          error_stream << "Time step from t = " << Dynamic_time
+                       << " failed with steps down to " << actual_dt
+                       << std::endl;
+          throw OomphLibError(error_stream.str(),
+                              OOMPH_CURRENT_FUNCTION,
+                              OOMPH_EXCEPTION_LOCATION);
+        }
+      }
+    }
+
+    /// Document the history of accepted and rejected time steps
+    void doc_time_step_history(std::ostream& outfile) const
+    {
+      outfile << "# time dt error n_newton_iter n_factorisation accepted"
+              << std::endl;
+      const unsigned n_step = Time_step_history.size();
+      for (unsigned i = 0; i < n_step; i++)
+      {
+        outfile << Time_step_history[i].Time << " "
+                << Time_step_history[i].Dt << " "
+                << Time_step_history[i].Error << " "
+                << Time_step_history[i].Nnewton_iter << " "
+                << Time_step_history[i].Nfactorisation << " "
+                << Time_step_history[i].Accepted << std::endl;
+      }
+    }
+
+    /// Current time
+    double& dynamic_time()
+    {
+      return Dynamic_time;
+    }
+
+    /// Time integration scheme (Newmark's trapezoidal rule by default)
+    TimeIntegrationScheme& time_integration_scheme()
+    {
+      return Time_integration_scheme;
+    }
+
+    /// Safety factor applied to the optimal time step (default 0.9)
+    double& dt_safety_factor()
+    {
+      return Dt_safety_factor;
+    }
+
+    /// Max. factor by which the time step grows between steps (default 2)
+    double& max_dt_growth_factor()
+    {
+      return Max_dt_growth_factor;
+    }
+
+    /// The time step is only increased if it can grow by more than this
+    /// factor (default 1.5)
+    double& dt_increase_threshold()
+    {
+      return Dt_increase_threshold;
+    }
+
+    /// Factor by which the time step is cut after a failed Newton
+    /// iteration (default 0.5)
+    double& dt_cut_factor()
+    {
+      return Dt_cut_factor;
+    }
+
+    /// Min. time step before we give up
+    double& min_dt()
+    {
+      return Min_dt;
+    }
+
+    /// The factorisation of the Jacobian from a previous Newton iteration
+    /// (or time step with the same dt) is reused until the max. residual
+    /// reduces by less than this factor per iteration (default 0.5)
+    double& max_modified_newton_contraction()
+    {
+      return Max_modified_newton_contraction;
+    }
+
+
+    // Ensemble Newton
+    //----------------
+
+    /// Set the boundary conditions (pinned values) for the current values
+    /// of the parameters. Called for each member of an ensemble Newton
+    /// solve, which only calls actions_before_newton_solve() once; empty
+    /// by default.
+    virtual void apply_parameter_dependent_boundary_conditions() {}
+
+    /// Solve the problem simultaneously for an ensemble of parameter
+    /// values: for ensemble member k the global parameters pointed to by
+    /// parameter_pt[p] take the values parameter_value[k][p]. The
+    /// initial guesses are member_dofs[k] (the current dofs for all
+    /// members if member_dofs doesn't have the right size); on return
+    /// member_dofs[k] contains the solutions. Returns the number of
+    /// Newton iterations for the slowest member; throws a
+    /// NewtonSolverError if any member doesn't converge. The parameters,
+    /// nodal values and dofs are reset afterwards.
+    unsigned ensemble_newton_solve(
+      const Vector<double*>& parameter_pt,
+      const Vector<Vector<double>>& parameter_value,
+      Vector<Vector<double>>& member_dofs)
+    {
+      const unsigned n_member = parameter_value.size();
+      const unsigned n_parameter = parameter_pt.size();
+      const unsigned long n_dof = ndof();
+
+      // Backup the current state
+      Vector<double> parameter_backup(n_parameter);
+      for (unsigned p = 0; p < n_parameter; p++)
+      {
+        parameter_backup[p] = *parameter_pt[p];
+      }
+      Vector<double> nodal_value_backup;
+      get_nodal_values(nodal_value_backup);
+      Vector<double> dofs_backup(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        dofs_backup[i] = dof(i);
+      }
+      if (member_dofs.size() != n_member)
+      {
+        member_dofs.assign(n_member, dofs_backup);
+      }
+
+      // One (ensemble) Newton solve
+      actions_before_newton_solve();
+
+      // Nodal values (in particular the pinned values set by the
+      // boundary conditions) for each member
+      Vector<Vector<double>> member_nodal_values(n_member);
+      for (unsigned k = 0; k < n_member; k++)
+      {
+        for (unsigned p = 0; p < n_parameter; p++)
+        {
+          *parameter_pt[p] = parameter_value[k][p];
+        }
+        apply_parameter_dependent_boundary_conditions();
+        get_nodal_values(member_nodal_values[k]);
+      }
+      Mesh* el_mesh_pt = mesh_pt();
+      std::map<Node*, unsigned long> nodal_value_offset;
+      const unsigned long n_node = el_mesh_pt->nnode();
+      unsigned long offset = 0;
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = el_mesh_pt->node_pt(j);
+        nodal_value_offset[nod_pt] = offset;
+        offset += nod_pt->nvalue();
+      }
+
+      // Share the symbolic analysis with the linear solver if possible
+      SkylineStructure* structure_pt = 0;
+      SymmetricLDLTSolver* ldlt_solver_pt =
+        dynamic_cast<SymmetricLDLTSolver*>(linear_solver_pt());
+      if ((ldlt_solver_pt != 0) && (ldlt_solver_pt->structure_pt() != 0) &&
+          (ldlt_solver_pt->structure_pt()->ndof() == n_dof))
+      {
+        structure_pt = ldlt_solver_pt->structure_pt();
+      }
+      else
+      {
+        build_ensemble_structure();
+        structure_pt = &Ensemble_structure;
+      }
+
+      // Newton iteration for all members that haven't converged yet
+      AssemblyHandler* handler_pt = assembly_handler_pt();
+      const unsigned long n_element = el_mesh_pt->nelement();
+      Ensemble_nnewton_iter.assign(n_member, 0);
+      Vector<unsigned> active_member(n_member);
+      for (unsigned k = 0; k < n_member; k++)
+      {
+        active_member[k] = k;
+      }
+      EnsembleLDLTSolver ensemble_solver;
+      Vector<Vector<double>> residuals;
+      Vector<unsigned long> eqn;
+      Vector<unsigned long> new_eqn;
+      Vector<double> el_residuals;
+      DenseMatrix<double> el_jacobian;
+      double max_residual = 0.0;
+      unsigned iter = 0;
+      for (iter = 0; !active_member.empty(); iter++)
+      {
+        // Assemble the residuals and Jacobians of all active members in
+        // one pass over the elements
+        const unsigned n_active = active_member.size();
+        ensemble_solver.setup(structure_pt, n_active);
+        residuals.assign(n_active, Vector<double>(n_dof, 0.0));
+        for (unsigned long e = 0; e < n_element; e++)
+        {
+          GeneralisedElement* el_pt = el_mesh_pt->element_pt(e);
+          const unsigned n_el_dof = handler_pt->ndof(el_pt);
+          eqn.resize(n_el_dof);
+          new_eqn.resize(n_el_dof);
+          for (unsigned i = 0; i < n_el_dof; i++)
+          {
+            eqn[i] = handler_pt->eqn_number(el_pt, i);
+            new_eqn[i] = structure_pt->perm(eqn[i]);
+          }
+          FiniteElement* fe_pt = dynamic_cast<FiniteElement*>(el_pt);
+          const unsigned n_el_node = (fe_pt == 0) ? 0 : fe_pt->nnode();
+          el_residuals.resize(n_el_dof);
+          el_jacobian.resize(n_el_dof, n_el_dof);
+          for (unsigned a = 0; a < n_active; a++)
+          {
+            // Make the element see member k's parameters, boundary
+            // conditions and dofs
+            const unsigned k = active_member[a];
+            for (unsigned p = 0; p < n_parameter; p++)
+            {
+              *parameter_pt[p] = parameter_value[k][p];
+            }
+            for (unsigned l = 0; l < n_el_node; l++)
+            {
+              Node* nod_pt = fe_pt->node_pt(l);
+              const unsigned long node_offset = nodal_value_offset[nod_pt];
+              const unsigned n_value = nod_pt->nvalue();
+              for (unsigned v = 0; v < n_value; v++)
+              {
+                if (nod_pt->is_pinned(v))
+                {
+                  nod_pt->set_value(
+                    v, member_nodal_values[k][node_offset + v]);
+                }
+              }
+            }
+            for (unsigned i = 0; i < n_el_dof; i++)
+            {
+              *(el_pt->dof_pt(i)) = member_dofs[k][eqn[i]];
+            }
+
+            handler_pt->get_jacobian(el_pt, el_residuals, el_jacobian);
+            for (unsigned i = 0; i < n_el_dof; i++)
+            {
+              residuals[a][eqn[i]] += el_residuals[i];
+              for (unsigned j = 0; j < n_el_dof; j++)
+              {
+                if (new_eqn[i] <= new_eqn[j])
+                {
+                  ensemble_solver.entry(new_eqn[i], new_eqn[j], a) +=
+                    el_jacobian(i, j);
+                }
+              }
+            }
+          }
+        }
+
+        // Convergence check
+        Vector<unsigned> unconverged;
+        max_residual = 0.0;
+        for (unsigned a = 0; a < n_active; a++)
+        {
+          double member_max_residual = 0.0;
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            member_max_residual =
+              std::max(member_max_residual, std::fabs(residuals[a][i]));
+          }
+          if (member_max_residual < newton_solver_tolerance())
+          {
+            Ensemble_nnewton_iter[active_member[a]] = iter;
+          }
+          else
+          {
+            unconverged.push_back(a);
+            max_residual = std::max(max_residual, member_max_residual);
+          }
+        }
+        if (!Shut_up_in_newton_solve)
+        {
+          oomph_info << "Ensemble Newton iteration " << iter << ": "
+                     << unconverged.size() << " of " << n_member
+                     << " members not converged; max. residual "
+                     << max_residual << std::endl;
+        }
+        if (unconverged.empty())
+        {
+          break;
+        }
+        if ((iter == max_newton_iterations()) ||
+            (max_residual > max_residuals()))
+        {
+          restore_state_after_ensemble_newton_solve(
+            parameter_pt, parameter_backup, nodal_value_backup, dofs_backup);
+          throw NewtonSolverError(iter, max_residual);
+        }
+
+        // Factorise and update the members that haven't converged
+        ensemble_solver.factorise();
+        ensemble_solver.solve(residuals);
+        Vector<unsigned> new_active_member(unconverged.size());
+        for (unsigned b = 0; b < unconverged.size(); b++)
+        {
+          const unsigned a = unconverged[b];
+          const unsigned k = active_member[a];
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            member_dofs[k][i] -= residuals[a][i];
+          }
+          new_active_member[b] = k;
+        }
+        active_member = new_active_member;
+      }
+
+      restore_state_after_ensemble_newton_solve(
+        parameter_pt, parameter_backup, nodal_value_backup, dofs_backup);
+      return iter;
+    }
+
+    /// Number of Newton iterations taken by ensemble member k in the
+    /// most recent ensemble_newton_solve(...)
+    unsigned ensemble_nnewton_iter(const unsigned& k) const
+    {
+      return Ensemble_nnewton_iter[k];
+    }
+
+
+    // Parameters
+    //-----------
+
+    /// Make the problem's own parameters the context for the
+    /// (context-free) load functions that its elements call; empty by
+    /// default. See enable_parameter_context_assembly().
+    virtual void make_parameters_current() {}
+
+    /// Assemble the equations with a FvKParameterContextAssemblyHandler,
+    /// which calls make_parameters_current() for each element
+    void enable_parameter_context_assembly()
+    {
+      if (Parameter_context_assembly_handler_pt == 0)
+      {
+        Replaced_assembly_handler_pt = assembly_handler_pt();
+        Parameter_context_assembly_handler_pt =
+          new FvKParameterContextAssemblyHandler(this);
+        assembly_handler_pt() = Parameter_context_assembly_handler_pt;
+      }
+    }
+
+    /// Register a (double) parameter owned by this problem under the
+    /// specified name (with or without the leading "--"), e.g. that of
+    /// the command line flag that specifies its default value
+    void register_parameter(const std::string& name, double* const& value_pt)
+    {
+      Registered_parameter_pt[flag_name(name)] = value_pt;
+    }
+
+    /// Pointer to the parameter with the specified name (with or without
+    /// the leading "--"): one registered with register_parameter(...) or,
+    /// failing that, a double registered with CommandLineArgs under that
+    /// flag
+    double* parameter_pt(const std::string& name)
+    {
+      const std::string full_name = flag_name(name);
+      std::map<std::string, double*>::iterator registered_it =
+        Registered_parameter_pt.find(full_name);
+      if (registered_it != Registered_parameter_pt.end())
+      {
+        return registered_it->second;
+      }
+      std::map<std::string, CommandLineArgs::ArgInfo<double>>::iterator it =
+        CommandLineArgs::Specified_command_line_double_pt.find(full_name);
+      if (it == CommandLineArgs::Specified_command_line_double_pt.end())
+      {
+        std::ostringstream error_stream;
+        error_stream << "No parameter registered under the name " << full_name
+                     << std::endl;
+        throw OomphLibError(error_stream.str(),
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+      return it->second.arg_pt;
+    }
+
+
+    // Homotopy
+    //---------
+
+    /// Ramp the global parameter pointed to by parameter_pt from
+    /// start_value (where we solve first) to target_value by
+    /// adaptive_load_step(...)s, starting with the specified increment;
+    /// each solve is warm-started from the previous solutions. If both
+    /// values are positive the parameter is stepped in its logarithm (and
+    /// the increment refers to that), so parameters that span orders of
+    /// magnitude (such as Eta) are ramped geometrically.
+    void homotopy_solve(double* const& parameter_pt,
+                        const double& start_value,
+                        const double& target_value,
+                        const double& initial_increment)
+    {
+      *parameter_pt = start_value;
+      nonlinear_solve();
+      reset_load_step_predictor();
+      if ((start_value <= 0.0) || (target_value <= 0.0))
+      {
+        adaptive_load_step_to(parameter_pt, target_value, initial_increment);
+        return;
+      }
+
+      // Step in the logarithm (which is copied into the parameter
+      // whenever the residuals are evaluated)
+      Log_homotopy_parameter_pt = parameter_pt;
+      Log_homotopy_parameter = std::log(start_value);
+      try
+      {
+        adaptive_load_step_to(&Log_homotopy_parameter,
+                              std::log(target_value),
+                              initial_increment);
+      }
+      catch (...)
+      {
+        Log_homotopy_parameter_pt = 0;
+        reset_load_step_predictor();
+        throw;
+      }
+      Log_homotopy_parameter_pt = 0;
+      reset_load_step_predictor();
+      *parameter_pt = target_value;
+    }
+
+    /// Ramp the parameter with the specified name (see parameter_pt(...))
+    /// from start_value to the value it has now (e.g. as specified on the
+    /// command line); see homotopy_solve(...) above.
+    void homotopy_solve(const std::string& name,
+                        const double& start_value,
+                        const double& initial_increment)
+    {
+      double* parameter_pt = this->parameter_pt(name);
+      const double target_value = *parameter_pt;
+      homotopy_solve(parameter_pt, start_value, target_value,
+                     initial_increment);
+    }
+
+  protected:
+    /// Get the derivative of the (converged) solution w.r.t. the global
+    /// parameter pointed to by parameter_pt from the linearised
+    /// residuals, J du/dp = - dR/dp; dR/dp is obtained by finite
+    /// differencing. The Jacobian is factorised via the problem (so this
+    /// works with every linear solver, including those that can't solve
+    /// with a given matrix) and the derivative is obtained by
+    /// back-substitution. The constrained dofs don't change with the
+    /// parameter, so their rows of dR/dp are zero and the derivative is
+    /// corrected for the constraints as in
+    /// apply_constraints_to_newton_step().
+    void get_dofs_derivative_wrt_parameter(double* const& parameter_pt,
+                                           Vector<double>& dofs_deriv)
+    {
+      // Factorise the Jacobian at the current state and keep the
+      // factors for the back-substitution below
+      bool resolve_was_enabled = linear_solver_pt()->is_resolve_enabled();
+      linear_solver_pt()->enable_resolve();
+      DoubleVector dx;
+      linear_solver_pt()->solve(this, dx);
+      Sign_of_unconstrained_jacobian_is_current = false;
+
+      // Finite difference the residuals w.r.t. the parameter
+      DoubleVector residuals;
+      get_residuals(residuals);
+      const double backup = *parameter_pt;
+      const double fd_step = 1.0e-8 * std::max(1.0, std::fabs(backup));
+      *parameter_pt += fd_step;
+      DoubleVector dresiduals_dparameter;
+      get_residuals(dresiduals_dparameter);
+      *parameter_pt = backup;
+      update_log_homotopy_parameter();
+      const unsigned n_row = residuals.nrow_local();
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        dresiduals_dparameter[i] =
+          -(dresiduals_dparameter[i] - residuals[i]) / fd_step;
+      }
+      const unsigned n_constraint = Constrained_dof_eqn.size();
+      for (unsigned c = 0; c < n_constraint; c++)
+      {
+        dresiduals_dparameter[Constrained_dof_eqn[c]] = 0.0;
+      }
+
+      // Solve
+      DoubleVector deriv;
+      linear_solver_pt()->resolve(dresiduals_dparameter, deriv);
+      dofs_deriv.resize(n_row);
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        dofs_deriv[i] = deriv[i];
+      }
+
+      // Keep the constrained dofs fixed: du/dp -> du/dp - Y lambda with
+      // S lambda = C^T du/dp
+      if (n_constraint > 0)
+      {
+        setup_constraint_responses();
+        Vector<double> lambda(n_constraint);
+        for (unsigned c = 0; c < n_constraint; c++)
+        {
+          lambda[c] = dofs_deriv[Constrained_dof_eqn[c]];
+        }
+        lu_back_substitute(Schur_complement, Schur_complement_pivot, lambda);
+        for (unsigned c = 0; c < n_constraint; c++)
+        {
+          for (unsigned i = 0; i < n_row; i++)
+          {
+            dofs_deriv[i] -= lambda[c] * Constraint_response[c][i];
+          }
+        }
+      }
+
+      // Done with the factorisation
+      if (!resolve_was_enabled)
+      {
+        linear_solver_pt()->disable_resolve();
+      }
+    }
+
+
+    /// Dot product of two vectors
+    static double dot_product(const Vector<double>& a, const Vector<double>& b)
+    {
+      double sum = 0.0;
+      const unsigned n = a.size();
+      for (unsigned i = 0; i < n; i++)
+      {
+        sum += a[i] * b[i];
+      }
+      return sum;
+    }
+
+    /// Scale vector to unit (Euclidean) norm
+    static void scale_to_unit_norm(Vector<double>& a)
+    {
+      double norm = std::sqrt(dot_product(a, a));
+      if (norm > 0.0)
+      {
+        const unsigned n = a.size();
+        for (unsigned i = 0; i < n; i++)
+        {
+          a[i] /= norm;
+        }
+      }
+    }
+
+    /// Rayleigh quotient phi^T J phi (for unit phi) of the Jacobian at
+    /// the state specified by dofs (which must be the current dofs, with
+    /// corresponding residuals), with the Jacobian-vector product
+    /// obtained by finite differencing the residuals.
+    double rayleigh_quotient(const Vector<double>& phi,
+                             const Vector<double>& dofs,
+                             const DoubleVector& residuals)
+    {
+      const unsigned n_row = phi.size();
+      const double fd_step = 1.0e-7;
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        dof(i) = dofs[i] + fd_step * phi[i];
+      }
+      DoubleVector perturbed_residuals;
+      get_residuals(perturbed_residuals);
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        dof(i) = dofs[i];
+      }
+      double sum = 0.0;
+      for (unsigned i = 0; i < n_row; i++)
+      {
+        sum += phi[i] * (perturbed_residuals[i] - residuals[i]) / fd_step;
+      }
+      return sum;
+    }
+
+    /// Eigen-decomposition of the (small, dense) symmetric matrix a by
+    /// cyclic Jacobi rotations. On return, eigenvector(i,j) is the i-th
+    /// component of the j-th eigenvector. The matrix a is destroyed.
+    static void symmetric_eigen_decomposition(DenseMatrix<double>& a,
+                                              Vector<double>& eigenvalue,
+                                              DenseMatrix<double>& eigenvector)
+    {
+      const unsigned n = a.nrow();
+      eigenvector.resize(n, n, 0.0);
+      for (unsigned i = 0; i < n; i++)
+      {
+        eigenvector(i, i) = 1.0;
+      }
+
+      const unsigned max_sweep = 100;
+      for (unsigned sweep = 0; sweep < max_sweep; sweep++)
+      {
+        // Converged if the off-diagonal entries are negligible
+        double off_diag = 0.0;
+        double diag = 0.0;
+        for (unsigned i = 0; i < n; i++)
+        {
+          diag += a(i, i) * a(i, i);
+          for (unsigned j = i + 1; j < n; j++)
+          {
+            off_diag += a(i, j) * a(i, j);
+          }
+        }
+        if (off_diag <= 1.0e-30 * diag)
+        {
+          break;
+        }
+
+        // Sweep over all off-diagonal entries
+        for (unsigned p = 0; p < n; p++)
+        {
+          for (unsigned q = p + 1; q < n; q++)
+          {
+            if (a(p, q) == 0.0)
+            {
+              continue;
+            }
+            double theta = (a(q, q) - a(p, p)) / (2.0 * a(p, q));
+            double t = ((theta >= 0.0) ? 1.0 : -1.0) /
+                       (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+            double c = 1.0 / std::sqrt(t * t + 1.0);
+            double sn = t * c;
+            for (unsigned k = 0; k < n; k++)
+            {
+              double akp = a(k, p);
+              double akq = a(k, q);
+              a(k, p) = c * akp - sn * akq;
+              a(k, q) = sn * akp + c * akq;
+            }
+            for (unsigned k = 0; k < n; k++)
+            {
+              double apk = a(p, k);
+              double aqk = a(q, k);
+              a(p, k) = c * apk - sn * aqk;
+              a(q, k) = sn * apk + c * aqk;
+            }
+            for (unsigned k = 0; k < n; k++)
+            {
+              double vkp = eigenvector(k, p);
+              double vkq = eigenvector(k, q);
+              eigenvector(k, p) = c * vkp - sn * vkq;
+              eigenvector(k, q) = sn * vkp + c * vkq;
+            }
+          }
+        }
+      }
+
+      eigenvalue.resize(n);
+      for (unsigned i = 0; i < n; i++)
+      {
+        eigenvalue[i] = a(i, i);
+      }
+    }
+
+    /// Rescale the most recent Newton step, delta = u - u_k, to the
+    /// deflated Newton step tau delta, where
+    /// tau = 1 / (1 - grad(M).delta / M), evaluated at u_k.
+    void apply_deflation_to_newton_step()
+    {
+      const unsigned long n_dof = ndof();
+      if (Dofs_before_newton_step.size() != n_dof)
+      {
+        return;
+      }
+
+      // grad(M).delta / M = sum_j grad(ln M_j).delta
+      double grad_ln_m_dot_delta = 0.0;
+      const unsigned n_solution = Deflation_solution.size();
+      for (unsigned j = 0; j < n_solution; j++)
+      {
+        double dist_squared = 0.0;
+        double e_dot_delta = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          double e = Dofs_before_newton_step[i] - Deflation_solution[j][i];
+          dist_squared += e * e;
+          e_dot_delta += e * (dof(i) - Dofs_before_newton_step[i]);
+        }
+        if (dist_squared == 0.0)
+        {
+          continue;
+        }
+        double dist_to_minus_p = std::pow(dist_squared, -0.5 * Deflation_power);
+        grad_ln_m_dot_delta -=
+          Deflation_power * dist_to_minus_p * e_dot_delta /
+          (dist_squared * (dist_to_minus_p + Deflation_shift));
+      }
+
+      // Rescale (if the deflated step is well defined)
+      double denominator = 1.0 - grad_ln_m_dot_delta;
+      if (denominator > 0.0)
+      {
+        double tau = 1.0 / denominator;
+        Deflation_step_scaling_factor = tau;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          dof(i) = Dofs_before_newton_step[i] +
+                   tau * (dof(i) - Dofs_before_newton_step[i]);
+        }
+      }
+    }
+
+    /// Norm of the residual vector for the current dofs
+    double residual_norm_for_globalisation()
+    {
+      Nresidual_evaluation_in_globalisation++;
+      DoubleVector residuals;
+      get_residuals(residuals);
+      return residuals.norm();
+    }
+
+    /// Set the dofs to u_old + lambda (u_full - u_old), where u_old are
+    /// the dofs before the Newton step and the full step is contained in
+    /// full_step
+    void set_damped_newton_step(const Vector<double>& full_step,
+                                const double& lambda)
+    {
+      const unsigned long n_dof = ndof();
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        dof(i) = Dofs_before_newton_step[i] + lambda * full_step[i];
+      }
+    }
+
+    /// Get the step just taken by the Newton solver
+    void get_newton_step(Vector<double>& step)
+    {
+      const unsigned long n_dof = ndof();
+      step.resize(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        step[i] = dof(i) - Dofs_before_newton_step[i];
+      }
+    }
+
+    /// Backtracking line search on the merit function f = |R|^2/2 along
+    /// the Newton step. An exact Newton step is a descent direction with
+    /// df/dlambda = -2 f(0); for the deflated step tau delta the slope is
+    /// scaled by tau, and for an inexact solve with forcing term eta it's
+    /// (at most) -2 (1-eta) f(0). The step corrected for the constraints
+    /// isn't a Newton step for all of R, so its slope is obtained by
+    /// finite differences. The search is skipped if the step isn't a
+    /// descent direction. The first reduction uses quadratic, the
+    /// subsequent ones cubic interpolation, safeguarded to reduce lambda
+    /// by a factor between 2 and 10 per backtracking step.
+    void apply_line_search_to_newton_step()
+    {
+      if (Dofs_before_newton_step.size() != ndof())
+      {
+        return;
+      }
+
+      double f_0 = 0.5 * Residual_norm_before_newton_step *
+                   Residual_norm_before_newton_step;
+      if (f_0 == 0.0)
+      {
+        return;
+      }
+
+      Vector<double> full_step;
+      get_newton_step(full_step);
+
+      // Slope of the merit function along the step
+      double slope = -2.0 * Deflation_step_scaling_factor * f_0;
+      if (Eisenstat_walker_forcing_is_enabled)
+      {
+        slope *= 1.0 - Forcing_term;
+      }
+      if (!Constrained_dof_eqn.empty())
+      {
+        const double fd_lambda = 1.0e-7;
+        set_damped_newton_step(full_step, fd_lambda);
+        double residual_norm = residual_norm_for_globalisation();
+        slope = (0.5 * residual_norm * residual_norm - f_0) / fd_lambda;
+        set_damped_newton_step(full_step, 1.0);
+      }
+      if (!(slope < 0.0))
+      {
+        oomph_info << "Line search: Newton step " << Nnewton_step
+                   << " isn't a descent direction; taking the full step"
+                   << std::endl;
+        return;
+      }
+
+      double lambda = 1.0;
+      double lambda_prev = 1.0;
+      double f_prev = f_0;
+      bool damped = false;
+      while (true)
+      {
+        double residual_norm = residual_norm_for_globalisation();
+        double f = 0.5 * residual_norm * residual_norm;
+
+        // Sufficient decrease (NaNs fail this test)
+        if (f <= f_0 + Armijo_parameter * lambda * slope)
+        {
+          break;
+        }
+
+        // Give up and accept the step
+        if (lambda <= Min_newton_step_length)
+        {
+          oomph_info << "Line search: accepting step of length " << lambda
+                     << " without sufficient decrease" << std::endl;
+          break;
+        }
+
+        // Backtrack
+        double lambda_new = 0.0;
+        if (!std::isfinite(f))
+        {
+          lambda_new = 0.1 * lambda;
+        }
+        else if (!damped)
+        {
+          // Minimise the quadratic through f(0), f'(0) and f(1)
+          lambda_new = -slope / (2.0 * (f - f_0 - slope));
+        }
+        else
+        {
+          // Minimise the cubic through f(0), f'(0) and the last two
+          // values
+          double rhs_1 = f - f_0 - lambda * slope;
+          double rhs_2 = f_prev - f_0 - lambda_prev * slope;
+          double a = (rhs_1 / (lambda * lambda) -
+                      rhs_2 / (lambda_prev * lambda_prev)) /
+                     (lambda - lambda_prev);
+          double b = (-lambda_prev * rhs_1 / (lambda * lambda) +
+                      lambda * rhs_2 / (lambda_prev * lambda_prev)) /
+                     (lambda - lambda_prev);
+          if (a == 0.0)
+          {
+            lambda_new = -slope / (2.0 * b);
+          }
+          else
+          {
+            double discriminant = b * b - 3.0 * a * slope;
+            if (discriminant < 0.0)
+            {
+              lambda_new = 0.5 * lambda;
+            }
+            else if (b <= 0.0)
+            {
+              lambda_new = (-b + std::sqrt(discriminant)) / (3.0 * a);
+            }
+            else
+            {
+              lambda_new = -slope / (b + std::sqrt(discriminant));
+            }
+          }
+        }
+        lambda_new = std::min(lambda_new, 0.5 * lambda);
+        lambda_new = std::max(lambda_new, 0.1 * lambda);
+
+        lambda_prev = lambda;
+        f_prev = f;
+        lambda = lambda_new;
+        damped = true;
+        set_damped_newton_step(full_step, lambda);
+      }
+
+      if (damped)
+      {
+        Ndamped_newton_step++;
+        oomph_info << "Line search: damped Newton step " << Nnewton_step
+                   << " by factor " << lambda << std::endl;
+      }
+    }
+
+    /// Restrict the Newton step to the trust region and update the
+    /// radius based on the ratio of the actual to the predicted reduction
+    /// in the merit function f = |R|^2/2. Steps that don't reduce f are
+    /// rejected and retried with a smaller radius.
+    void apply_trust_region_to_newton_step()
+    {
+      if (Dofs_before_newton_step.size() != ndof())
+      {
+        return;
+      }
+
+      // Reset the radius at the start of each solve
+      if (Nnewton_step == 1)
+      {
+        Trust_region_radius = Initial_trust_region_radius;
+      }
+
+      double f_0 = 0.5 * Residual_norm_before_newton_step *
+                   Residual_norm_before_newton_step;
+      if (f_0 == 0.0)
+      {
+        return;
+      }
+
+      Vector<double> full_step;
+      get_newton_step(full_step);
+      double full_step_norm = std::sqrt(dot_product(full_step, full_step));
+      if (full_step_norm == 0.0)
+      {
+        return;
+      }
+
+      bool damped = false;
+      while (true)
+      {
+        // Fraction of the Newton step that fits into the trust region
+        double lambda = std::min(1.0, Trust_region_radius / full_step_norm);
+        if (lambda < 1.0)
+        {
+          damped = true;
+        }
+        set_damped_newton_step(full_step, lambda);
+
+        // Actual vs predicted reduction: For the linear model the
+        // residual is (1-lambda) R
+        double residual_norm = residual_norm_for_globalisation();
+        double f = 0.5 * residual_norm * residual_norm;
+        double predicted_reduction =
+          f_0 * (1.0 - (1.0 - lambda) * (1.0 - lambda));
+        double ratio = (f_0 - f) / predicted_reduction;
+
+        // Update the radius (NaNs end up in the first branch)
+        double step_norm = lambda * full_step_norm;
+        if (!(ratio >= 0.25))
+        {
+          Trust_region_radius = 0.25 * step_norm;
+        }
+        else if ((ratio > 0.75) && (lambda < 1.0))
+        {
+          Trust_region_radius = 2.0 * step_norm;
+        }
+
+        // Accept?
+        if (ratio > 0.0)
+        {
+          break;
+        }
+        if (lambda <= Min_newton_step_length ||
+            Trust_region_radius < Min_trust_region_radius)
+        {
+          oomph_info << "Trust region: accepting step of length " << lambda
+                     << " without decrease in the residual" << std::endl;
+          break;
+        }
+        damped = true;
+      }
+
+      if (damped)
+      {
+        Ndamped_newton_step++;
+        oomph_info << "Trust region: restricted Newton step " << Nnewton_step
+                   << " to radius " << Trust_region_radius << std::endl;
+      }
+    }
+
+    /// Solve the (linear) in-plane equations for the in-plane
+    /// displacements with the out-of-plane dofs held fixed: Assemble the
+    /// in-plane residuals, solve for the correction with the factorised
+    /// in-plane block of the Jacobian (refactorised if necessary) and
+    /// update the in-plane dofs.
+    void eliminate_in_plane_displacements()
+    {
+      // Get the (free) in-plane dofs. Done at every step since the pinned
+      // status may have changed since the last solve
+      const unsigned long n_dof = ndof();
+      Vector<long> in_plane_index(n_dof, -1);
+      Vector<unsigned long> in_plane_eqn;
+      const unsigned long n_node = In_plane_elimination_mesh_pt->nnode();
+      const unsigned n_index = In_plane_value_index.size();
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = In_plane_elimination_mesh_pt->node_pt(j);
+        for (unsigned k = 0; k < n_index; k++)
+        {
+          if (In_plane_value_index[k] >= nod_pt->nvalue())
+          {
+            continue;
+          }
+          long eqn = nod_pt->eqn_number(In_plane_value_index[k]);
+          if ((eqn >= 0) && (in_plane_index[eqn] < 0))
+          {
+            in_plane_index[eqn] = in_plane_eqn.size();
+            in_plane_eqn.push_back(eqn);
+          }
+        }
+      }
+      const unsigned n_in_plane = in_plane_eqn.size();
+      if (n_in_plane == 0)
+      {
+        return;
+      }
+
+      // Refactorise the in-plane block if the in-plane equation numbers
+      // or the parameters it depends on have changed
+      bool refactorise = (!In_plane_factorisation_is_current) ||
+                         (in_plane_eqn != In_plane_eqn);
+      const unsigned n_parameter = In_plane_stiffness_parameter_pt.size();
+      for (unsigned p = 0; p < n_parameter; p++)
+      {
+        if (*In_plane_stiffness_parameter_pt[p] !=
+            In_plane_stiffness_parameter_value[p])
+        {
+          refactorise = true;
+        }
+      }
+      if (refactorise)
+      {
+        factorise_in_plane_block(in_plane_eqn, in_plane_index);
+      }
+
+      // Assemble the in-plane residuals only
+      DoubleVector rhs(In_plane_distribution_pt, 0.0);
+      Mesh* const global_mesh_pt = mesh_pt();
+      AssemblyHandler* const handler_pt = assembly_handler_pt();
+      const unsigned long n_element = global_mesh_pt->nelement();
+      Vector<double> el_residuals;
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = global_mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        el_residuals.resize(n_el_dof);
+        handler_pt->get_residuals(el_pt, el_residuals);
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          long block_row = in_plane_index[handler_pt->eqn_number(el_pt, i)];
+          if (block_row >= 0)
+          {
+            rhs[block_row] -= el_residuals[i];
+          }
+        }
+      }
+
+      // Solve and update
+      DoubleVector correction;
+      In_plane_linear_solver_pt->resolve(rhs, correction);
+      for (unsigned i = 0; i < n_in_plane; i++)
+      {
+        dof(in_plane_eqn[i]) += correction[i];
+      }
+      Nin_plane_elimination++;
+    }
+
+    /// Extract the in-plane block (with the specified equation numbers;
+    /// in_plane_index[eqn] is the index of the dof in the block, or -1)
+    /// from the Jacobian and factorise it, keeping the factors for the
+    /// back-substitutions in eliminate_in_plane_displacements()
+    void factorise_in_plane_block(const Vector<unsigned long>& in_plane_eqn,
+                                  const Vector<long>& in_plane_index)
+    {
+      DoubleVector residuals;
+      CRDoubleMatrix jacobian;
+      get_jacobian(residuals, jacobian);
+      const double* value_pt = jacobian.value();
+      const int* column_index_pt = jacobian.column_index();
+      const int* row_start_pt = jacobian.row_start();
+      const unsigned n_in_plane = in_plane_eqn.size();
+      Vector<double> block_value;
+      Vector<int> block_column_index;
+      Vector<int> block_row_start(n_in_plane + 1, 0);
+      for (unsigned i = 0; i < n_in_plane; i++)
+      {
+        unsigned long row = in_plane_eqn[i];
+        for (int k = row_start_pt[row]; k < row_start_pt[row + 1]; k++)
+        {
+          long block_column = in_plane_index[column_index_pt[k]];
+          if (block_column >= 0)
+          {
+            block_value.push_back(value_pt[k]);
+            block_column_index.push_back(block_column);
+          }
+        }
+        block_row_start[i + 1] = block_value.size();
+      }
+      delete In_plane_distribution_pt;
+      In_plane_distribution_pt =
+        new LinearAlgebraDistribution(communicator_pt(), n_in_plane, false);
+      CRDoubleMatrix block(In_plane_distribution_pt,
+                           n_in_plane,
+                           block_value,
+                           block_column_index,
+                           block_row_start);
+
+      // Factorise (by solving with a dummy right-hand side)
+      In_plane_linear_solver_pt->enable_resolve();
+      DoubleVector dummy_rhs(In_plane_distribution_pt, 0.0);
+      DoubleVector dummy_result;
+      In_plane_linear_solver_pt->solve(&block, dummy_rhs, dummy_result);
+
+      // Record what the factorisation is for
+      In_plane_eqn = in_plane_eqn;
+      const unsigned n_parameter = In_plane_stiffness_parameter_pt.size();
+      In_plane_stiffness_parameter_value.resize(n_parameter);
+      for (unsigned p = 0; p < n_parameter; p++)
+      {
+        In_plane_stiffness_parameter_value[p] =
+          *In_plane_stiffness_parameter_pt[p];
+      }
+      In_plane_factorisation_is_current = true;
+      Nin_plane_factorisation++;
+    }
+
+    /// Compute the responses Y = J^{-1} C to the constraints by
+    /// back-substitution with the factors from the last linear solve and
+    /// factorise the Schur complement S = C^T Y. The sign of the Jacobian
+    /// is updated to that of the constrained problem
+    /// (det J_constrained = det J det S), where the sign of det J is the
+    /// one recorded from the linear solver after the last factorisation
+    /// (the factors, and hence det J, are shared by successive sets of
+    /// constraints if the Jacobian is re-used).
+    void setup_constraint_responses()
+    {
+      const unsigned long n_dof = ndof();
+      const unsigned n_constraint = Constrained_dof_eqn.size();
+      Constraint_response.resize(n_constraint);
+      DoubleVector rhs(dof_distribution_pt(), 0.0);
+      DoubleVector response;
+      for (unsigned c = 0; c < n_constraint; c++)
+      {
+        rhs[Constrained_dof_eqn[c]] = 1.0;
+        linear_solver_pt()->resolve(rhs, response);
+        rhs[Constrained_dof_eqn[c]] = 0.0;
+        Constraint_response[c].resize(n_dof);
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          Constraint_response[c][i] = response[i];
+        }
+        Nconstraint_response_solve++;
+      }
+      Schur_complement.resize(n_constraint, n_constraint);
+      for (unsigned a = 0; a < n_constraint; a++)
+      {
+        for (unsigned b = 0; b < n_constraint; b++)
+        {
+          Schur_complement(a, b) =
+            Constraint_response[b][Constrained_dof_eqn[a]];
+        }
+      }
+      Sign_of_schur_complement_determinant =
+        lu_decompose(Schur_complement, Schur_complement_pivot);
+      if (!Sign_of_unconstrained_jacobian_is_current)
+      {
+        Sign_of_unconstrained_jacobian = sign_of_jacobian();
+        Sign_of_unconstrained_jacobian_is_current = true;
+      }
+      sign_of_jacobian() =
+        Sign_of_unconstrained_jacobian * Sign_of_schur_complement_determinant;
+      Constraint_response_is_current = true;
+    }
+
+    /// Correct the step just taken by the Newton solver (dx = -step) so
+    /// that the constrained dofs take their prescribed values:
+    /// step -> step - Y lambda with S lambda = C^T step - (value - u_old)
+    void apply_constraints_to_newton_step()
+    {
+      if ((!Constraint_response_is_current) ||
+          (Constraint_response[0].size() != ndof()))
+      {
+        setup_constraint_responses();
+      }
+      Vector<double> step;
+      get_newton_step(step);
+      const unsigned n_constraint = Constrained_dof_eqn.size();
+      Vector<double> lambda(n_constraint);
+      for (unsigned c = 0; c < n_constraint; c++)
+      {
+        const unsigned long eqn = Constrained_dof_eqn[c];
+        lambda[c] = step[eqn] - (Constrained_dof_value[c] -
+                                 Dofs_before_newton_step[eqn]);
+      }
+      lu_back_substitute(Schur_complement, Schur_complement_pivot, lambda);
+      const unsigned long n_dof = ndof();
+      for (unsigned c = 0; c < n_constraint; c++)
+      {
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          step[i] -= lambda[c] * Constraint_response[c][i];
+        }
+      }
+      set_damped_newton_step(step, 1.0);
+    }
+
+    /// LU decomposition (with partial pivoting) of the square matrix a in
+    /// place. Returns the sign of the determinant.
+    static int lu_decompose(DenseMatrix<double>& a, Vector<unsigned>& pivot)
+    {
+      const unsigned n = a.nrow();
+      pivot.resize(n);
+      int sign = 1;
+      for (unsigned k = 0; k < n; k++)
+      {
+        unsigned p = k;
+        for (unsigned i = k + 1; i < n; i++)
+        {
+          if (std::fabs(a(i, k)) > std::fabs(a(p, k)))
+          {
+            p = i;
+          }
+        }
+        pivot[k] = p;
+        if (a(p, k) == 0.0)
+        {
+          throw OomphLibError("Singular Schur complement: the constraints "
+                              "are not independent",
+                              OOMPH_CURRENT_FUNCTION,
+                              OOMPH_EXCEPTION_LOCATION);
+        }
+        if (p != k)
+        {
+          for (unsigned j = 0; j < n; j++)
+          {
+            std::swap(a(k, j), a(p, j));
+          }
+          sign = -sign;
+        }
+        if (a(k, k) < 0.0)
+        {
+          sign = -sign;
+        }
+        for (unsigned i = k + 1; i < n; i++)
+        {
+          a(i, k) /= a(k, k);
+          for (unsigned j = k + 1; j < n; j++)
+          {
+            a(i, j) -= a(i, k) * a(k, j);
+          }
+        }
+      }
+      return sign;
+    }
+
+    /// Solve with the LU decomposition from lu_decompose(...) in place
+    static void lu_back_substitute(const DenseMatrix<double>& lu,
+                                   const Vector<unsigned>& pivot,
+                                   Vector<double>& x)
+    {
+      const unsigned n = lu.nrow();
+      for (unsigned k = 0; k < n; k++)
+      {
+        std::swap(x[k], x[pivot[k]]);
+      }
+      for (unsigned i = 0; i < n; i++)
+      {
+        for (unsigned j = 0; j < i; j++)
+        {
+          x[i] -= lu(i, j) * x[j];
+        }
+      }
+      for (unsigned i = n; i-- > 0;)
+      {
+        for (unsigned j = i + 1; j < n; j++)
+        {
+          x[i] -= lu(i, j) * x[j];
+        }
+        x[i] /= lu(i, i);
+      }
+    }
+
+    /// Compute and store the element Jacobians (the element Hessians of
+    /// the energy) and the elements' equation numbers
+    void setup_element_hessians()
+    {
+      Mesh* el_mesh_pt = mesh_pt();
+      AssemblyHandler* handler_pt = assembly_handler_pt();
+      const unsigned long n_element = el_mesh_pt->nelement();
+      Element_hessian.resize(n_element);
+      Element_eqn_number.resize(n_element);
+      Vector<double> el_residuals;
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = el_mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        el_residuals.resize(n_el_dof);
+        Element_hessian[e].resize(n_el_dof, n_el_dof);
+        handler_pt->get_jacobian(el_pt, el_residuals, Element_hessian[e]);
+        Element_eqn_number[e].resize(n_el_dof);
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          Element_eqn_number[e][i] = handler_pt->eqn_number(el_pt, i);
+        }
+      }
+    }
+
+    /// Hessian-vector product y = H x, element by element
+    void hessian_vector_product(const Vector<double>& x, Vector<double>& y)
+    {
+      const unsigned long n_dof = ndof();
+      y.assign(n_dof, 0.0);
+      const unsigned long n_element = Element_hessian.size();
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        const Vector<unsigned long>& eqn = Element_eqn_number[e];
+        const DenseMatrix<double>& hessian = Element_hessian[e];
+        const unsigned n_el_dof = eqn.size();
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          double sum = 0.0;
+          for (unsigned j = 0; j < n_el_dof; j++)
+          {
+            sum += hessian(i, j) * x[eqn[j]];
+          }
+          y[eqn[i]] += sum;
+        }
+      }
+    }
+
+    /// Steihaug's truncated CG iteration for the minimiser of the
+    /// quadratic model g.s + s.H s/2 within the trust region |s| <= radius.
+    /// Returns the number of CG iterations.
+    unsigned steihaug_cg_step(const Vector<double>& gradient,
+                              const double& radius,
+                              Vector<double>& step)
+    {
+      const unsigned long n_dof = gradient.size();
+      step.assign(n_dof, 0.0);
+      Vector<double> r(gradient);
+      Vector<double> d(n_dof);
+      Vector<double> hd(n_dof);
+      double r_dot_r = 0.0;
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        d[i] = -r[i];
+        r_dot_r += r[i] * r[i];
+      }
+      const double tolerance =
+        Cg_relative_tolerance * Cg_relative_tolerance * r_dot_r;
+      unsigned iter = 0;
+      for (iter = 0; iter < Max_cg_iterations; iter++)
+      {
+        hessian_vector_product(d, hd);
+        double d_hd = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          d_hd += d[i] * hd[i];
+        }
+
+        // Negative curvature: go to the boundary
+        if (d_hd <= 0.0)
+        {
+          move_to_trust_region_boundary(d, radius, step);
+          return iter + 1;
+        }
+
+        // Step would leave the trust region: stop at the boundary
+        double alpha = r_dot_r / d_hd;
+        double step_norm_squared = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          double s_new = step[i] + alpha * d[i];
+          step_norm_squared += s_new * s_new;
+        }
+        if (step_norm_squared >= radius * radius)
+        {
+          move_to_trust_region_boundary(d, radius, step);
+          return iter + 1;
+        }
+
+        // Standard CG update
+        double r_dot_r_new = 0.0;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          step[i] += alpha * d[i];
+          r[i] += alpha * hd[i];
+          r_dot_r_new += r[i] * r[i];
+        }
+        if (r_dot_r_new < tolerance)
+        {
+          return iter + 1;
+        }
+        double beta = r_dot_r_new / r_dot_r;
+        r_dot_r = r_dot_r_new;
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          d[i] = -r[i] + beta * d[i];
+        }
+      }
+      return iter;
+    }
+
+    /// Set step -> step + tau d with tau > 0 such that |step| = radius
+    static void move_to_trust_region_boundary(const Vector<double>& d,
+                                              const double& radius,
+                                              Vector<double>& step)
+    {
+      const unsigned long n_dof = d.size();
+      double a = 0.0;
+      double b = 0.0;
+      double c = -radius * radius;
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        a += d[i] * d[i];
+        b += 2.0 * step[i] * d[i];
+        c += step[i] * step[i];
+      }
+      double tau = (-b + std::sqrt(b * b - 4.0 * a * c)) / (2.0 * a);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        step[i] += tau * d[i];
+      }
+    }
+
+    /// Change in energy from u_old to u_old + step (exact for energies
+    /// that are (at most) quartic in the dofs): Simpson's rule for the
+    /// integral of R(u_old + t step).step, given the residuals at u_old.
+    /// Leaves the dofs at u_old + step.
+    double energy_change_along_step(const Vector<double>& dofs_old,
+                                    const Vector<double>& residuals_old,
+                                    const Vector<double>& step)
+    {
+      const unsigned long n_dof = ndof();
+      double integrand[3] = {0.0, 0.0, 0.0};
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        integrand[0] += residuals_old[i] * step[i];
+      }
+      DoubleVector residuals;
+      for (unsigned k = 1; k < 3; k++)
+      {
+        double t = 0.5 * double(k);
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          dof(i) = dofs_old[i] + t * step[i];
+        }
+        get_residuals(residuals);
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          integrand[k] += residuals[i] * step[i];
+        }
+      }
+      return (integrand[0] + 4.0 * integrand[1] + integrand[2]) / 6.0;
+    }
+
+    /// Solve for the dofs at the end of a time step of size dt (the
+    /// history is not shifted). Returns false (with the dofs reset) if
+    /// the Newton iteration fails. The factorisation of the Jacobian is
+    /// reused from the previous time step if the acceleration weight
+    /// (i.e. dt) hasn't changed and no other solves have been performed
+    /// since -- provided resolve is enabled for the linear solver on
+    /// entry; otherwise the factors are only kept during the step (and
+    /// resolve is disabled again on exit, so they're not kept alive for
+    /// later solves).
+    bool solve_time_step(const double& dt, TimeStepRecord& record)
+    {
+      if (Inertia_assembly_handler_pt == 0)
+      {
+        throw OomphLibError("Call enable_dynamics(...) first",
+                            OOMPH_CURRENT_FUNCTION,
+                            OOMPH_EXCEPTION_LOCATION);
+      }
+
+      // Coefficients in the accelerations a = c u + d
+      const unsigned long n_dof = ndof();
+      double& weight = Inertia_assembly_handler_pt->acceleration_weight();
+      Vector<double>& offset =
+        Inertia_assembly_handler_pt->acceleration_offset();
+      offset.resize(n_dof);
+      Vector<double> bdf_weight;
+      if (Time_integration_scheme == Newmark_scheme)
+      {
+        // Trapezoidal rule (beta = 1/4, gamma = 1/2)
+        weight = 4.0 / (dt * dt);
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          offset[i] = -weight * (Dynamic_dofs[i] + dt * Dynamic_velocity[i]) -
+                      Dynamic_acceleration[i];
+        }
+      }
+      else
+      {
+        // Variable-step BDF2 (BDF1 for the first step) for the velocities
+        // and accelerations
+        get_bdf2_weights(dt, bdf_weight);
+        weight = bdf_weight[0] * bdf_weight[0];
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          offset[i] = bdf_weight[0] * bdf_weight[1] * Dynamic_dofs[i] +
+                      bdf_weight[1] * Dynamic_velocity[i];
+          if (bdf_weight[2] != 0.0)
+          {
+            offset[i] +=
+              bdf_weight[2] * (bdf_weight[0] * Previous_dynamic_dofs[i] +
+                               Previous_dynamic_velocity[i]);
+          }
+        }
+      }
+
+      // Predictor (second order Taylor expansion)
+      Vector<double> predicted_dofs(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        predicted_dofs[i] = Dynamic_dofs[i] + dt * Dynamic_velocity[i] +
+                            0.5 * dt * dt * Dynamic_acceleration[i];
+        dof(i) = predicted_dofs[i];
+      }
+
+      // Newton iteration with the inertia terms, reusing the
+      // factorisation of the Jacobian as long as it converges fast enough.
+      // The Newton step hooks are called as in Problem::newton_solve(), so
+      // the constraints, the in-plane elimination, the globalisation and
+      // the inexact Newton forcing are applied as for a static solve.
+      AssemblyHandler* old_assembly_handler_pt = assembly_handler_pt();
+      Inertia_assembly_handler_pt->problem_assembly_handler_pt() =
+        old_assembly_handler_pt;
+      assembly_handler_pt() = Inertia_assembly_handler_pt;
+      actions_before_newton_solve();
+      const bool resolve_was_enabled =
+        linear_solver_pt()->is_resolve_enabled();
+      linear_solver_pt()->enable_resolve();
+      bool reuse_factorisation =
+        (weight == Factorised_acceleration_weight) &&
+        (Nnewton_solve == Nnewton_solve_at_time_step + 1);
+      Nnewton_solve_at_time_step = Nnewton_solve;
+      DoubleVector residuals;
+      DoubleVector dx;
+      double previous_max_residual = DBL_MAX;
+      bool converged = false;
+      record.Nfactorisation = 0;
+      unsigned iter = 0;
+      try
+      {
+        for (iter = 0; iter <= max_newton_iterations(); iter++)
+        {
+          get_residuals(residuals);
+          double max_residual = residuals.max();
+          if (!Shut_up_in_newton_solve)
+          {
+            oomph_info << "Time step Newton iteration " << iter
+                       << ": max. residual " << max_residual << std::endl;
+          }
+          if (max_residual < newton_solver_tolerance())
+          {
+            converged = true;
+            break;
+          }
+          if ((iter == max_newton_iterations()) ||
+              (max_residual > max_residuals()))
+          {
+            break;
+          }
+          if (max_residual >
+              Max_modified_newton_contraction * previous_max_residual)
+          {
+            reuse_factorisation = false;
+          }
+          actions_before_newton_step();
+
+          // The in-plane elimination has changed the dofs
+          if (In_plane_elimination_mesh_pt != 0)
+          {
+            get_residuals(residuals);
+          }
+          if (reuse_factorisation)
+          {
+            linear_solver_pt()->resolve(residuals, dx);
+          }
+          else
+          {
+            linear_solver_pt()->solve(this, dx);
+            Sign_of_unconstrained_jacobian_is_current = false;
+            Factorised_acceleration_weight = weight;
+            record.Nfactorisation++;
+            reuse_factorisation = true;
+          }
+          for (unsigned long i = 0; i < n_dof; i++)
+          {
+            dof(i) -= dx[i];
+          }
+          actions_after_newton_step();
+          previous_max_residual = max_residual;
+        }
+      }
+      catch (...)
+      {
+        assembly_handler_pt() = old_assembly_handler_pt;
+        restore_resolve_after_time_step(resolve_was_enabled);
+        throw;
+      }
+      assembly_handler_pt() = old_assembly_handler_pt;
+      restore_resolve_after_time_step(resolve_was_enabled);
+      Nnewton_step = iter;
+
+      // Fill in the record
+      record.Time = Dynamic_time + dt;
+      record.Dt = dt;
+      record.Nnewton_iter = iter;
+      record.Accepted = converged;
+      record.Error = 0.0;
+      if (!converged)
+      {
+        for (unsigned long i = 0; i < n_dof; i++)
+        {
+          dof(i) = Dynamic_dofs[i];
+        }
+        return false;
+      }
+      actions_after_newton_solve();
+
+      // Estimate the local truncation error from the difference between
+      // the predictor and the corrector (Milne's device): With the error
+      // constant 1/6 of the predictor and C of the corrector (-1/12 for
+      // Newmark's trapezoidal rule, -2/9 for BDF2 with constant steps),
+      // the error of the corrector is |C| / (1/6 - C) times the
+      // difference, to leading order
+      const double error_constant =
+        (Time_integration_scheme == Newmark_scheme) ? -1.0 / 12.0 : -2.0 / 9.0;
+      const double milne_factor =
+        std::fabs(error_constant) / (1.0 / 6.0 - error_constant);
+      double error = 0.0;
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        double diff = milne_factor * (dof(i) - predicted_dofs[i]);
+        error += diff * diff;
+      }
+      if (n_dof > 0)
+      {
+        record.Error = std::sqrt(error / double(n_dof));
+      }
+      return true;
+    }
+
+    /// Restore the linear solver's resolve state at the end of a time
+    /// step; if the factors are discarded they can't be reused by the
+    /// next time step
+    void restore_resolve_after_time_step(const bool& resolve_was_enabled)
+    {
+      if (!resolve_was_enabled)
+      {
+        linear_solver_pt()->disable_resolve();
+        Factorised_acceleration_weight = -1.0;
+      }
+    }
+
+    /// Weights in the variable-step BDF2 approximation of the time
+    /// derivative, y'_{n+1} = w0 y_{n+1} + w1 y_n + w2 y_{n-1} (BDF1 if
+    /// there's no previous step)
+    void get_bdf2_weights(const double& dt, Vector<double>& bdf_weight) const
+    {
+      bdf_weight.resize(3);
+      if (Previous_dt <= 0.0)
+      {
+        bdf_weight[0] = 1.0 / dt;
+        bdf_weight[1] = -1.0 / dt;
+        bdf_weight[2] = 0.0;
+        return;
+      }
+      const double omega = dt / Previous_dt;
+      bdf_weight[0] = (1.0 + 2.0 * omega) / ((1.0 + omega) * dt);
+      bdf_weight[1] = -(1.0 + omega) / dt;
+      bdf_weight[2] = omega * omega / ((1.0 + omega) * dt);
+    }
+
+    /// Update the velocities and accelerations after an accepted time
+    /// step of size dt and shift the history
+    void shift_dynamic_history(const double& dt)
+    {
+      const unsigned long n_dof = ndof();
+      const double weight = Inertia_assembly_handler_pt->acceleration_weight();
+      const Vector<double>& offset =
+        Inertia_assembly_handler_pt->acceleration_offset();
+      Vector<double> velocity(n_dof);
+      Vector<double> acceleration(n_dof);
+      Vector<double> bdf_weight;
+      if (Time_integration_scheme == BDF2_scheme)
+      {
+        get_bdf2_weights(dt, bdf_weight);
+      }
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        acceleration[i] = weight * dof(i) + offset[i];
+        if (Time_integration_scheme == Newmark_scheme)
+        {
+          velocity[i] = Dynamic_velocity[i] +
+                        0.5 * dt * (Dynamic_acceleration[i] + acceleration[i]);
+        }
+        else
+        {
+          velocity[i] =
+            bdf_weight[0] * dof(i) + bdf_weight[1] * Dynamic_dofs[i];
+          if (bdf_weight[2] != 0.0)
+          {
+            velocity[i] += bdf_weight[2] * Previous_dynamic_dofs[i];
+          }
+        }
+      }
+      Previous_dynamic_dofs = Dynamic_dofs;
+      Previous_dynamic_velocity = Dynamic_velocity;
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        Dynamic_dofs[i] = dof(i);
+      }
+      Dynamic_velocity = velocity;
+      Dynamic_acceleration = acceleration;
+      Previous_dt = dt;
+      Dynamic_time += dt;
+    }
+
+    /// Re-install the parameter context assembly handler (if any) after
+    /// the bifurcation tracking has reset the default one
+    void restore_parameter_context_assembly()
+    {
+      if (Parameter_context_assembly_handler_pt != 0)
+      {
+        assembly_handler_pt() = Parameter_context_assembly_handler_pt;
+      }
+    }
+
+    /// Name with the leading "--" of a command line flag
+    static std::string flag_name(const std::string& name)
+    {
+      if (name.compare(0, 2, "--") == 0)
+      {
+        return name;
+      }
+      return "--" + name;
+    }
+
+    /// Copy the logarithm of the parameter that's being ramped by
+    /// homotopy_solve(...) (if any) into the parameter
+    void update_log_homotopy_parameter()
+    {
+      if (Log_homotopy_parameter_pt != 0)
+      {
+        *Log_homotopy_parameter_pt = std::exp(Log_homotopy_parameter);
+      }
+    }
+
+    /// Get the values of all nodes in the problem's mesh (in the order of
+    /// the nodes)
+    void get_nodal_values(Vector<double>& nodal_values)
+    {
+      nodal_values.clear();
+      const unsigned long n_node = mesh_pt()->nnode();
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = mesh_pt()->node_pt(j);
+        const unsigned n_value = nod_pt->nvalue();
+        for (unsigned v = 0; v < n_value; v++)
+        {
+          nodal_values.push_back(nod_pt->value(v));
+        }
+      }
+    }
+
+    /// Build the symbolic analysis for the ensemble Newton solves from
+    /// the problem's elements
+    void build_ensemble_structure()
+    {
+      Mesh* el_mesh_pt = mesh_pt();
+      AssemblyHandler* handler_pt = assembly_handler_pt();
+      const unsigned long n_element = el_mesh_pt->nelement();
+      Vector<Vector<unsigned long>> coupled_dofs(n_element);
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = el_mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        coupled_dofs[e].resize(n_el_dof);
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          coupled_dofs[e][i] = handler_pt->eqn_number(el_pt, i);
+        }
+      }
+      Ensemble_structure.build(ndof(), coupled_dofs);
+    }
+
+    /// Reset the parameters, nodal values and dofs after an ensemble
+    /// Newton solve
+    void restore_state_after_ensemble_newton_solve(
+      const Vector<double*>& parameter_pt,
+      const Vector<double>& parameter_backup,
+      const Vector<double>& nodal_value_backup,
+      const Vector<double>& dofs_backup)
+    {
+      const unsigned n_parameter = parameter_pt.size();
+      for (unsigned p = 0; p < n_parameter; p++)
+      {
+        *parameter_pt[p] = parameter_backup[p];
+      }
+      const unsigned long n_node = mesh_pt()->nnode();
+      unsigned long offset = 0;
+      for (unsigned long j = 0; j < n_node; j++)
+      {
+        Node* nod_pt = mesh_pt()->node_pt(j);
+        const unsigned n_value = nod_pt->nvalue();
+        for (unsigned v = 0; v < n_value; v++)
+        {
+          nod_pt->set_value(v, nodal_value_backup[offset++]);
+        }
+      }
+      const unsigned long n_dof = ndof();
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        dof(i) = dofs_backup[i];
+      }
+    }
+
+    /// Assemble the residuals by a residual-only loop over the elements
+    void get_residuals_by_element_loop(Vector<double>& residuals)
+    {
+      residuals.assign(ndof(), 0.0);
+      Mesh* el_mesh_pt = mesh_pt();
+      AssemblyHandler* handler_pt = assembly_handler_pt();
+      const unsigned long n_element = el_mesh_pt->nelement();
+      Vector<double> el_residuals;
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = el_mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        el_residuals.assign(n_el_dof, 0.0);
+        handler_pt->get_residuals(el_pt, el_residuals);
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          residuals[handler_pt->eqn_number(el_pt, i)] += el_residuals[i];
+        }
+      }
+    }
+
+    /// Inverse of the lumped masses for the dynamic relaxation (with a
+    /// unit time step): m_i = f sum_e sum_j |J^e_ij| / 4, where the sum is
+    /// the Gerschgorin bound for the largest eigenvalue associated with
+    /// dof i and f is the safety factor
+    void get_dynamic_relaxation_inverse_mass(Vector<double>& inverse_mass)
+    {
+      const unsigned long n_dof = ndof();
+      Vector<double> row_sum(n_dof, 0.0);
+      Mesh* el_mesh_pt = mesh_pt();
+      AssemblyHandler* handler_pt = assembly_handler_pt();
+      const unsigned long n_element = el_mesh_pt->nelement();
+      Vector<double> el_residuals;
+      DenseMatrix<double> el_jacobian;
+      for (unsigned long e = 0; e < n_element; e++)
+      {
+        GeneralisedElement* el_pt = el_mesh_pt->element_pt(e);
+        const unsigned n_el_dof = handler_pt->ndof(el_pt);
+        el_residuals.resize(n_el_dof);
+        el_jacobian.resize(n_el_dof, n_el_dof);
+        handler_pt->get_jacobian(el_pt, el_residuals, el_jacobian);
+        for (unsigned i = 0; i < n_el_dof; i++)
+        {
+          double sum = 0.0;
+          for (unsigned j = 0; j < n_el_dof; j++)
+          {
+            sum += std::fabs(el_jacobian(i, j));
+          }
+          row_sum[handler_pt->eqn_number(el_pt, i)] += sum;
+        }
+      }
+      inverse_mass.resize(n_dof);
+      for (unsigned long i = 0; i < n_dof; i++)
+      {
+        double mass = 0.25 * Dynamic_relaxation_mass_safety_factor * row_sum[i];
+        inverse_mass[i] = (mass > 0.0) ? 1.0 / mass : 1.0;
+      }
+    }
+
+    /// The linear solver, cast to an iterative linear solver
+    IterativeLinearSolver* iterative_linear_solver_pt()
+    {
+      return dynamic_cast<IterativeLinearSolver*>(linear_solver_pt());
+    }
+
+    /// Compute the Eisenstat-Walker forcing term for the upcoming Newton
+    /// iteration from the current residual norm and pass it to the linear
+    /// solver as its (relative) tolerance. The max. residual is used for
+    /// the lower bound (the Newton solver's convergence check uses the
+    /// max. norm).
+    void set_eisenstat_walker_forcing_term(const double& residual_norm,
+                                           const double& max_residual)
+    {
+      // First iteration of this solve
+      if (Nnewton_step == 1)
+      {
+        Forcing_term = Initial_forcing_term;
+      }
+      else
+      {
+        double previous_forcing_term = Forcing_term;
+        Forcing_term =
+          Eisenstat_walker_gamma *
+          std::pow(residual_norm / Previous_residual_norm,
+                   Eisenstat_walker_alpha);
+
+        // Safeguard against dropping the tolerance too quickly
+        double safeguard = Eisenstat_walker_gamma *
+                           std::pow(previous_forcing_term,
+                                    Eisenstat_walker_alpha);
+        if (safeguard > 0.1)
+        {
+          Forcing_term = std::max(Forcing_term, safeguard);
+        }
+
+        // ...and against over-solving close to convergence: there's no
+        // point reducing the linear residual much below the Newton
+        // tolerance
+        Forcing_term = std::max(
+          Forcing_term, 0.5 * newton_solver_tolerance() / max_residual);
+      }
+      Forcing_term = std::min(Forcing_term, Max_forcing_term);
+      Previous_residual_norm = residual_norm;
+
+      iterative_linear_solver_pt()->tolerance() = Forcing_term;
+
+      // Record
+      InexactNewtonRecord record;
+      record.Newton_solve = Nnewton_solve;
+      record.Newton_iter = Nnewton_step;
+      record.Residual_norm = residual_norm;
+      record.Forcing_term = Forcing_term;
+      record.Nlinear_iter = 0;
+      Inexact_newton_history.push_back(record);
+    }
+
+  private:
+    /// Max. magnitude of the arc-length increment
+    double Max_ds;
+
+    /// Number of continuation steps taken since the last reset
+    unsigned Ncontinuation_step;
+
+    /// Number of sign changes of the Jacobian since the last reset
+    unsigned Nsign_change;
+
+    /// Did the sign of the Jacobian change during the most recent
+    /// continuation step?
+    bool Sign_change_detected;
+
+    /// Predictor used in adaptive_load_step(...)
+    LoadStepPredictor Load_step_predictor;
+
+    /// Desired number of Newton iterations per load step
+    unsigned Desired_newton_iterations_dp;
+
+    /// Max. factor by which the load increment grows between steps
+    double Max_dp_growth_factor;
+
+    /// Factor by which the load increment is cut after a failed step
+    double Dp_cut_factor;
+
+    /// Min. magnitude of the load increment before we give up
+    double Min_dp;
+
+    /// Max. magnitude of the load increment
+    double Max_dp;
+
+    /// Parameter that was incremented in the most recent load step
+    double* Load_step_parameter_pt;
+
+    /// Dofs at the previous converged load step
+    Vector<double> Previous_load_step_dofs;
+
+    /// Parameter value at the previous converged load step
+    double Previous_load_step_parameter;
+
+    /// History of accepted and rejected load steps
+    Vector<LoadStepRecord> Load_step_history;
+
+    /// Number of Newton iterations taken during the most recent solve
+    unsigned Nnewton_step;
+
+    /// Max. number of Lanczos iterations in solve_for_buckling_modes(...)
+    unsigned Nlanczos_iteration_max;
+
+    /// Relative tolerance for detecting breakdown of the Lanczos iteration
+    double Lanczos_tolerance;
+
+    /// Parameter value at which the most recent buckling analysis
+    /// was performed
+    double Buckling_parameter;
+
+    /// Eigenvalues (closest to zero) of the Jacobian
+    Vector<double> Buckling_eigenvalue;
+
+    /// Derivatives of the eigenvalues w.r.t. the load parameter
+    Vector<double> Buckling_eigenvalue_derivative;
+
+    /// Estimated critical values of the load parameter
+    Vector<double> Buckling_critical_parameter;
+
+    /// The (normalised) eigenmodes
+    Vector<Vector<double>> Buckling_mode;
+
+    /// Backup of the dofs while they're overwritten by a buckling mode
+    Vector<double> Dofs_before_buckling_mode;
+
+    /// Is deflation enabled?
+    bool Deflation_is_enabled;
+
+    /// Power, p, in the deflation operator
+    double Deflation_power;
+
+    /// Shift, sigma, in the deflation operator
+    double Deflation_shift;
+
+    /// Relative tolerance for identifying solutions as duplicates
+    double Deflation_tolerance;
+
+    /// The solutions to be deflated
+    Vector<Vector<double>> Deflation_solution;
+
+    /// Dofs before the current Newton step
+    Vector<double> Dofs_before_newton_step;
+
+    /// Number of Newton solves performed
+    unsigned Nnewton_solve;
+
+    /// Is the Eisenstat-Walker choice of the forcing term enabled?
+    bool Eisenstat_walker_forcing_is_enabled;
+
+    /// Factor gamma in the forcing term
+    double Eisenstat_walker_gamma;
+
+    /// Exponent alpha in the forcing term
+    double Eisenstat_walker_alpha;
+
+    /// Forcing term for the first Newton iteration of each solve
+    double Initial_forcing_term;
+
+    /// Max. forcing term
+    double Max_forcing_term;
+
+    /// Residual norm at the previous Newton iteration
+    double Previous_residual_norm;
+
+    /// Current forcing term
+    double Forcing_term;
+
+    /// History of the inexact Newton iterations
+    Vector<InexactNewtonRecord> Inexact_newton_history;
+
+    /// Globalisation strategy for the Newton iteration
+    NewtonGlobalisation Newton_globalisation;
+
+    /// Residual norm at the start of the current Newton step
+    double Residual_norm_before_newton_step;
+
+    /// Factor tau by which the current Newton step was scaled by the
+    /// deflation (1 if it wasn't)
+    double Deflation_step_scaling_factor;
+
+    /// Parameter in the Armijo condition
+    double Armijo_parameter;
+
+    /// Min. fraction of the Newton step taken when globalising
+    double Min_newton_step_length;
+
+    /// Initial trust region radius
+    double Initial_trust_region_radius;
+
+    /// Current trust region radius
+    double Trust_region_radius;
+
+    /// Min. trust region radius
+    double Min_trust_region_radius;
+
+    /// Number of Newton steps that were damped
+    unsigned Ndamped_newton_step;
+
+    /// Number of additional residual evaluations by the globalisation
+    unsigned Nresidual_evaluation_in_globalisation;
+
+    /// Mesh whose nodes store the in-plane displacements to be
+    /// eliminated (null if elimination is disabled)
+    Mesh* In_plane_elimination_mesh_pt;
+
+    /// Indices of the nodal values that store the in-plane displacements
+    Vector<unsigned> In_plane_value_index;
+
+    /// Parameters that the in-plane block of the Jacobian depends on
+    Vector<double*> In_plane_stiffness_parameter_pt;
+
+    /// Values of these parameters for the current factorisation
+    Vector<double> In_plane_stiffness_parameter_value;
+
+    /// Default linear solver for the in-plane block
+    SuperLUSolver Default_in_plane_linear_solver;
+
+    /// Linear solver for the in-plane block
+    LinearSolver* In_plane_linear_solver_pt;
+
+    /// Distribution of the in-plane block
+    LinearAlgebraDistribution* In_plane_distribution_pt;
+
+    /// Equation numbers of the in-plane dofs for the current
+    /// factorisation
+    Vector<unsigned long> In_plane_eqn;
+
+    /// Is the factorisation of the in-plane block current?
+    bool In_plane_factorisation_is_current;
+
+    /// Number of in-plane solves performed
+    unsigned Nin_plane_elimination;
+
+    /// Number of factorisations of the in-plane block
+    unsigned Nin_plane_factorisation;
+
+    /// Equation numbers of the constrained dofs
+    Vector<unsigned long> Constrained_dof_eqn;
+
+    /// Prescribed values of the constrained dofs
+    Vector<double> Constrained_dof_value;
+
+    /// Responses J^{-1} e_c to the constraints
+    Vector<Vector<double>> Constraint_response;
+
+    /// Are the responses (and the Schur complement) up to date?
+    bool Constraint_response_is_current;
+
+    /// LU decomposition of the Schur complement C^T J^{-1} C
+    DenseMatrix<double> Schur_complement;
+
+    /// Row interchanges in the LU decomposition of the Schur complement
+    Vector<unsigned> Schur_complement_pivot;
+
+    /// Sign of the determinant of the Schur complement
+    int Sign_of_schur_complement_determinant;
+
+    /// Sign of the determinant of the (unconstrained) Jacobian, as
+    /// computed by the linear solver during the last factorisation
+    int Sign_of_unconstrained_jacobian;
+
+    /// Has the sign of the unconstrained Jacobian been recorded since the
+    /// last factorisation? (Reset wherever a new factorisation is made;
+    /// with Jacobian re-use, the first factorisation is the only one.)
+    bool Sign_of_unconstrained_jacobian_is_current;
+
+    /// Equation numbers of the nodal values, stored before additional
+    /// values are pinned
+    Vector<Vector<long>> Stored_nodal_eqn_number;
+
+    /// Number of back-substitutions for the constraint responses
+    unsigned Nconstraint_response_solve;
+
+    /// Use energy minimisation rather than Newton's method?
+    bool Energy_minimisation_is_enabled;
+
+    /// Max. number of trust-region iterations
+    unsigned Max_energy_minimisation_iterations;
+
+    /// Relative tolerance for the truncated CG iteration
+    double Cg_relative_tolerance;
+
+    /// Max. number of CG iterations per step
+    unsigned Max_cg_iterations;
+
+    /// Initial trust-region radius
+    double Initial_energy_trust_region_radius;
+
+    /// Number of energy minimisations performed
+    unsigned Nenergy_minimisation;
+
+    /// Record of the energy minimisation iterations
+    Vector<EnergyMinimisationRecord> Energy_minimisation_history;
+
+    /// Element Jacobians (Hessians of the energy)
+    Vector<DenseMatrix<double>> Element_hessian;
+
+    /// Global equation numbers of the elements' dofs
+    Vector<Vector<unsigned long>> Element_eqn_number;
+
+    /// Factor by which the lumped masses exceed the stability limit
+    double Dynamic_relaxation_mass_safety_factor;
+
+    /// Number of steps after which the lumped masses are updated
+    unsigned Dynamic_relaxation_mass_update_interval;
+
+    /// Max. number of dynamic relaxation steps for the initial guess
+    /// (zero if disabled)
+    unsigned Ndynamic_relaxation_initial_guess_step;
+
+    /// Tolerance for the dynamic relaxation for the initial guess
+    double Dynamic_relaxation_initial_guess_tolerance;
+
+    /// Number of kinetic energy peaks
+    unsigned Nkinetic_energy_peak;
+
+    /// Assembly handler that adds the inertia terms (null if the
+    /// dynamics is disabled)
+    FvKInertiaAssemblyHandler* Inertia_assembly_handler_pt;
+
+    /// Time integration scheme
+    TimeIntegrationScheme Time_integration_scheme;
+
+    /// Current time
+    double Dynamic_time;
+
+    /// Size of the previous (accepted) time step (zero if none)
+    double Previous_dt;
+
+    /// Safety factor applied to the optimal time step
+    double Dt_safety_factor;
+
+    /// Max. factor by which the time step grows between steps
+    double Max_dt_growth_factor;
+
+    /// The time step is only increased if it can grow by more than this
+    double Dt_increase_threshold;
+
+    /// Factor by which the time step is cut after a failed Newton iteration
+    double Dt_cut_factor;
+
+    /// Min. time step before we give up
+    double Min_dt;
+
+    /// Max. reduction in the max. residual per iteration for which the
+    /// factorisation of the Jacobian is reused
+    double Max_modified_newton_contraction;
+
+    /// Acceleration weight for which the linear solver's factorisation
+    /// was computed (negative if none)
+    double Factorised_acceleration_weight;
+
+    /// Value of Nnewton_solve during the most recent time step (to detect
+    /// other solves that overwrite the factorisation)
+    unsigned Nnewton_solve_at_time_step;
+
+    /// Dofs at the current time
+    Vector<double> Dynamic_dofs;
+
+    /// Velocities at the current time
+    Vector<double> Dynamic_velocity;
+
+    /// Accelerations at the current time
+    Vector<double> Dynamic_acceleration;
+
+    /// Dofs at the previous time (for BDF2)
+    Vector<double> Previous_dynamic_dofs;
+
+    /// Velocities at the previous time (for BDF2)
+    Vector<double> Previous_dynamic_velocity;
+
+    /// History of accepted and rejected time steps
+    Vector<TimeStepRecord> Time_step_history;
+
+    /// Symbolic analysis for the ensemble Newton solves (if it can't be
+    /// shared with the linear solver)
+    SkylineStructure Ensemble_structure;
+
+    /// Number of Newton iterations taken by each member in the most
+    /// recent ensemble Newton solve
+    Vector<unsigned> Ensemble_nnewton_iter;
+
+    /// Parameter that's ramped in its logarithm by homotopy_solve(...)
+    /// (null if none)
+    double* Log_homotopy_parameter_pt;
+
+    /// Logarithm of that parameter
+    double Log_homotopy_parameter;
+
+    /// Parameters owned by this problem, by name
+    std::map<std::string, double*> Registered_parameter_pt;
+
+    /// Assembly handler that makes the problem's parameters current for
+    /// each element (null if not enabled)
+    FvKParameterContextAssemblyHandler* Parameter_context_assembly_handler_pt;
+
+    /// The (default) assembly handler that it replaced
+    AssemblyHandler* Replaced_assembly_handler_pt;
+
+    /// Linear solvers owned by this problem (in order of adoption)
+    Vector<LinearSolver*> Owned_linear_solver_pt;
+
+    /// Preconditioners owned by this problem
+    Vector<Preconditioner*> Owned_preconditioner_pt;
+  };
+
+
+  //===========================================================================
+  // FvKParameterContextAssemblyHandler: Select the problem's parameters,
+  // then compute the element's contributions as usual
+  //===========================================================================
+
+  inline void FvKParameterContextAssemblyHandler::get_residuals(
+    GeneralisedElement* const& elem_pt, Vector<double>& residuals)
+  {
+    Problem_pt->make_parameters_current();
+    AssemblyHandler::get_residuals(elem_pt, residuals);
+  }
+
+  inline void FvKParameterContextAssemblyHandler::get_jacobian(
+    GeneralisedElement* const& elem_pt,
+    Vector<double>& residuals,
+    DenseMatrix<double>& jacobian)
+  {
+    Problem_pt->make_parameters_current();
+    AssemblyHandler::get_jacobian(elem_pt, residuals, jacobian);
+  }
+
+  inline void
+  FvKParameterContextAssemblyHandler::get_all_vectors_and_matrices(
+    GeneralisedElement* const& elem_pt,
+    Vector<Vector<double>>& vec,
+    Vector<DenseMatrix<double>>& matrix)
+  {
+    Problem_pt->make_parameters_current();
+    AssemblyHandler::get_all_vectors_and_matrices(elem_pt, vec, matrix);
+  }
+
+  inline void FvKParameterContextAssemblyHandler::get_dresiduals_dparameter(
+    GeneralisedElement* const& elem_pt,
+    double* const& parameter_pt,
+    Vector<double>& dres_dparam)
+  {
+    Problem_pt->make_parameters_current();
+    AssemblyHandler::get_dresiduals_dparameter(
+      elem_pt, parameter_pt, dres_dparam);
+  }
+
+  inline void FvKParameterContextAssemblyHandler::get_djacobian_dparameter(
+    GeneralisedElement* const& elem_pt,
+    double* const& parameter_pt,
+    Vector<double>& dres_dparam,
+    DenseMatrix<double>& djac_dparam)
+  {
+    Problem_pt->make_parameters_current();
+    AssemblyHandler::get_djacobian_dparameter(
+      elem_pt, parameter_pt, dres_dparam, djac_dparam);
+  }
+
+  inline void
+  FvKParameterContextAssemblyHandler::get_hessian_vector_products(
+    GeneralisedElement* const& elem_pt,
+    Vector<double> const& Y,
+    DenseMatrix<double> const& C,
+    DenseMatrix<double>& product)
+  {
+    Problem_pt->make_parameters_current();
+    AssemblyHandler::get_hessian_vector_products(elem_pt, Y, C, product);
+  }
+
+} // namespace oomph
+
+#endif
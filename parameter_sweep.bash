@@ -0,0 +1,151 @@
+#! /bin/bash
+
+# Run one of the drivers for a grid (or list) of parameter values, with
+# the cases scheduled across the cores, and collect the traces of all
+# cases into a single table. This replaces shell loops over --nu, --eta,
+# --element_area etc. Usage:
+#
+#   ./parameter_sweep.bash [-j n_job] [-o sweep_dir] [-c case_file] \
+#       [-t trace_file] driver [--flag value1,value2,...]... [-- flags]
+#
+# Every "--flag value1,value2,..." pair adds an axis to the grid; the
+# sweep runs all combinations. Alternatively, each non-comment line of
+# the case file holds the "--flag value" pairs for one case. Flags
+# after "--" (e.g. --use_clamped_bc or --linear_solver ldlt) are passed
+# to every case. Examples:
+#
+#   ./parameter_sweep.bash circular_sector --nu 0.3,0.5 \
+#       --alpha 0.785398,1.570796 --element_area 0.09,0.03,0.01
+#   ./parameter_sweep.bash -j 4 circular_disc --eta 1e4,1e5,1e6 \
+#       -- --use_clamped_bc
+#   ./parameter_sweep.bash circular_disc --p 0.001,0.002 \
+#       --t_max 1e-4,2e-4
+#   ./parameter_sweep.bash axisym_displ_based_fvk --eta 1e5,1e6 \
+#       --p_max 0.1,1.0 -- --use_adaptive_load_stepping
+#
+# Case i writes its output (via the driver's --dir flag) to
+# sweep_dir/case<i> (default sweep_dir: RESLT_sweep), together with its
+# flags, screen output and exit status. The collected table goes to
+# sweep_dir/sweep.dat: each line of each case's trace file (trace.dat;
+# w_centre.dat for axisym_displ_based_fvk) is prefixed by the case
+# number, the values of the swept parameters and the exit status.
+
+n_job=`nproc`
+sweep_dir=RESLT_sweep
+case_file=""
+trace_file=""
+while getopts "j:o:c:t:" option; do
+    case $option in
+        j) n_job=$OPTARG ;;
+        o) sweep_dir=$OPTARG ;;
+        c) case_file=$OPTARG ;;
+        t) trace_file=$OPTARG ;;
+        *) echo "Unknown option; see the comments at the top of $0"
+           exit 1 ;;
+    esac
+done
+shift $((OPTIND-1))
+
+driver=$1
+shift
+if [ -z "$driver" ] || [ ! -x ./$driver ]; then
+    echo "Please specify the (compiled) driver to run"
+    exit 1
+fi
+
+if [ -e $sweep_dir ]; then
+    echo "$sweep_dir already exists; please delete"
+    exit 1
+fi
+
+# Name of the trace file written by the driver
+if [ -z "$trace_file" ]; then
+    if [ $driver == "axisym_displ_based_fvk" ]; then
+        trace_file=w_centre.dat
+    else
+        trace_file=trace.dat
+    fi
+fi
+
+# Swept flags and their comma-separated values; the remaining flags are
+# passed to every case
+swept_flags=()
+swept_values=()
+while [ $# -gt 0 ] && [ "$1" != "--" ]; do
+    if [ $# -lt 2 ]; then
+        echo "No values specified for $1"
+        exit 1
+    fi
+    swept_flags+=("$1")
+    swept_values+=("$2")
+    shift 2
+done
+if [ "$1" == "--" ]; then
+    shift
+fi
+fixed_flags="$*"
+
+mkdir -p $sweep_dir
+
+# Build the list of cases (one line of flags per case): the Cartesian
+# product of the values of the swept flags, or the case file
+if [ -n "$case_file" ]; then
+    grep -v '^ *#' $case_file | grep -v '^ *$' > $sweep_dir/cases.dat
+else
+    echo "" > $sweep_dir/cases.dat
+    for i in ${!swept_flags[@]}; do
+        rm -f $sweep_dir/cases.tmp
+        while read -r case_flags; do
+            for value in ${swept_values[$i]//,/ }; do
+                echo "$case_flags ${swept_flags[$i]} $value" \
+                    >> $sweep_dir/cases.tmp
+            done
+        done < $sweep_dir/cases.dat
+        mv $sweep_dir/cases.tmp $sweep_dir/cases.dat
+    done
+fi
+n_case=`wc -l < $sweep_dir/cases.dat`
+echo "Running $n_case cases of $driver with $n_job jobs in parallel"
+
+# Run a single case, specified by its number and flags. Each case runs
+# serially (the parallelism comes from running several at once)
+run_case()
+{
+    case_dir=$sweep_dir/case$1
+    shift
+    mkdir $case_dir
+    echo "$*" > $case_dir/flags
+    OMP_NUM_THREADS=1 ./$driver $* $fixed_flags --dir $case_dir \
+        > $case_dir/OUTPUT 2>&1
+    echo $? > $case_dir/status
+}
+export -f run_case
+export driver sweep_dir fixed_flags
+
+# Schedule the cases across the cores
+awk '{print NR, $0}' $sweep_dir/cases.dat | \
+    xargs -d '\n' -P $n_job -n 1 bash -c 'run_case $0'
+
+# Collect the traces into one table, in the order of the cases
+result_file=$sweep_dir/sweep.dat
+echo "# case `head -1 $sweep_dir/cases.dat | \
+    awk '{for (i=1;i<NF;i+=2) printf "%s ", substr($i,3)}'`status" \
+    "[$trace_file columns]" > $result_file
+n_failed=0
+for ((i=1;i<=n_case;i++)); do
+    case_dir=$sweep_dir/case$i
+    status=`cat $case_dir/status`
+    if [ "$status" != "0" ]; then
+        n_failed=$((n_failed+1))
+    fi
+    prefix="$i `awk '{for (i=2;i<=NF;i+=2) printf "%s ", $i}' \
+        $case_dir/flags`$status"
+    if [ -s $case_dir/$trace_file ]; then
+        grep -v '^ *#' $case_dir/$trace_file | \
+            awk -v prefix="$prefix" '{print prefix, $0}' >> $result_file
+    else
+        echo "# $prefix (no $trace_file)" >> $result_file
+    fi
+done
+
+echo "Done: $n_failed of $n_case cases failed; results in $result_file"
@@ -37,6 +37,12 @@
 
 // The mesh
 #include "meshes/triangle_mesh.h"
+
+// Shared solution strategies (continuation etc.)
+#include "fvk_solver_problem.h"
+
+// Linear solvers
+#include "fvk_linear_solvers.h"
     
 using namespace std;
 using namespace oomph;
@@ -48,6 +54,12 @@ using MathematicalConstants::Pi;
 //===========================================================================
 namespace Parameters
 {
+  /// Number of problems in existence: The elements read these
+  /// (process-wide) parameters directly, rather than those of the
+  /// problem that's being solved (cf. circular_disc), so there can only
+  /// be one problem at a time
+  unsigned Nproblem = 0;
+
   /// Square edge length
   double L = 1.0;
 
@@ -242,7 +254,7 @@ namespace Parameters
 /// Class definition
 //====================================================================
 template<class ELEMENT>
-class UnstructuredFvKProblem : public virtual Problem
+class UnstructuredFvKProblem : public virtual FvKSolverProblem
 {
   
 public:
@@ -253,6 +265,9 @@ public:
   /// Destructor
   ~UnstructuredFvKProblem()
   {
+    // Release the global parameters
+    Parameters::Nproblem--;
+
     // Close the trace file as we are done with the problem
     Trace_file.close();
   
@@ -269,6 +284,8 @@ public:
   /// Print information about the parameters we are trying to solve for.
   void actions_before_newton_solve()
   {
+    FvKSolverProblem::actions_before_newton_solve();
+
     oomph_info << "-------------------------------------------------------"
     << std::endl;
     oomph_info << "Solving for P = " << Parameters::P_mag << std::endl;
@@ -374,6 +391,15 @@ private:
 template<class ELEMENT>
 UnstructuredFvKProblem<ELEMENT>::UnstructuredFvKProblem()
 {
+  // The elements use the global parameters, so there can only be one
+  // problem at a time
+  if (Parameters::Nproblem++ > 0)
+  {
+    throw OomphLibError("Only one problem can use the global Parameters",
+                        OOMPH_CURRENT_FUNCTION,
+                        OOMPH_EXCEPTION_LOCATION);
+  }
+
  
   // Set output directory
   Doc_info.set_directory("RESLT");
@@ -915,17 +941,46 @@ void UnstructuredFvKProblem<ELEMENT>::doc_solution(const
 int main(int argc, char **argv)
 {
   feenableexcept(FE_INVALID | FE_DIVBYZERO | FE_OVERFLOW);
+
+  // Store command line arguments
+  CommandLineArgs::setup(argc,argv);
+
+  // Element area
+  CommandLineArgs::specify_command_line_flag("--element_area",
+                                             &Parameters::Element_area);
+
+  // Direct linear solver (see FvKDirectSolvers::available_solvers())
+  string linear_solver_name="default";
+  CommandLineArgs::specify_command_line_flag("--linear_solver",
+                                             &linear_solver_name);
+
+  // Options for the direct solvers (memory budget and scratch directory
+  // for "out_of_core_ldlt")
+  FvKDirectSolvers::specify_command_line_flags();
+
+  // Parse command line
+  CommandLineArgs::parse_and_assign();
+
+  // Doc what has actually been specified on the command line
+  CommandLineArgs::doc_specified_flags();
  
   // Create the problem, using FvK elements derived from TElement<2,4>
   // elements (with 4 nodes per element edge and 10 nodes overall).
   UnstructuredFvKProblem<FoepplVonKarmanC1CurvableBellElement<4>>
-    problem;  
+    problem;
 
-  // Set pressure
-  Parameters::P_mag=10.0;
- 
-  // Solve the system
-  problem.newton_solve();
+  // Choose the linear solver
+  FvKDirectSolvers::set_solver(&problem,linear_solver_name);
+
+  // Step the pressure up to its target value (in a single step if
+  // the Newton solver converges)
+  double target_p_mag=10.0;
+  problem.adaptive_load_step_to(&Parameters::P_mag,target_p_mag,target_p_mag);
+
+  // Document the accepted and rejected load steps
+  ofstream load_step_file("RESLT/load_steps.dat");
+  problem.doc_load_step_history(load_step_file);
+  load_step_file.close();
  
   // Document the current solution
   problem.doc_solution();